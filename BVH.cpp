@@ -0,0 +1,425 @@
+#include "BVH.h"
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+#include "Bounds.h"
+
+#define BVH_BINS 16
+#define BVH_MAX_LEAF_PRIMS 8
+// deeper nodes become leaves regardless of size so traversal stacks can live on the stack
+#define BVH_MAX_DEPTH 48
+
+static AABB emptyBox() {
+	return AABB{ glm::vec3{ FLT_MAX }, glm::vec3{ -FLT_MAX } };
+}
+
+static void grow(AABB& box, const AABB& other) {
+	box.min = glm::min(box.min, other.min);
+	box.max = glm::max(box.max, other.max);
+}
+
+static float surfaceArea(const AABB& box) {
+	glm::vec3 d{ box.max - box.min };
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static bool overlaps(const AABB& a, const AABB& b) {
+	return a.min.x <= b.max.x && a.max.x >= b.min.x
+		&& a.min.y <= b.max.y && a.max.y >= b.min.y
+		&& a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// slab test, tNear is where the ray enters the box or 0 when it starts inside
+static bool intersectRay(const AABB& box, const glm::vec3& origin, const glm::vec3& invDir, float maxDistance, float& tNear) {
+	glm::vec3 t1{ (box.min - origin) * invDir };
+	glm::vec3 t2{ (box.max - origin) * invDir };
+	glm::vec3 tMin{ glm::min(t1, t2) };
+	glm::vec3 tMax{ glm::max(t1, t2) };
+	float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+	float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+	tNear = enter;
+	return enter <= exit;
+}
+
+void BVH::clear() {
+	nodes.clear();
+	parents.clear();
+	primBounds.clear();
+	primIndices.clear();
+	primLeaves.clear();
+	dirtyNodes.clear();
+	dirty.clear();
+}
+
+void BVH::build(const std::vector<AABB>& bounds) {
+	clear();
+	primBounds = bounds;
+	if (bounds.empty()) return;
+
+	unsigned int count = (unsigned int) bounds.size();
+	std::vector<BuildPrim> prims(count);
+	for (unsigned int i = 0; i < count; i++) {
+		prims[i] = BuildPrim{ bounds[i], bounds[i].getCenter(), i };
+	}
+
+	// a binary tree with one primitive per leaf has 2n - 1 nodes
+	nodes.reserve(2 * (size_t) count);
+	parents.reserve(2 * (size_t) count);
+	nodes.push_back(Node{ AABB{}, 0, count });
+	parents.push_back(~0u);
+
+	// children are always appended after their parent, refit relies on this
+	std::vector<std::pair<unsigned int, unsigned int>> stack{ { 0, 0 } };
+	while (!stack.empty()) {
+		unsigned int node = stack.back().first;
+		unsigned int depth = stack.back().second;
+		stack.pop_back();
+
+		split(node, prims, depth < BVH_MAX_DEPTH);
+
+		if (nodes[node].count == 0) {
+			stack.push_back({ nodes[node].start + 1, depth + 1 });
+			stack.push_back({ nodes[node].start, depth + 1 });
+		}
+	}
+
+	primIndices.resize(count);
+	for (unsigned int i = 0; i < count; i++) {
+		primIndices[i] = prims[i].index;
+	}
+
+	primLeaves.resize(count);
+	for (unsigned int i = 0; i < nodes.size(); i++) {
+		for (unsigned int j = 0; j < nodes[i].count; j++) {
+			primLeaves[primIndices[nodes[i].start + j]] = i;
+		}
+	}
+	dirty.assign(nodes.size(), 0);
+}
+
+void BVH::split(unsigned int node, std::vector<BuildPrim>& prims, bool allowSplit) {
+	unsigned int first = nodes[node].start;
+	unsigned int count = nodes[node].count;
+
+	AABB box{ emptyBox() };
+	AABB centroidBox{ emptyBox() };
+	for (unsigned int i = first; i < first + count; i++) {
+		grow(box, prims[i].bounds);
+		centroidBox.min = glm::min(centroidBox.min, prims[i].centroid);
+		centroidBox.max = glm::max(centroidBox.max, prims[i].centroid);
+	}
+	nodes[node].bounds = box;
+	if (count <= 2 || !allowSplit) return;
+
+	// bin centroids along the widest axis and sweep for the cheapest split plane,
+	// binning the other two axes as well costs three times as much for little gain
+	glm::vec3 centroidExtent{ centroidBox.max - centroidBox.min };
+	int axis = (centroidExtent.x > centroidExtent.y) ? 0 : 1;
+	if (centroidExtent.z > centroidExtent[axis]) axis = 2;
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestBin = 0;
+	if (centroidExtent[axis] > 0.0f) {
+		AABB binBounds[BVH_BINS];
+		unsigned int binCounts[BVH_BINS] = {};
+		for (int b = 0; b < BVH_BINS; b++) {
+			binBounds[b] = emptyBox();
+		}
+
+		float scale = BVH_BINS / centroidExtent[axis];
+		for (unsigned int i = first; i < first + count; i++) {
+			int b = std::min(BVH_BINS - 1, (int) ((prims[i].centroid[axis] - centroidBox.min[axis]) * scale));
+			binCounts[b]++;
+			grow(binBounds[b], prims[i].bounds);
+		}
+
+		// right to left prefix, then left to right while evaluating each plane
+		float rightAreas[BVH_BINS];
+		unsigned int rightCounts[BVH_BINS];
+		AABB right{ emptyBox() };
+		unsigned int rightCount = 0;
+		for (int b = BVH_BINS - 1; b > 0; b--) {
+			grow(right, binBounds[b]);
+			rightCount += binCounts[b];
+			rightAreas[b] = surfaceArea(right);
+			rightCounts[b] = rightCount;
+		}
+
+		AABB left{ emptyBox() };
+		unsigned int leftCount = 0;
+		for (int b = 0; b < BVH_BINS - 1; b++) {
+			grow(left, binBounds[b]);
+			leftCount += binCounts[b];
+			if (leftCount == 0 || rightCounts[b + 1] == 0) continue;
+
+			float cost = leftCount * surfaceArea(left) + rightCounts[b + 1] * rightAreas[b + 1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+
+	// SAH with unit traversal and intersection costs
+	float leafCost = count * surfaceArea(box);
+	float splitCost = surfaceArea(box) + bestCost;
+	if (count <= BVH_MAX_LEAF_PRIMS && (bestAxis < 0 || splitCost >= leafCost)) return;
+
+	BuildPrim* begin = prims.data() + first;
+	BuildPrim* end = begin + count;
+	BuildPrim* mid = begin + count / 2;
+	if (bestAxis >= 0) {
+		float minCentroid = centroidBox.min[bestAxis];
+		float scale = BVH_BINS / (centroidBox.max[bestAxis] - minCentroid);
+		mid = std::partition(begin, end, [&](const BuildPrim& prim) {
+			int b = std::min(BVH_BINS - 1, (int) ((prim.centroid[bestAxis] - minCentroid) * scale));
+			return b <= bestBin;
+		});
+	}
+	// every centroid in one spot, any split is as good as another
+	if (mid == begin || mid == end) mid = begin + count / 2;
+
+	unsigned int leftCount = (unsigned int) (mid - begin);
+	unsigned int leftChild = (unsigned int) nodes.size();
+	nodes.push_back(Node{ AABB{}, first, leftCount });
+	nodes.push_back(Node{ AABB{}, first + leftCount, count - leftCount });
+	parents.push_back(node);
+	parents.push_back(node);
+
+	nodes[node].start = leftChild;
+	nodes[node].count = 0;
+}
+
+void BVH::refitNode(unsigned int node) {
+	Node& n = nodes[node];
+	AABB box{ emptyBox() };
+	if (n.count == 0) {
+		grow(box, nodes[n.start].bounds);
+		grow(box, nodes[n.start + 1].bounds);
+	}
+	else {
+		for (unsigned int i = n.start; i < n.start + n.count; i++) {
+			grow(box, primBounds[primIndices[i]]);
+		}
+	}
+	n.bounds = box;
+}
+
+void BVH::update(unsigned int prim, const AABB& bounds) {
+	primBounds[prim] = bounds;
+
+	// mark the leaf and its ancestors, stopping at the first one already marked
+	unsigned int node = primLeaves[prim];
+	while (node != ~0u && !dirty[node]) {
+		dirty[node] = 1;
+		dirtyNodes.push_back(node);
+		node = parents[node];
+	}
+}
+
+void BVH::refit() {
+	if (dirtyNodes.empty()) return;
+
+	// children have higher indices than their parents, so walking indices
+	// downwards refits every child before the node that contains it
+	if (dirtyNodes.size() > nodes.size() / 4) {
+		for (size_t i = nodes.size(); i-- > 0;) {
+			if (dirty[i]) refitNode((unsigned int) i);
+		}
+	}
+	else {
+		std::sort(dirtyNodes.begin(), dirtyNodes.end(), std::greater<unsigned int>());
+		for (unsigned int node : dirtyNodes) {
+			refitNode(node);
+		}
+	}
+
+	for (unsigned int node : dirtyNodes) {
+		dirty[node] = 0;
+	}
+	dirtyNodes.clear();
+}
+
+void BVH::collectSubtree(unsigned int node, std::vector<unsigned int>& out) const {
+	unsigned int stack[2 * BVH_MAX_DEPTH + 2];
+	unsigned int size = 0;
+	stack[size++] = node;
+	while (size > 0) {
+		const Node& n = nodes[stack[--size]];
+		if (n.count == 0) {
+			stack[size++] = n.start + 1;
+			stack[size++] = n.start;
+		}
+		else {
+			out.insert(out.end(), primIndices.begin() + n.start, primIndices.begin() + n.start + n.count);
+		}
+	}
+}
+
+void BVH::queryFrustum(const Frustum& frustum, std::vector<unsigned int>& out) const {
+	if (nodes.empty()) return;
+
+	// each entry carries the planes its parent was not already fully inside of
+	struct Entry {
+		unsigned int node;
+		unsigned int planeMask;
+	};
+	Entry stack[2 * BVH_MAX_DEPTH + 2];
+	unsigned int size = 0;
+	stack[size++] = Entry{ 0, (1u << FRUSTUM_PLANE_COUNT) - 1 };
+
+	while (size > 0) {
+		Entry e = stack[--size];
+		const Node& n = nodes[e.node];
+
+		glm::vec3 center{ n.bounds.getCenter() };
+		glm::vec3 extents{ n.bounds.getExtents() };
+		bool outside = false;
+		for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+			if (!(e.planeMask & (1u << i))) continue;
+
+			const Plane& plane = frustum.planes[i];
+			float r = glm::dot(extents, glm::abs(plane.normal));
+			float d = plane.distance(center);
+			if (d < -r) {
+				outside = true;
+				break;
+			}
+			if (d >= r) e.planeMask &= ~(1u << i);
+		}
+		if (outside) continue;
+
+		// fully inside, everything below is visible without further tests
+		if (e.planeMask == 0) {
+			collectSubtree(e.node, out);
+		}
+		else if (n.count == 0) {
+			stack[size++] = Entry{ n.start + 1, e.planeMask };
+			stack[size++] = Entry{ n.start, e.planeMask };
+		}
+		else {
+			for (unsigned int i = n.start; i < n.start + n.count; i++) {
+				if (frustum.intersects(primBounds[primIndices[i]])) out.push_back(primIndices[i]);
+			}
+		}
+	}
+}
+
+void BVH::queryOverlap(const AABB& box, std::vector<unsigned int>& out) const {
+	if (nodes.empty()) return;
+
+	unsigned int stack[2 * BVH_MAX_DEPTH + 2];
+	unsigned int size = 0;
+	stack[size++] = 0;
+	while (size > 0) {
+		const Node& n = nodes[stack[--size]];
+		if (!overlaps(n.bounds, box)) continue;
+
+		if (n.count == 0) {
+			stack[size++] = n.start + 1;
+			stack[size++] = n.start;
+		}
+		else {
+			for (unsigned int i = n.start; i < n.start + n.count; i++) {
+				if (overlaps(primBounds[primIndices[i]], box)) out.push_back(primIndices[i]);
+			}
+		}
+	}
+}
+
+bool BVH::raycast(const Ray& ray, float maxDistance, RayHit& hit) const {
+	if (nodes.empty()) return false;
+
+	glm::vec3 invDir{ 1.0f / ray.direction };
+	float tNear;
+	if (!intersectRay(nodes[0].bounds, ray.origin, invDir, maxDistance, tNear)) return false;
+
+	struct Entry {
+		unsigned int node;
+		float tNear;
+	};
+	Entry stack[2 * BVH_MAX_DEPTH + 2];
+	unsigned int size = 0;
+	stack[size++] = Entry{ 0, tNear };
+
+	float best = maxDistance;
+	unsigned int bestPrim = ~0u;
+	while (size > 0) {
+		Entry e = stack[--size];
+		// something closer was found after this node was pushed
+		if (e.tNear > best) continue;
+
+		const Node& n = nodes[e.node];
+		if (n.count == 0) {
+			float tLeft, tRight;
+			bool hitLeft = intersectRay(nodes[n.start].bounds, ray.origin, invDir, best, tLeft);
+			bool hitRight = intersectRay(nodes[n.start + 1].bounds, ray.origin, invDir, best, tRight);
+
+			// push the far child first so the near one is visited first
+			if (hitLeft && hitRight) {
+				if (tLeft <= tRight) {
+					stack[size++] = Entry{ n.start + 1, tRight };
+					stack[size++] = Entry{ n.start, tLeft };
+				}
+				else {
+					stack[size++] = Entry{ n.start, tLeft };
+					stack[size++] = Entry{ n.start + 1, tRight };
+				}
+			}
+			else if (hitLeft) {
+				stack[size++] = Entry{ n.start, tLeft };
+			}
+			else if (hitRight) {
+				stack[size++] = Entry{ n.start + 1, tRight };
+			}
+		}
+		else {
+			for (unsigned int i = n.start; i < n.start + n.count; i++) {
+				float t;
+				if (intersectRay(primBounds[primIndices[i]], ray.origin, invDir, best, t) && t < best) {
+					best = t;
+					bestPrim = primIndices[i];
+				}
+			}
+		}
+	}
+
+	if (bestPrim == ~0u) return false;
+	hit.prim = bestPrim;
+	hit.distance = best;
+	return true;
+}
+
+bool BVH::occluded(const Ray& ray, float maxDistance) const {
+	if (nodes.empty()) return false;
+
+	glm::vec3 invDir{ 1.0f / ray.direction };
+	unsigned int stack[2 * BVH_MAX_DEPTH + 2];
+	unsigned int size = 0;
+	stack[size++] = 0;
+	while (size > 0) {
+		const Node& n = nodes[stack[--size]];
+		float t;
+		if (!intersectRay(n.bounds, ray.origin, invDir, maxDistance, t)) continue;
+
+		if (n.count == 0) {
+			stack[size++] = n.start + 1;
+			stack[size++] = n.start;
+		}
+		else {
+			for (unsigned int i = n.start; i < n.start + n.count; i++) {
+				if (intersectRay(primBounds[primIndices[i]], ray.origin, invDir, maxDistance, t)) return true;
+			}
+		}
+	}
+	return false;
+}
+
+size_t BVH::getPrimCount() const { return primBounds.size(); }
+size_t BVH::getNodeCount() const { return nodes.size(); }
+const AABB& BVH::getPrimBounds(unsigned int prim) const { return primBounds[prim]; }
\ No newline at end of file
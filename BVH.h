@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Bounds.h"
+
+struct RayHit {
+	unsigned int prim = ~0u;
+	float distance = 0.0f;
+};
+
+// Bounding volume hierarchy over primitive AABBs, a primitive is whatever the
+// caller numbered it as (a mesh instance in the renderer). Built top down with
+// binned SAH, moved primitives are refit bottom up without changing the
+// topology, so rebuild once things have moved far from where they started.
+class BVH {
+public:
+	// count == 0 marks an interior node whose children sit at start and start + 1,
+	// otherwise a leaf owning primIndices[start, start + count)
+	struct Node {
+		AABB bounds;
+		unsigned int start;
+		unsigned int count;
+	};
+
+private:
+	// build works on a copy kept in tree order so partitioning touches memory sequentially
+	struct BuildPrim {
+		AABB bounds;
+		glm::vec3 centroid;
+		unsigned int index;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> parents;
+	std::vector<AABB> primBounds;
+	std::vector<unsigned int> primIndices;
+	std::vector<unsigned int> primLeaves;
+
+	std::vector<unsigned int> dirtyNodes;
+	std::vector<unsigned char> dirty;
+
+	void split(unsigned int node, std::vector<BuildPrim>& prims, bool allowSplit);
+	void refitNode(unsigned int node);
+	void collectSubtree(unsigned int node, std::vector<unsigned int>& out) const;
+
+public:
+	void build(const std::vector<AABB>& bounds);
+	void clear();
+
+	// moves a primitive, the tree is only correct again after refit()
+	void update(unsigned int prim, const AABB& bounds);
+	void refit();
+
+	// primitives whose bounds touch the frustum or the box, appended to out
+	void queryFrustum(const Frustum& frustum, std::vector<unsigned int>& out) const;
+	void queryOverlap(const AABB& box, std::vector<unsigned int>& out) const;
+
+	// nearest primitive bounds along the ray, for picking
+	bool raycast(const Ray& ray, float maxDistance, RayHit& hit) const;
+	// stops at the first hit, for line of sight
+	bool occluded(const Ray& ray, float maxDistance) const;
+
+	size_t getPrimCount() const;
+	size_t getNodeCount() const;
+	const AABB& getPrimBounds(unsigned int prim) const;
+};
\ No newline at end of file
@@ -0,0 +1,282 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "JobSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BLOCK_SSE2
+#endif
+
+size_t getBlockBytes(BlockFormat format) {
+	return (format == BLOCK_BC1) ? 8 : 16;
+}
+
+size_t getCompressedSize(BlockFormat format, int width, int height) {
+	return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes(format);
+}
+
+// gathers a 4x4 block as RGBA, clamping at the image edges
+static void fetchBlock(const unsigned char* texels, int width, int height, int channels, int bx, int by, unsigned char block[64]) {
+	for (int y = 0; y < 4; y++) {
+		int sy = std::min(by * 4 + y, height - 1);
+		for (int x = 0; x < 4; x++) {
+			int sx = std::min(bx * 4 + x, width - 1);
+			const unsigned char* in = texels + ((size_t) sy * width + sx) * channels;
+			unsigned char* out = block + (y * 4 + x) * 4;
+			switch (channels) {
+			case 1: out[0] = out[1] = out[2] = in[0]; out[3] = 255; break;
+			case 2: out[0] = in[0]; out[1] = in[1]; out[2] = 0; out[3] = 255; break;
+			case 3: out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = 255; break;
+			default: std::memcpy(out, in, 4); break;
+			}
+		}
+	}
+}
+
+static uint16_t to565(const unsigned char* c) {
+	return (uint16_t) (((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+static void from565(uint16_t c, int out[3]) {
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+// Bounding box endpoints pulled in by 1/16 of the range, then every texel is
+// projected onto the line between them, in the style of van Waveren's real-time DXT
+static void encodeColorBlock(const unsigned char block[64], unsigned char* out) {
+	unsigned char minColor[4], maxColor[4];
+#ifdef BLOCK_SSE2
+	const __m128i* rows = (const __m128i*) block;
+	__m128i lo = _mm_min_epu8(_mm_min_epu8(_mm_loadu_si128(rows), _mm_loadu_si128(rows + 1)),
+		_mm_min_epu8(_mm_loadu_si128(rows + 2), _mm_loadu_si128(rows + 3)));
+	__m128i hi = _mm_max_epu8(_mm_max_epu8(_mm_loadu_si128(rows), _mm_loadu_si128(rows + 1)),
+		_mm_max_epu8(_mm_loadu_si128(rows + 2), _mm_loadu_si128(rows + 3)));
+	lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+	lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+	hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+	hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+	int minPacked = _mm_cvtsi128_si32(lo), maxPacked = _mm_cvtsi128_si32(hi);
+	std::memcpy(minColor, &minPacked, 4);
+	std::memcpy(maxColor, &maxPacked, 4);
+#else
+	for (int c = 0; c < 3; c++) {
+		minColor[c] = maxColor[c] = block[c];
+		for (int i = 1; i < 16; i++) {
+			minColor[c] = std::min(minColor[c], block[i * 4 + c]);
+			maxColor[c] = std::max(maxColor[c], block[i * 4 + c]);
+		}
+	}
+#endif
+	for (int c = 0; c < 3; c++) {
+		int inset = (maxColor[c] - minColor[c]) >> 4;
+		minColor[c] = (unsigned char) (minColor[c] + inset);
+		maxColor[c] = (unsigned char) (maxColor[c] - inset);
+	}
+
+	uint16_t color0 = to565(maxColor), color1 = to565(minColor);
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		// project onto the quantized endpoints, they are what the decoder interpolates
+		int end0[3], end1[3], axis[3];
+		from565(color0, end0);
+		from565(color1, end1);
+		for (int c = 0; c < 3; c++) {
+			axis[c] = end0[c] - end1[c];
+		}
+		int lengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+		// step k of 0..3 from color1 to color0 is index 1, 3, 2, 0
+		static const uint32_t remap[4] = { 1, 3, 2, 0 };
+		int steps[16];
+#ifdef BLOCK_SSE2
+		__m128i zero = _mm_setzero_si128();
+		__m128i origin = _mm_setr_epi16((short) end1[0], (short) end1[1], (short) end1[2], 0, (short) end1[0], (short) end1[1], (short) end1[2], 0);
+		__m128i direction = _mm_setr_epi16((short) axis[0], (short) axis[1], (short) axis[2], 0, (short) axis[0], (short) axis[1], (short) axis[2], 0);
+		__m128i threshold0 = _mm_set1_epi32(lengthSq), threshold1 = _mm_set1_epi32(3 * lengthSq), threshold2 = _mm_set1_epi32(5 * lengthSq);
+		for (int r = 0; r < 4; r++) {
+			__m128i texels = _mm_loadu_si128(rows + r);
+			__m128i dotLo = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(texels, zero), origin), direction);
+			__m128i dotHi = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(texels, zero), origin), direction);
+			// each texel's dot product is split over two lanes, add the pairs
+			__m128 evens = _mm_shuffle_ps(_mm_castsi128_ps(dotLo), _mm_castsi128_ps(dotHi), _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 odds = _mm_shuffle_ps(_mm_castsi128_ps(dotLo), _mm_castsi128_ps(dotHi), _MM_SHUFFLE(3, 1, 3, 1));
+			__m128i dot = _mm_add_epi32(_mm_castps_si128(evens), _mm_castps_si128(odds));
+			// round(3 * dot / lengthSq) by counting the midpoints passed
+			__m128i scaled = _mm_add_epi32(_mm_slli_epi32(dot, 2), _mm_slli_epi32(dot, 1));
+			__m128i step = _mm_sub_epi32(_mm_sub_epi32(_mm_sub_epi32(zero, _mm_cmpgt_epi32(scaled, threshold0)),
+				_mm_cmpgt_epi32(scaled, threshold1)), _mm_cmpgt_epi32(scaled, threshold2));
+			_mm_storeu_si128((__m128i*) (steps + r * 4), step);
+		}
+#else
+		for (int i = 0; i < 16; i++) {
+			int dot = 0;
+			for (int c = 0; c < 3; c++) {
+				dot += (block[i * 4 + c] - end1[c]) * axis[c];
+			}
+			steps[i] = (6 * dot > lengthSq) + (6 * dot > 3 * lengthSq) + (6 * dot > 5 * lengthSq);
+		}
+#endif
+		for (int i = 0; i < 16; i++) {
+			indices |= remap[steps[i]] << (i * 2);
+		}
+	}
+
+	out[0] = (unsigned char) color0; out[1] = (unsigned char) (color0 >> 8);
+	out[2] = (unsigned char) color1; out[3] = (unsigned char) (color1 >> 8);
+	std::memcpy(out + 4, &indices, 4);
+}
+
+// one channel of the block, eight interpolated values between its extremes
+static void encodeChannelBlock(const unsigned char block[64], int channel, unsigned char* out) {
+	int lo = 255, hi = 0;
+	for (int i = 0; i < 16; i++) {
+		lo = std::min(lo, (int) block[i * 4 + channel]);
+		hi = std::max(hi, (int) block[i * 4 + channel]);
+	}
+
+	uint64_t indices = 0;
+	int range = hi - lo;
+	if (range > 0) {
+		// step k of 0..7 from lo to hi is index 1, 7, 6 .. 2, 0
+		for (int i = 0; i < 16; i++) {
+			int k = ((block[i * 4 + channel] - lo) * 14 + range) / (2 * range);
+			uint64_t index = (k == 7) ? 0 : (k == 0) ? 1 : (uint64_t) (8 - k);
+			indices |= index << (i * 3);
+		}
+	}
+
+	out[0] = (unsigned char) hi;
+	out[1] = (unsigned char) lo;
+	for (int i = 0; i < 6; i++) {
+		out[2 + i] = (unsigned char) (indices >> (i * 8));
+	}
+}
+
+void compressImage(BlockFormat format, const unsigned char* texels, int width, int height, int channels,
+	unsigned char* blocks, JobSystem* jobs)
+{
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t blockBytes = getBlockBytes(format);
+
+	auto compressRow = [&](unsigned int by) {
+		unsigned char block[64];
+		unsigned char* out = blocks + (size_t) by * blocksX * blockBytes;
+		for (int bx = 0; bx < blocksX; bx++, out += blockBytes) {
+			fetchBlock(texels, width, height, channels, bx, (int) by, block);
+			switch (format) {
+			case BLOCK_BC1:
+				encodeColorBlock(block, out);
+				break;
+			case BLOCK_BC3:
+				encodeChannelBlock(block, 3, out);
+				encodeColorBlock(block, out + 8);
+				break;
+			case BLOCK_BC5:
+				encodeChannelBlock(block, 0, out);
+				encodeChannelBlock(block, 1, out + 8);
+				break;
+			}
+		}
+	};
+
+	if (jobs && blocksY > 1) {
+		jobs->parallelFor((unsigned int) blocksY, compressRow);
+	}
+	else {
+		for (int by = 0; by < blocksY; by++) {
+			compressRow((unsigned int) by);
+		}
+	}
+}
+
+static void decodeColorBlock(const unsigned char* in, bool alwaysFourColor, unsigned char block[64]) {
+	uint16_t color0 = (uint16_t) (in[0] | (in[1] << 8)), color1 = (uint16_t) (in[2] | (in[3] << 8));
+	int palette[4][4];
+	from565(color0, palette[0]);
+	from565(color1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (int c = 0; c < 3; c++) {
+		if (color0 > color1 || alwaysFourColor) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	if (!(color0 > color1 || alwaysFourColor)) {
+		palette[3][3] = 0;
+	}
+
+	uint32_t indices;
+	std::memcpy(&indices, in + 4, 4);
+	for (int i = 0; i < 16; i++) {
+		const int* color = palette[(indices >> (i * 2)) & 3];
+		for (int c = 0; c < 4; c++) {
+			block[i * 4 + c] = (unsigned char) color[c];
+		}
+	}
+}
+
+static void decodeChannelBlock(const unsigned char* in, int channel, unsigned char block[64]) {
+	int palette[8] = { in[0], in[1] };
+	for (int i = 2; i < 8; i++) {
+		if (palette[0] > palette[1]) {
+			palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7;
+		}
+		else {
+			palette[i] = (i < 6) ? ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5 : (i == 6) ? 0 : 255;
+		}
+	}
+
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; i++) {
+		indices |= (uint64_t) in[2 + i] << (i * 8);
+	}
+	for (int i = 0; i < 16; i++) {
+		block[i * 4 + channel] = (unsigned char) palette[(indices >> (i * 3)) & 7];
+	}
+}
+
+void decompressImage(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* rgba) {
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t blockBytes = getBlockBytes(format);
+
+	unsigned char block[64];
+	for (int by = 0; by < blocksY; by++) {
+		for (int bx = 0; bx < blocksX; bx++) {
+			const unsigned char* in = blocks + ((size_t) by * blocksX + bx) * blockBytes;
+			switch (format) {
+			case BLOCK_BC1:
+				decodeColorBlock(in, false, block);
+				break;
+			case BLOCK_BC3:
+				decodeColorBlock(in + 8, true, block);
+				decodeChannelBlock(in, 3, block);
+				break;
+			case BLOCK_BC5:
+				for (int i = 0; i < 16; i++) {
+					block[i * 4 + 2] = 0;
+					block[i * 4 + 3] = 255;
+				}
+				decodeChannelBlock(in, 0, block);
+				decodeChannelBlock(in + 8, 1, block);
+				break;
+			}
+
+			for (int y = 0; y < 4 && by * 4 + y < height; y++) {
+				for (int x = 0; x < 4 && bx * 4 + x < width; x++) {
+					std::memcpy(rgba + ((size_t) (by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
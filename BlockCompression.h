@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+class JobSystem;
+
+// 4x4 texel block formats. BC1 is opaque RGB at 8 bytes a block, BC3 adds an
+// interpolated alpha block for 16 bytes, BC5 is two such blocks holding red and green.
+enum BlockFormat {
+	BLOCK_BC1,
+	BLOCK_BC3,
+	BLOCK_BC5
+};
+
+size_t getBlockBytes(BlockFormat format);
+size_t getCompressedSize(BlockFormat format, int width, int height);
+
+// texels have 1 to 4 channels, read as grey, red green, RGB or RGBA. Block rows are
+// spread over the job system when one is given. Edge blocks repeat the last row and column.
+void compressImage(BlockFormat format, const unsigned char* texels, int width, int height, int channels,
+	unsigned char* blocks, JobSystem* jobs);
+// back to RGBA8, for measuring the encoder's error and checking what a driver decoded
+void decompressImage(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* rgba);
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "Bounds.h"
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+glm::vec3 AABB::getCenter() const { return (min + max) * 0.5f; }
+glm::vec3 AABB::getExtents() const { return (max - min) * 0.5f; }
+
+AABB AABB::transform(const glm::mat4& m) const {
+	// transform the center and project the extents onto each world axis
+	glm::vec3 center{ m * glm::vec4{ getCenter(), 1.0f } };
+	glm::vec3 extents{ getExtents() };
+	glm::mat3 absRot{ glm::abs(glm::vec3{ m[0] }), glm::abs(glm::vec3{ m[1] }), glm::abs(glm::vec3{ m[2] }) };
+	glm::vec3 worldExtents{ absRot * extents };
+	return AABB{ center - worldExtents, center + worldExtents };
+}
+
+BoundingSphere BoundingSphere::transform(const glm::mat4& m) const {
+	float scale = std::sqrt(std::max({ glm::dot(glm::vec3{ m[0] }, glm::vec3{ m[0] }),
+									   glm::dot(glm::vec3{ m[1] }, glm::vec3{ m[1] }),
+									   glm::dot(glm::vec3{ m[2] }, glm::vec3{ m[2] }) }));
+	return BoundingSphere{ glm::vec3{ m * glm::vec4{ center, 1.0f } }, radius * scale };
+}
+
+float Plane::distance(const glm::vec3& p) const {
+	return glm::dot(normal, p) + d;
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection) {
+	// glm is column major, row i of the matrix is m[0][i], m[1][i], m[2][i], m[3][i]
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4{ viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i] };
+	}
+
+	glm::vec4 coefficients[FRUSTUM_PLANE_COUNT] = {
+		rows[3] + rows[0],
+		rows[3] - rows[0],
+		rows[3] + rows[1],
+		rows[3] - rows[1],
+		rows[3] + rows[2],
+		rows[3] - rows[2]
+	};
+
+	Frustum frustum;
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+		// normalized so distance() returns world units and spheres can be tested directly
+		float length = glm::length(glm::vec3{ coefficients[i] });
+		frustum.planes[i].normal = glm::vec3{ coefficients[i] } / length;
+		frustum.planes[i].d = coefficients[i].w / length;
+	}
+	return frustum;
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+		if (planes[i].distance(sphere.center) < -sphere.radius) return false;
+	}
+	return true;
+}
+
+bool Frustum::intersects(const AABB& box) const {
+	glm::vec3 center{ box.getCenter() };
+	glm::vec3 extents{ box.getExtents() };
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+		// projected radius of the box onto the plane normal
+		float r = glm::dot(extents, glm::abs(planes[i].normal));
+		if (planes[i].distance(center) < -r) return false;
+	}
+	return true;
+}
\ No newline at end of file
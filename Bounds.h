@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+struct AABB {
+	glm::vec3 min{ 0.0f };
+	glm::vec3 max{ 0.0f };
+
+	glm::vec3 getCenter() const;
+	glm::vec3 getExtents() const;
+
+	// box around the eight transformed corners
+	AABB transform(const glm::mat4& m) const;
+};
+
+struct BoundingSphere {
+	glm::vec3 center{ 0.0f };
+	float radius = 0.0f;
+
+	// radius grows with the largest axis scale of m
+	BoundingSphere transform(const glm::mat4& m) const;
+};
+
+struct Ray {
+	glm::vec3 origin{ 0.0f };
+	glm::vec3 direction{ 0.0f, 0.0f, -1.0f };
+};
+
+// a point p is in front of the plane when dot(normal, p) + d >= 0
+struct Plane {
+	glm::vec3 normal{ 0.0f };
+	float d = 0.0f;
+
+	float distance(const glm::vec3& p) const;
+};
+
+enum FrustumPlane {
+	FRUSTUM_LEFT,
+	FRUSTUM_RIGHT,
+	FRUSTUM_BOTTOM,
+	FRUSTUM_TOP,
+	FRUSTUM_NEAR,
+	FRUSTUM_FAR,
+	FRUSTUM_PLANE_COUNT
+};
+
+// Six inward facing planes. The tests are conservative, a volume that
+// straddles two planes outside a corner of the frustum still counts as visible.
+struct Frustum {
+	Plane planes[FRUSTUM_PLANE_COUNT];
+
+	// planes taken from the rows of projection * view, in world space
+	static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+	bool intersects(const BoundingSphere& sphere) const;
+	bool intersects(const AABB& box) const;
+};
\ No newline at end of file
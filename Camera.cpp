@@ -1,4 +1,5 @@
 #include "Camera.h"
+#include "Bounds.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -47,6 +48,10 @@ glm::mat4 Camera::getView() const {
 	*/
 }
 
+Frustum Camera::getFrustum(const glm::mat4& projection) const {
+	return Frustum::fromMatrix(projection * getView());
+}
+
 // MUTATORS
 void Camera::setPos(glm::vec3 targetPos) { this->pos = targetPos; }
 void Camera::updatePos(glm::vec3 deltaPos) { this->pos += deltaPos; }
@@ -2,6 +2,8 @@
 
 #include <glm/glm.hpp>
 
+#include "Bounds.h"
+
 class Camera {
 private:
 	glm::vec3 pos;
@@ -31,6 +33,7 @@ public:
 
 	glm::vec3 getRight() const;
 	glm::mat4 getView() const;
+	Frustum getFrustum(const glm::mat4& projection) const;
 
 	// MUTATORS
 	void setPos(glm::vec3 targetPos);
@@ -0,0 +1,345 @@
+#include "CookedModel.h"
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "Model.h"
+#include "MeshSimplifier.h"
+
+static_assert(sizeof(Vertex) == 32, "cooked vertex blobs assume the Vertex layout is tightly packed");
+static_assert(sizeof(CookedHeader) == 144, "CookedHeader layout changed, bump COOKED_MODEL_VERSION");
+static_assert(sizeof(CookedMesh) == 136, "CookedMesh layout changed, bump COOKED_MODEL_VERSION");
+static_assert(sizeof(CookedNode) == 80, "CookedNode layout changed, bump COOKED_MODEL_VERSION");
+static_assert(sizeof(CookedMeshlet) == 40, "CookedMeshlet layout changed, bump COOKED_MODEL_VERSION");
+static_assert(COOKED_MODEL_MAX_LODS == MESH_LOD_MAX, "cooked meshes need a slot for every level");
+
+static uint64_t fnv1a(const unsigned char* data, size_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+CookedModel::CookedModel()
+	: header(nullptr)
+{}
+
+template<typename T>
+const T* CookedModel::table(uint64_t offset) const {
+	return (const T*) (file.data() + offset);
+}
+
+bool CookedModel::open(const std::string& cookedPath, const std::string& sourcePath) {
+	header = nullptr;
+	if (!file.open(cookedPath)) return false;
+
+	if (file.size() < sizeof(CookedHeader)) {
+		std::cout << "ERROR::COOKED_MODEL::TRUNCATED " << cookedPath << std::endl;
+		return false;
+	}
+	const CookedHeader* h = (const CookedHeader*) file.data();
+	if (h->magic != COOKED_MODEL_MAGIC || h->version != COOKED_MODEL_VERSION) {
+		std::cout << "ERROR::COOKED_MODEL::VERSION_MISMATCH " << cookedPath << std::endl;
+		return false;
+	}
+	if (h->fileSize != file.size()) {
+		std::cout << "ERROR::COOKED_MODEL::TRUNCATED " << cookedPath << std::endl;
+		return false;
+	}
+
+	// a missing source is fine, that is how cooked files ship
+	uint64_t size;
+	int64_t time;
+	if (getFileStamp(sourcePath, size, time) && (size != h->sourceSize || time != h->sourceTime)) {
+		return false;
+	}
+
+	// every table has to fit in the file before anything reads through it
+	auto fits = [&](uint64_t offset, uint64_t count, uint64_t elementSize) {
+		return offset <= file.size() && count <= (file.size() - offset) / elementSize;
+	};
+	if (!fits(h->meshesOffset, h->meshCount, sizeof(CookedMesh))
+		|| !fits(h->materialsOffset, h->materialCount, sizeof(CookedMaterial))
+		|| !fits(h->textureRefsOffset, h->textureRefCount, sizeof(CookedTextureRef))
+		|| !fits(h->nodesOffset, h->nodeCount, sizeof(CookedNode))
+		|| !fits(h->nodeMeshesOffset, h->nodeMeshCount, sizeof(uint32_t))
+		|| !fits(h->stringsOffset, h->stringBytes, 1)
+		|| !fits(h->meshletsOffset, h->meshletCount, sizeof(CookedMeshlet))
+		|| h->verticesOffset > file.size() || h->indicesOffset > file.size()) {
+		std::cout << "ERROR::COOKED_MODEL::CORRUPT " << cookedPath << std::endl;
+		return false;
+	}
+
+	if (fnv1a(file.data() + sizeof(CookedHeader), file.size() - sizeof(CookedHeader)) != h->checksum) {
+		std::cout << "ERROR::COOKED_MODEL::CHECKSUM " << cookedPath << std::endl;
+		return false;
+	}
+
+	// the checksum only proves the file is what was written, every index from one table
+	// into another is checked too so a stale or crafted file can never read out of bounds
+	auto corrupt = [&cookedPath]() {
+		std::cout << "ERROR::COOKED_MODEL::CORRUPT " << cookedPath << std::endl;
+		return false;
+	};
+	const char* strings = (const char*) file.data() + h->stringsOffset;
+	auto validString = [&](uint32_t offset) {
+		return offset < h->stringBytes && std::memchr(strings + offset, 0, h->stringBytes - offset) != nullptr;
+	};
+
+	const CookedMesh* meshes = table<CookedMesh>(h->meshesOffset);
+	for (uint32_t i = 0; i < h->meshCount; i++) {
+		const CookedMesh& mesh = meshes[i];
+		if (mesh.firstVertex > file.size() / sizeof(Vertex) || mesh.firstIndex > file.size() / sizeof(unsigned int)
+			|| !fits(h->verticesOffset + mesh.firstVertex * sizeof(Vertex), mesh.vertexCount, sizeof(Vertex))
+			|| !fits(h->indicesOffset + mesh.firstIndex * sizeof(unsigned int), mesh.indexCount, sizeof(unsigned int))
+			|| mesh.material >= h->materialCount) {
+			return corrupt();
+		}
+		uint64_t lodIndices = 0;
+		for (uint32_t l = 0; l < mesh.lodCount && l < COOKED_MODEL_MAX_LODS; l++) {
+			lodIndices += mesh.lodIndexCount[l];
+		}
+		if (mesh.lodCount == 0 || mesh.lodCount > COOKED_MODEL_MAX_LODS || lodIndices != mesh.indexCount
+			|| mesh.firstMeshlet > h->meshletCount || mesh.meshletCount > h->meshletCount - mesh.firstMeshlet) {
+			return corrupt();
+		}
+		const unsigned int* indices = table<unsigned int>(h->indicesOffset) + mesh.firstIndex;
+		for (uint32_t j = 0; j < mesh.indexCount; j++) {
+			if (indices[j] >= mesh.vertexCount) return corrupt();
+		}
+		// meshlets only ever cover the full level
+		const CookedMeshlet* meshlets = table<CookedMeshlet>(h->meshletsOffset) + mesh.firstMeshlet;
+		for (uint32_t m = 0; m < mesh.meshletCount; m++) {
+			if (meshlets[m].firstIndex > mesh.lodIndexCount[0]
+				|| meshlets[m].indexCount > mesh.lodIndexCount[0] - meshlets[m].firstIndex) {
+				return corrupt();
+			}
+		}
+	}
+
+	const CookedMaterial* materials = table<CookedMaterial>(h->materialsOffset);
+	for (uint32_t i = 0; i < h->materialCount; i++) {
+		if (materials[i].firstTextureRef > h->textureRefCount
+			|| materials[i].textureRefCount > h->textureRefCount - materials[i].firstTextureRef) {
+			return corrupt();
+		}
+	}
+	const CookedTextureRef* textureRefs = table<CookedTextureRef>(h->textureRefsOffset);
+	for (uint32_t i = 0; i < h->textureRefCount; i++) {
+		if (!validString(textureRefs[i].type) || !validString(textureRefs[i].path)) return corrupt();
+	}
+
+	// parents always come before their children, the scene graph relies on it
+	const CookedNode* nodes = table<CookedNode>(h->nodesOffset);
+	const uint32_t* nodeMeshes = table<uint32_t>(h->nodeMeshesOffset);
+	for (uint32_t i = 0; i < h->nodeCount; i++) {
+		if (nodes[i].parent < -1 || nodes[i].parent >= (int64_t) i || !validString(nodes[i].name)
+			|| nodes[i].firstMesh > h->nodeMeshCount || nodes[i].meshCount > h->nodeMeshCount - nodes[i].firstMesh) {
+			return corrupt();
+		}
+	}
+	for (uint32_t i = 0; i < h->nodeMeshCount; i++) {
+		if (nodeMeshes[i] >= h->meshCount) return corrupt();
+	}
+
+	header = h;
+	return true;
+}
+
+size_t CookedModel::getFileSize() const { return file.size(); }
+unsigned int CookedModel::getMeshCount() const { return header->meshCount; }
+const CookedMesh& CookedModel::getMesh(unsigned int mesh) const { return table<CookedMesh>(header->meshesOffset)[mesh]; }
+
+const Vertex* CookedModel::getVertices(const CookedMesh& mesh) const {
+	return table<Vertex>(header->verticesOffset) + mesh.firstVertex;
+}
+
+const unsigned int* CookedModel::getIndices(const CookedMesh& mesh) const {
+	return table<unsigned int>(header->indicesOffset) + mesh.firstIndex;
+}
+
+const CookedMeshlet& CookedModel::getMeshlet(unsigned int meshlet) const { return table<CookedMeshlet>(header->meshletsOffset)[meshlet]; }
+
+const CookedMaterial& CookedModel::getMaterial(unsigned int material) const { return table<CookedMaterial>(header->materialsOffset)[material]; }
+const CookedTextureRef& CookedModel::getTextureRef(unsigned int ref) const { return table<CookedTextureRef>(header->textureRefsOffset)[ref]; }
+
+unsigned int CookedModel::getNodeCount() const { return header->nodeCount; }
+const CookedNode& CookedModel::getNode(unsigned int node) const { return table<CookedNode>(header->nodesOffset)[node]; }
+unsigned int CookedModel::getNodeMesh(unsigned int index) const { return table<uint32_t>(header->nodeMeshesOffset)[index]; }
+
+const char* CookedModel::getString(uint32_t offset) const {
+	return table<char>(header->stringsOffset) + offset;
+}
+
+// appends raw structs to the file image, padding first so the next one lands aligned
+static uint64_t append(std::vector<unsigned char>& image, const void* data, size_t size, size_t alignment) {
+	while (image.size() % alignment != 0) {
+		image.push_back(0);
+	}
+	uint64_t offset = image.size();
+	image.insert(image.end(), (const unsigned char*) data, (const unsigned char*) data + size);
+	return offset;
+}
+
+bool writeCookedModel(const std::string& cookedPath, const std::string& sourcePath,
+	const std::vector<Mesh>& meshes, const std::vector<MeshOptimizeReport>& reports, const std::vector<ModelNode>& nodes)
+{
+	CookedHeader header{};
+	header.magic = COOKED_MODEL_MAGIC;
+	header.version = COOKED_MODEL_VERSION;
+	if (!getFileStamp(sourcePath, header.sourceSize, header.sourceTime)) {
+		std::cout << "ERROR::COOKED_MODEL::NO_SOURCE " << sourcePath << std::endl;
+		return false;
+	}
+
+	// strings are deduplicated, most texture types and paths repeat
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> stringOffsets;
+	auto addString = [&](const std::string& s) {
+		auto it = stringOffsets.find(s);
+		if (it != stringOffsets.end()) return it->second;
+		uint32_t offset = (uint32_t) strings.size();
+		strings.append(s.c_str(), s.size() + 1);
+		stringOffsets.emplace(s, offset);
+		return offset;
+	};
+
+	// meshes sharing a texture list share a material
+	std::vector<CookedMesh> cookedMeshes;
+	std::vector<CookedMaterial> materials;
+	std::vector<CookedTextureRef> textureRefs;
+	std::vector<CookedMeshlet> cookedMeshlets;
+	std::map<std::vector<std::pair<uint32_t, uint32_t>>, uint32_t> materialIDs;
+	uint64_t vertexCount = 0, indexCount = 0;
+	for (size_t m = 0; m < meshes.size(); m++) {
+		const Mesh& mesh = meshes[m];
+		std::vector<std::pair<uint32_t, uint32_t>> refs;
+		for (const Texture& texture : mesh.textures) {
+			refs.push_back({ addString(texture.type), addString(texture.path) });
+		}
+		auto it = materialIDs.find(refs);
+		if (it == materialIDs.end()) {
+			materials.push_back(CookedMaterial{ (uint32_t) textureRefs.size(), (uint32_t) refs.size() });
+			for (auto& ref : refs) {
+				textureRefs.push_back(CookedTextureRef{ ref.first, ref.second });
+			}
+			it = materialIDs.emplace(refs, (uint32_t) materials.size() - 1).first;
+		}
+
+		CookedMesh cooked{};
+		cooked.firstVertex = vertexCount;
+		cooked.firstIndex = indexCount;
+		cooked.vertexCount = mesh.getVertexCount();
+		cooked.indexCount = mesh.getTotalIndexCount();
+		cooked.material = it->second;
+		cooked.sourceVertexCount = reports[m].verticesBefore;
+		cooked.acmrBefore = reports[m].before.acmr;
+		cooked.acmrAfter = reports[m].after.acmr;
+		cooked.atvrBefore = reports[m].before.atvr;
+		cooked.atvrAfter = reports[m].after.atvr;
+		std::memcpy(cooked.boundsMin, &mesh.getBounds().min, sizeof(cooked.boundsMin));
+		std::memcpy(cooked.boundsMax, &mesh.getBounds().max, sizeof(cooked.boundsMax));
+		std::memcpy(cooked.sphereCenter, &mesh.getSphere().center, sizeof(cooked.sphereCenter));
+		cooked.sphereRadius = mesh.getSphere().radius;
+		// the levels are stored back to back, their counts are enough to find them again
+		cooked.lodCount = mesh.getLodCount();
+		for (unsigned int l = 0; l < mesh.getLodCount(); l++) {
+			cooked.lodIndexCount[l] = mesh.getLod(l).indexCount;
+			cooked.lodError[l] = mesh.getLod(l).error;
+		}
+		cooked.firstMeshlet = (uint32_t) cookedMeshlets.size();
+		cooked.meshletCount = (uint32_t) mesh.getMeshlets().size();
+		for (const Meshlet& meshlet : mesh.getMeshlets()) {
+			CookedMeshlet c{};
+			c.firstIndex = meshlet.firstIndex;
+			c.indexCount = meshlet.indexCount;
+			std::memcpy(c.sphereCenter, &meshlet.sphere.center, sizeof(c.sphereCenter));
+			c.sphereRadius = meshlet.sphere.radius;
+			std::memcpy(c.coneAxis, &meshlet.coneAxis, sizeof(c.coneAxis));
+			c.coneCutoff = meshlet.coneCutoff;
+			cookedMeshlets.push_back(c);
+		}
+		cookedMeshes.push_back(cooked);
+
+		vertexCount += cooked.vertexCount;
+		indexCount += cooked.indexCount;
+	}
+
+	std::vector<CookedNode> cookedNodes;
+	std::vector<uint32_t> nodeMeshes;
+	for (const ModelNode& node : nodes) {
+		CookedNode cooked{};
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				cooked.transform[c * 4 + r] = node.transform[c][r];
+			}
+		}
+		cooked.parent = node.parent;
+		cooked.firstMesh = (uint32_t) nodeMeshes.size();
+		cooked.meshCount = (uint32_t) node.meshes.size();
+		cooked.name = addString(node.name);
+		nodeMeshes.insert(nodeMeshes.end(), node.meshes.begin(), node.meshes.end());
+		cookedNodes.push_back(cooked);
+	}
+
+	std::vector<unsigned char> image(sizeof(CookedHeader));
+	image.reserve(sizeof(CookedHeader) + vertexCount * sizeof(Vertex) + indexCount * sizeof(unsigned int) + strings.size() + 4096);
+	header.meshCount = (uint32_t) cookedMeshes.size();
+	header.meshesOffset = append(image, cookedMeshes.data(), cookedMeshes.size() * sizeof(CookedMesh), 8);
+	header.materialCount = (uint32_t) materials.size();
+	header.materialsOffset = append(image, materials.data(), materials.size() * sizeof(CookedMaterial), 4);
+	header.textureRefCount = (uint32_t) textureRefs.size();
+	header.textureRefsOffset = append(image, textureRefs.data(), textureRefs.size() * sizeof(CookedTextureRef), 4);
+	header.nodeCount = (uint32_t) cookedNodes.size();
+	header.nodesOffset = append(image, cookedNodes.data(), cookedNodes.size() * sizeof(CookedNode), 4);
+	header.nodeMeshCount = (uint32_t) nodeMeshes.size();
+	header.nodeMeshesOffset = append(image, nodeMeshes.data(), nodeMeshes.size() * sizeof(uint32_t), 4);
+	header.stringBytes = (uint32_t) strings.size();
+	header.stringsOffset = append(image, strings.data(), strings.size(), 1);
+	header.meshletCount = (uint32_t) cookedMeshlets.size();
+	header.meshletsOffset = append(image, cookedMeshlets.data(), cookedMeshlets.size() * sizeof(CookedMeshlet), 4);
+
+	header.verticesOffset = append(image, nullptr, 0, 16);
+	for (const Mesh& mesh : meshes) {
+		append(image, mesh.getVertexData(), mesh.getVertexCount() * sizeof(Vertex), 1);
+	}
+	header.indicesOffset = append(image, nullptr, 0, 4);
+	for (const Mesh& mesh : meshes) {
+		append(image, mesh.getIndexData(), mesh.getTotalIndexCount() * sizeof(unsigned int), 1);
+	}
+
+	header.fileSize = image.size();
+	header.checksum = fnv1a(image.data() + sizeof(CookedHeader), image.size() - sizeof(CookedHeader));
+	std::memcpy(image.data(), &header, sizeof(CookedHeader));
+
+	std::string tempPath = cookedPath + ".tmp";
+	{
+		std::ofstream out{ tempPath, std::ios::binary | std::ios::trunc };
+		out.write((const char*) image.data(), (std::streamsize) image.size());
+		if (!out) {
+			std::cout << "ERROR::COOKED_MODEL::WRITE_FAILED " << cookedPath << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cookedPath, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		std::cout << "ERROR::COOKED_MODEL::WRITE_FAILED " << cookedPath << std::endl;
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
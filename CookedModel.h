@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+struct Vertex;
+struct ModelNode;
+struct MeshOptimizeReport;
+class Mesh;
+
+#define COOKED_MODEL_MAGIC 0x424C444Du // "MDLB"
+#define COOKED_MODEL_VERSION 5
+#define COOKED_MODEL_EXTENSION ".mdlbin"
+// level slots per mesh, matches MESH_LOD_MAX
+#define COOKED_MODEL_MAX_LODS 4
+
+// On disk layout of a cooked model: this header, then the tables and blobs it
+// points at. Offsets are from the start of the file, vertex and index blobs are
+// laid out exactly as glBufferData wants them.
+struct CookedHeader {
+	uint32_t magic;
+	uint32_t version;
+	// size and modification time of the file it was cooked from, stale when either changes
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	// FNV-1a over every byte after the header
+	uint64_t checksum;
+	uint64_t fileSize;
+
+	uint32_t meshCount;
+	uint32_t materialCount;
+	uint32_t textureRefCount;
+	uint32_t nodeCount;
+	uint32_t nodeMeshCount;
+	uint32_t stringBytes;
+	uint32_t meshletCount;
+	uint32_t pad;
+
+	uint64_t meshesOffset;
+	uint64_t materialsOffset;
+	uint64_t textureRefsOffset;
+	uint64_t nodesOffset;
+	uint64_t nodeMeshesOffset;
+	uint64_t stringsOffset;
+	uint64_t meshletsOffset;
+	uint64_t verticesOffset;
+	uint64_t indicesOffset;
+};
+
+struct CookedMesh {
+	uint64_t firstVertex;
+	uint64_t firstIndex;
+	uint32_t vertexCount;
+	// every level's indices, one after another
+	uint32_t indexCount;
+	uint32_t material;
+	// before welding, for the memory report
+	uint32_t sourceVertexCount;
+	// vertex cache numbers from the import time optimizer
+	float acmrBefore, acmrAfter;
+	float atvrBefore, atvrAfter;
+	float boundsMin[3];
+	float boundsMax[3];
+	float sphereCenter[3];
+	float sphereRadius;
+	uint32_t lodCount;
+	uint32_t lodIndexCount[COOKED_MODEL_MAX_LODS];
+	float lodError[COOKED_MODEL_MAX_LODS];
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+};
+
+// firstIndex is relative to the mesh's indices, like Meshlet
+struct CookedMeshlet {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float sphereCenter[3];
+	float sphereRadius;
+	float coneAxis[3];
+	float coneCutoff;
+};
+
+struct CookedMaterial {
+	uint32_t firstTextureRef;
+	uint32_t textureRefCount;
+};
+
+// type and path are offsets into the string table
+struct CookedTextureRef {
+	uint32_t type;
+	uint32_t path;
+};
+
+struct CookedNode {
+	float transform[16];
+	int32_t parent;
+	uint32_t firstMesh;
+	uint32_t meshCount;
+	uint32_t name;
+};
+
+// A validated, memory mapped cooked model. Vertex and index pointers point into
+// the mapping and stay valid for as long as this object lives.
+class CookedModel {
+private:
+	MappedFile file;
+	const CookedHeader* header;
+
+	template<typename T>
+	const T* table(uint64_t offset) const;
+
+public:
+	CookedModel();
+
+	// false when the file is missing, stale, from another version or fails its checksum
+	bool open(const std::string& cookedPath, const std::string& sourcePath);
+
+	// the whole mapping, what keeping the file open costs
+	size_t getFileSize() const;
+	unsigned int getMeshCount() const;
+	const CookedMesh& getMesh(unsigned int mesh) const;
+	const Vertex* getVertices(const CookedMesh& mesh) const;
+	const unsigned int* getIndices(const CookedMesh& mesh) const;
+	const CookedMeshlet& getMeshlet(unsigned int meshlet) const;
+
+	const CookedMaterial& getMaterial(unsigned int material) const;
+	const CookedTextureRef& getTextureRef(unsigned int ref) const;
+
+	unsigned int getNodeCount() const;
+	const CookedNode& getNode(unsigned int node) const;
+	unsigned int getNodeMesh(unsigned int index) const;
+
+	const char* getString(uint32_t offset) const;
+};
+
+// cookedPath is normally sourcePath + COOKED_MODEL_EXTENSION. The file goes through a
+// temporary first so a crash never leaves a half written one behind
+bool writeCookedModel(const std::string& cookedPath, const std::string& sourcePath,
+	const std::vector<Mesh>& meshes, const std::vector<MeshOptimizeReport>& reports, const std::vector<ModelNode>& nodes);
\ No newline at end of file
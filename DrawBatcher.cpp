@@ -0,0 +1,126 @@
+#include "DrawBatcher.h"
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Shader.h"
+#include "Mesh.h"
+#include "GLState.h"
+
+DrawBatcher::DrawBatcher()
+	: maxDraws(0)
+{}
+
+const DrawBatcher::ProgramHandles& DrawBatcher::getHandles(Shader& shader) {
+	auto it = programs.find(shader.getID());
+	if (it == programs.end()) {
+		ProgramHandles handles{ shader.getUniform("drawData"), shader.getUniform("drawBase"), shader.getUniform("drawIndex") };
+		it = programs.emplace(shader.getID(), handles).first;
+	}
+	return it->second;
+}
+
+bool DrawBatcher::accepts(Shader& shader) {
+	return getHandles(shader).drawData.isValid();
+}
+
+void DrawBatcher::add(Shader& shader, Mesh& mesh, const glm::mat4& model, unsigned int lod, const MeshletRange* ranges,
+	unsigned int rangeCount) {
+	if (rangeCount == 0) {
+		addDraw(shader, mesh, model, mesh.getLod(lod).firstIndex, mesh.getLod(lod).indexCount);
+	}
+	for (unsigned int i = 0; i < rangeCount; i++) {
+		addDraw(shader, mesh, model, ranges[i].firstIndex, ranges[i].indexCount);
+	}
+}
+
+void DrawBatcher::addDraw(Shader& shader, Mesh& mesh, const glm::mat4& model, unsigned int firstIndex, unsigned int indexCount) {
+	if (maxDraws == 0) {
+		GLint texels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+		maxDraws = (unsigned int) texels / DRAW_DATA_TEXELS;
+	}
+	if (counts.size() == maxDraws) flush();
+
+	const VertexDequantize& dequantize = mesh.getDequantize();
+	drawData.insert(drawData.end(), { model[0], model[1], model[2], model[3],
+		glm::vec4{ dequantize.positionScale, dequantize.octahedralNormals ? 1.0f : 0.0f }, glm::vec4{ dequantize.positionOffset, 0.0f } });
+
+	GeometryRange range = mesh.getGeometryRange();
+	unsigned int draw = (unsigned int) counts.size();
+	counts.push_back((int) indexCount);
+	offsets.push_back((const void*) (range.indexOffset + (size_t) firstIndex * mesh.getIndexSize()));
+	baseVertices.push_back(range.baseVertex);
+	stats.draws++;
+
+	if (!batches.empty()) {
+		Batch& last = batches.back();
+		if (last.shader == &shader && last.mesh->getMaterialID() == mesh.getMaterialID()
+			&& last.mesh->getVAO() == range.vertexArray && last.mesh->getIndexType() == mesh.getIndexType()) {
+			last.count++;
+			return;
+		}
+	}
+	batches.push_back(Batch{ &shader, &mesh, draw, 1 });
+}
+
+void DrawBatcher::flush() {
+	if (batches.empty()) return;
+
+	if (dataBuffer.get() == 0) {
+		dataBuffer.create();
+		dataTexture.create();
+		glBindBuffer(GL_TEXTURE_BUFFER, dataBuffer.get());
+		GLState::activeTexture(DRAW_DATA_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_BUFFER, dataTexture.get());
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, dataBuffer.get());
+	}
+
+	// orphaned every flush, the previous frame's draws may still be reading it
+	glBindBuffer(GL_TEXTURE_BUFFER, dataBuffer.get());
+	glBufferData(GL_TEXTURE_BUFFER, drawData.size() * sizeof(glm::vec4), drawData.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	GLState::activeTexture(DRAW_DATA_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, dataTexture.get());
+
+	for (const Batch& batch : batches) {
+		Shader& shader = *batch.shader;
+		const ProgramHandles& handles = getHandles(shader);
+		shader.use();
+		shader.setInt(handles.drawData, DRAW_DATA_TEXTURE_UNIT);
+		shader.setInt(handles.drawBase, (int) batch.first);
+		batch.mesh->bindTextures(shader);
+		GLState::bindVertexArray(batch.mesh->getVAO());
+
+		unsigned int indexType = batch.mesh->getIndexType();
+		if (handles.drawIndex.isValid()) {
+			for (unsigned int d = 0; d < batch.count; d++) {
+				unsigned int draw = batch.first + d;
+				shader.setInt(handles.drawIndex, (int) d);
+				glDrawElementsBaseVertex(GL_TRIANGLES, counts[draw], indexType, offsets[draw], baseVertices[draw]);
+			}
+			stats.drawCalls += batch.count;
+		}
+		else {
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, &counts[batch.first], indexType, &offsets[batch.first],
+				(GLsizei) batch.count, &baseVertices[batch.first]);
+			stats.drawCalls++;
+		}
+	}
+
+	drawData.clear();
+	batches.clear();
+	counts.clear();
+	offsets.clear();
+	baseVertices.clear();
+}
+
+void DrawBatcher::resetStats() {
+	stats = Stats{};
+}
+
+const DrawBatcher::Stats& DrawBatcher::getStats() const {
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.h"
+#include "Mesh.h"
+#include "GLHandle.h"
+
+// the per-draw buffer's texture unit, clear of the units materials use
+#define DRAW_DATA_TEXTURE_UNIT 15
+// vec4 texels per draw, the layout is described in vShaderBatched.vert
+#define DRAW_DATA_TEXELS 6
+
+// Collects draws for programs that read their model matrix and dequantization from a buffer
+// texture instead of uniforms, and merges runs sharing program, material, VAO and index type
+// into one glMultiDrawElementsBaseVertex. Each draw finds its data at drawBase + gl_DrawIDARB.
+// Programs compiled without draw parameters declare drawIndex instead and get a call per draw.
+class DrawBatcher {
+public:
+	struct Stats {
+		unsigned int draws = 0;
+		unsigned int drawCalls = 0;
+	};
+
+private:
+	struct ProgramHandles {
+		UniformHandle drawData;
+		UniformHandle drawBase;
+		UniformHandle drawIndex;
+	};
+
+	struct Batch {
+		Shader* shader;
+		Mesh* mesh;
+		unsigned int first;
+		unsigned int count;
+	};
+
+	GLBuffer dataBuffer;
+	GLTexture dataTexture;
+	// GL_MAX_TEXTURE_BUFFER_SIZE in draws, add() flushes early past it
+	unsigned int maxDraws;
+
+	std::vector<glm::vec4> drawData;
+	std::vector<Batch> batches;
+	// glMultiDrawElementsBaseVertex arguments, one entry per draw
+	std::vector<int> counts;
+	std::vector<const void*> offsets;
+	std::vector<int> baseVertices;
+
+	std::unordered_map<unsigned int, ProgramHandles> programs;
+	Stats stats;
+
+	const ProgramHandles& getHandles(Shader& shader);
+	void addDraw(Shader& shader, Mesh& mesh, const glm::mat4& model, unsigned int firstIndex, unsigned int indexCount);
+
+public:
+	DrawBatcher();
+
+	// whether shader takes its per-draw data from the batcher
+	bool accepts(Shader& shader);
+	// draws are merged with the previous one when they can share a call. With ranges, each one
+	// is a draw of its own in the same batch
+	void add(Shader& shader, Mesh& mesh, const glm::mat4& model, unsigned int lod = 0, const MeshletRange* ranges = nullptr,
+		unsigned int rangeCount = 0);
+	// uploads the per-draw data and issues every batch, leaves the batcher empty
+	void flush();
+
+	void resetStats();
+	const Stats& getStats() const;
+};
\ No newline at end of file
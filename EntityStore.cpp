@@ -0,0 +1,143 @@
+#include "EntityStore.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "Bounds.h"
+#include "JobSystem.h"
+#include "UniformBuffers.h"
+
+EntityStore::EntityStore()
+	: aliveCount(0)
+{}
+
+Entity EntityStore::create() {
+	uint32_t index;
+	if (!freeIndices.empty()) {
+		index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else {
+		index = (uint32_t) generations.size();
+		// the last index is never handed out, so no live handle equals ENTITY_NULL
+		if (index >= ENTITY_INDEX_MASK) {
+			std::cout << "ERROR::ENTITY_STORE::OUT_OF_ENTITIES" << std::endl;
+			return ENTITY_NULL;
+		}
+		generations.push_back(0);
+	}
+	aliveCount++;
+	return ((uint32_t) generations[index] << ENTITY_INDEX_BITS) | index;
+}
+
+void EntityStore::destroy(Entity entity) {
+	if (!isAlive(entity)) return;
+	transforms.remove(entity);
+	renderables.remove(entity);
+	bounds.remove(entity);
+	lights.remove(entity);
+
+	uint32_t index = entity & ENTITY_INDEX_MASK;
+	generations[index]++;
+	freeIndices.push_back(index);
+	aliveCount--;
+}
+
+bool EntityStore::isAlive(Entity entity) const {
+	uint32_t index = entity & ENTITY_INDEX_MASK;
+	return entity != ENTITY_NULL && index < generations.size() && generations[index] == (entity >> ENTITY_INDEX_BITS);
+}
+
+unsigned int EntityStore::size() const { return aliveCount; }
+
+void EntityStore::clear() {
+	generations.clear();
+	freeIndices.clear();
+	aliveCount = 0;
+	transforms.clear();
+	renderables.clear();
+	bounds.clear();
+	lights.clear();
+}
+
+void EntityStore::sortComponents() {
+	renderables.sortLike(transforms);
+	bounds.sortLike(transforms);
+	lights.sortLike(transforms);
+}
+
+ComponentArray<TransformComponent>& EntityStore::getTransforms() { return transforms; }
+ComponentArray<RenderableComponent>& EntityStore::getRenderables() { return renderables; }
+ComponentArray<BoundsComponent>& EntityStore::getBounds() { return bounds; }
+ComponentArray<LightComponent>& EntityStore::getLights() { return lights; }
+const ComponentArray<TransformComponent>& EntityStore::getTransforms() const { return transforms; }
+const ComponentArray<RenderableComponent>& EntityStore::getRenderables() const { return renderables; }
+const ComponentArray<BoundsComponent>& EntityStore::getBounds() const { return bounds; }
+const ComponentArray<LightComponent>& EntityStore::getLights() const { return lights; }
+
+void updateTransforms(EntityStore& store, JobSystem* jobs) {
+	forEachComponent(store.getTransforms(), jobs, [](Entity, TransformComponent& transform) {
+		glm::mat4 world = glm::translate(glm::mat4{ 1.0f }, transform.position);
+		if (transform.angle != 0.0f) world = glm::rotate(world, transform.angle, transform.axis);
+		transform.world = glm::scale(world, glm::vec3{ transform.scale });
+	});
+}
+
+void updateBounds(EntityStore& store, JobSystem* jobs) {
+	const ComponentArray<TransformComponent>& transforms = store.getTransforms();
+	forEachComponent(store.getBounds(), jobs, [&transforms](Entity entity, BoundsComponent& bounds) {
+		const TransformComponent* transform = transforms.get(entity);
+		if (transform != nullptr) bounds.world = bounds.local.transform(transform->world);
+	});
+}
+
+unsigned int cullRenderables(const EntityStore& store, const Frustum& frustum, std::vector<Entity>& visible) {
+	const ComponentArray<BoundsComponent>& bounds = store.getBounds();
+	const ComponentArray<RenderableComponent>& renderables = store.getRenderables();
+	size_t first = visible.size();
+	for (size_t i = 0; i < bounds.size(); i++) {
+		Entity entity = bounds.getEntity(i);
+		if (frustum.intersects(bounds.data()[i].world) && renderables.has(entity)) visible.push_back(entity);
+	}
+	return (unsigned int) (visible.size() - first);
+}
+
+// how far the light reaches before its brightest channel drops under one step of an 8 bit target
+static float lightRange(const LightComponent& light) {
+	float brightest = std::max(light.color.r, std::max(light.color.g, light.color.b));
+	float reach = 256.0f * brightest - light.constant;
+	if (reach <= 0.0f) return 0.0f;
+	if (light.quadratic > 0.0f) {
+		return (-light.linear + std::sqrt(light.linear * light.linear + 4.0f * light.quadratic * reach)) / (2.0f * light.quadratic);
+	}
+	return (light.linear > 0.0f) ? reach / light.linear : FLT_MAX;
+}
+
+unsigned int gatherLights(const EntityStore& store, const Frustum& frustum, PointLightUniform* out, unsigned int maxLights) {
+	const ComponentArray<LightComponent>& lights = store.getLights();
+	const ComponentArray<TransformComponent>& transforms = store.getTransforms();
+	unsigned int count = 0;
+	for (size_t i = 0; i < lights.size() && count < maxLights; i++) {
+		const LightComponent& light = lights.data()[i];
+		const TransformComponent* transform = transforms.get(lights.getEntity(i));
+		if (transform == nullptr) continue;
+
+		glm::vec3 position{ transform->world[3] };
+		if (!frustum.intersects(BoundingSphere{ position, lightRange(light) })) continue;
+
+		PointLightUniform& uniform = out[count++];
+		uniform.position = position;
+		uniform.ambient = light.color * glm::vec3(0.2);
+		uniform.diffuse = light.color * glm::vec3(0.5);
+		uniform.specular = light.color * glm::vec3(1.0);
+		uniform.constant = light.constant;
+		uniform.linear = light.linear;
+		uniform.quadratic = light.quadratic;
+	}
+	return count;
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Bounds.h"
+#include "JobSystem.h"
+
+struct PointLightUniform;
+
+// index in the low bits, a generation above it so a handle to a destroyed entity never
+// matches whatever reuses its slot
+typedef uint32_t Entity;
+#define ENTITY_INDEX_BITS 24
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+#define ENTITY_NULL 0xffffffffu
+// components per task when a system runs as jobs
+#define ENTITY_PARALLEL_GRAIN 4096
+
+struct TransformComponent {
+	glm::vec3 position{ 0.0f };
+	float scale = 1.0f;
+	glm::vec3 axis{ 0.0f, 1.0f, 0.0f };
+	float angle = 0.0f;
+	// written by updateTransforms()
+	glm::mat4 world{ 1.0f };
+};
+
+// ids into whatever the program keeps its meshes and materials in
+struct RenderableComponent {
+	unsigned int mesh = 0;
+	unsigned int material = 0;
+};
+
+struct BoundsComponent {
+	AABB local;
+	// written by updateBounds()
+	AABB world;
+};
+
+struct LightComponent {
+	glm::vec3 color{ 1.0f };
+	float constant = 1.0f;
+	float linear = 0.09f;
+	float quadratic = 0.032f;
+};
+
+// One component type as a sparse set: the values packed in a dense array next to the
+// entity owning each, and a sparse array from entity index to dense slot. Systems walk
+// the dense array, removal moves the last value into the hole so it stays packed.
+template <typename T>
+class ComponentArray {
+private:
+	std::vector<T> values;
+	std::vector<Entity> entities;
+	std::vector<uint32_t> sparse;
+
+	void swapSlots(uint32_t a, uint32_t b) {
+		std::swap(values[a], values[b]);
+		std::swap(entities[a], entities[b]);
+		sparse[entities[a] & ENTITY_INDEX_MASK] = a;
+		sparse[entities[b] & ENTITY_INDEX_MASK] = b;
+	}
+
+public:
+	// replaces the entity's value if it already has one
+	T& add(Entity entity, const T& value) {
+		uint32_t index = entity & ENTITY_INDEX_MASK;
+		if (index >= sparse.size()) sparse.resize(index + 1, ENTITY_NULL);
+		uint32_t slot = sparse[index];
+		if (slot != ENTITY_NULL && entities[slot] == entity) {
+			values[slot] = value;
+			return values[slot];
+		}
+		sparse[index] = (uint32_t) values.size();
+		values.push_back(value);
+		entities.push_back(entity);
+		return values.back();
+	}
+
+	void remove(Entity entity) {
+		if (!has(entity)) return;
+		uint32_t slot = sparse[entity & ENTITY_INDEX_MASK];
+		swapSlots(slot, (uint32_t) values.size() - 1);
+		sparse[entity & ENTITY_INDEX_MASK] = ENTITY_NULL;
+		values.pop_back();
+		entities.pop_back();
+	}
+
+	bool has(Entity entity) const {
+		uint32_t index = entity & ENTITY_INDEX_MASK;
+		return index < sparse.size() && sparse[index] != ENTITY_NULL && entities[sparse[index]] == entity;
+	}
+
+	// nullptr when the entity has none
+	T* get(Entity entity) { return has(entity) ? &values[sparse[entity & ENTITY_INDEX_MASK]] : nullptr; }
+	const T* get(Entity entity) const { return has(entity) ? &values[sparse[entity & ENTITY_INDEX_MASK]] : nullptr; }
+
+	void clear() {
+		values.clear();
+		entities.clear();
+		sparse.clear();
+	}
+
+	void reserve(size_t count) {
+		values.reserve(count);
+		entities.reserve(count);
+	}
+
+	// moves the entities other also has to the front, in other's order, so a system joining
+	// the two walks both arrays forward instead of jumping around
+	template <typename U>
+	void sortLike(const ComponentArray<U>& other) {
+		uint32_t next = 0;
+		for (size_t i = 0; i < other.size(); i++) {
+			Entity entity = other.getEntity(i);
+			if (has(entity)) swapSlots(sparse[entity & ENTITY_INDEX_MASK], next++);
+		}
+	}
+
+	size_t size() const { return values.size(); }
+	T* data() { return values.data(); }
+	const T* data() const { return values.data(); }
+	Entity getEntity(size_t slot) const { return entities[slot]; }
+	const Entity* getEntities() const { return entities.data(); }
+};
+
+// Entities are only handles, everything about them lives in the component arrays.
+class EntityStore {
+private:
+	std::vector<uint8_t> generations;
+	std::vector<uint32_t> freeIndices;
+	unsigned int aliveCount;
+
+	ComponentArray<TransformComponent> transforms;
+	ComponentArray<RenderableComponent> renderables;
+	ComponentArray<BoundsComponent> bounds;
+	ComponentArray<LightComponent> lights;
+
+public:
+	EntityStore();
+
+	Entity create();
+	// drops the entity's components, its handle stops being alive
+	void destroy(Entity entity);
+	bool isAlive(Entity entity) const;
+	unsigned int size() const;
+	void clear();
+
+	// orders the other arrays like transforms, worth it after many creates and destroys
+	void sortComponents();
+
+	ComponentArray<TransformComponent>& getTransforms();
+	ComponentArray<RenderableComponent>& getRenderables();
+	ComponentArray<BoundsComponent>& getBounds();
+	ComponentArray<LightComponent>& getLights();
+	const ComponentArray<TransformComponent>& getTransforms() const;
+	const ComponentArray<RenderableComponent>& getRenderables() const;
+	const ComponentArray<BoundsComponent>& getBounds() const;
+	const ComponentArray<LightComponent>& getLights() const;
+};
+
+// calls fn(entity, component) for every component in the array, split into jobs when there
+// is a job system. fn must only write to that entity's components
+template <typename T, typename Fn>
+void forEachComponent(ComponentArray<T>& components, JobSystem* jobs, const Fn& fn) {
+	unsigned int count = (unsigned int) components.size();
+	T* values = components.data();
+	const Entity* entities = components.getEntities();
+	if (jobs == nullptr || count <= ENTITY_PARALLEL_GRAIN) {
+		for (unsigned int i = 0; i < count; i++) fn(entities[i], values[i]);
+		return;
+	}
+	jobs->parallelFor((count + ENTITY_PARALLEL_GRAIN - 1) / ENTITY_PARALLEL_GRAIN, [&](unsigned int chunk) {
+		unsigned int end = std::min(count, (chunk + 1) * ENTITY_PARALLEL_GRAIN);
+		for (unsigned int i = chunk * ENTITY_PARALLEL_GRAIN; i < end; i++) fn(entities[i], values[i]);
+	});
+}
+
+// world matrices from position, axis and angle, and scale
+void updateTransforms(EntityStore& store, JobSystem* jobs = nullptr);
+// world boxes from the local ones and the entity's transform, entities without one keep theirs
+void updateBounds(EntityStore& store, JobSystem* jobs = nullptr);
+// appends the renderables whose world bounds are inside frustum to visible, returns how many
+unsigned int cullRenderables(const EntityStore& store, const Frustum& frustum, std::vector<Entity>& visible);
+// fills out with up to maxLights lights that reach into frustum, returns how many
+unsigned int gatherLights(const EntityStore& store, const Frustum& frustum, PointLightUniform* out, unsigned int maxLights);
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "GLHandle.h"
+#include <glad.h>
+
+#include "GLState.h"
+
+unsigned int GLBufferTraits::create() {
+	unsigned int id;
+	glGenBuffers(1, &id);
+	return id;
+}
+
+void GLBufferTraits::destroy(unsigned int id) {
+	glDeleteBuffers(1, &id);
+}
+
+unsigned int GLVertexArrayTraits::create() {
+	unsigned int id;
+	glGenVertexArrays(1, &id);
+	return id;
+}
+
+void GLVertexArrayTraits::destroy(unsigned int id) {
+	GLState::vertexArrayDeleted(id);
+	glDeleteVertexArrays(1, &id);
+}
+
+unsigned int GLTextureTraits::create() {
+	unsigned int id;
+	glGenTextures(1, &id);
+	return id;
+}
+
+void GLTextureTraits::destroy(unsigned int id) {
+	GLState::textureDeleted(id);
+	glDeleteTextures(1, &id);
+}
\ No newline at end of file
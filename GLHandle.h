@@ -0,0 +1,60 @@
+#pragma once
+
+// Owns one GL object name and deletes it on destruction. Move only, a moved from
+// or empty handle holds 0, which is never deleted.
+template <typename Traits>
+class GLHandle {
+private:
+	unsigned int id;
+
+public:
+	GLHandle() : id(0) {}
+	~GLHandle() { reset(); }
+
+	GLHandle(const GLHandle&) = delete;
+	GLHandle& operator=(const GLHandle&) = delete;
+
+	GLHandle(GLHandle&& other) noexcept : id(other.id) { other.id = 0; }
+	GLHandle& operator=(GLHandle&& other) noexcept {
+		if (this != &other) {
+			reset();
+			id = other.id;
+			other.id = 0;
+		}
+		return *this;
+	}
+
+	// a fresh object, the old one is deleted first
+	void create() {
+		reset();
+		id = Traits::create();
+	}
+
+	void reset() {
+		if (id != 0) {
+			Traits::destroy(id);
+			id = 0;
+		}
+	}
+
+	unsigned int get() const { return id; }
+};
+
+struct GLBufferTraits {
+	static unsigned int create();
+	static void destroy(unsigned int id);
+};
+
+struct GLVertexArrayTraits {
+	static unsigned int create();
+	static void destroy(unsigned int id);
+};
+
+struct GLTextureTraits {
+	static unsigned int create();
+	static void destroy(unsigned int id);
+};
+
+typedef GLHandle<GLBufferTraits> GLBuffer;
+typedef GLHandle<GLVertexArrayTraits> GLVertexArray;
+typedef GLHandle<GLTextureTraits> GLTexture;
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "GLState.h"
+#include <glad.h>
+
+// ~0u marks state we do not know, the next call always goes through
+unsigned int GLState::program = ~0u;
+unsigned int GLState::vertexArray = ~0u;
+unsigned int GLState::activeUnit = ~0u;
+unsigned int GLState::textures[MAX_TEXTURE_UNITS] = {};
+unsigned int GLState::polygonMode = GL_FILL;
+GLState::Stats GLState::stats{};
+
+void GLState::resetFrameStats() {
+	stats = Stats{};
+}
+
+void GLState::invalidate() {
+	program = ~0u;
+	vertexArray = ~0u;
+	activeUnit = ~0u;
+	for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+		textures[i] = ~0u;
+	}
+
+	GLint modes[2];
+	glGetIntegerv(GL_POLYGON_MODE, modes);
+	polygonMode = modes[1];
+}
+
+void GLState::vertexArrayDeleted(unsigned int vertexArray) {
+	if (GLState::vertexArray == vertexArray) {
+		GLState::vertexArray = 0;
+	}
+}
+
+void GLState::textureDeleted(unsigned int texture) {
+	for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+		if (textures[i] == texture) {
+			textures[i] = 0;
+		}
+	}
+}
+
+void GLState::useProgram(unsigned int program) {
+	if (GLState::program == program) {
+		stats.filtered++;
+		return;
+	}
+	stats.issued++;
+	GLState::program = program;
+	glUseProgram(program);
+}
+
+void GLState::bindVertexArray(unsigned int vertexArray) {
+	if (GLState::vertexArray == vertexArray) {
+		stats.filtered++;
+		return;
+	}
+	stats.issued++;
+	GLState::vertexArray = vertexArray;
+	glBindVertexArray(vertexArray);
+}
+
+void GLState::activeTexture(unsigned int unit) {
+	if (activeUnit == unit) {
+		stats.filtered++;
+		return;
+	}
+	stats.issued++;
+	activeUnit = unit;
+	glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::bindTexture(unsigned int unit, unsigned int texture) {
+	if (textures[unit] == texture) {
+		stats.filtered++;
+		return;
+	}
+	activeTexture(unit);
+	stats.issued++;
+	textures[unit] = texture;
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GLState::setPolygonMode(unsigned int mode) {
+	if (polygonMode == mode) {
+		stats.filtered++;
+		return;
+	}
+	stats.issued++;
+	polygonMode = mode;
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+unsigned int GLState::getProgram() { return program; }
+unsigned int GLState::getVertexArray() { return vertexArray; }
+unsigned int GLState::getTexture(unsigned int unit) { return textures[unit]; }
+unsigned int GLState::getPolygonMode() { return polygonMode; }
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#define MAX_TEXTURE_UNITS 32
+
+// Shadow copy of the GL state the renderer touches. Calls that would not
+// change anything are dropped and queries are answered from the copy, so
+// everything that binds programs, VAOs or 2D textures must go through here.
+class GLState {
+public:
+	struct Stats {
+		unsigned int issued = 0;
+		unsigned int filtered = 0;
+		unsigned int uniformsIssued = 0;
+		unsigned int uniformsFiltered = 0;
+	};
+
+private:
+	static unsigned int program;
+	static unsigned int vertexArray;
+	static unsigned int activeUnit;
+	static unsigned int textures[MAX_TEXTURE_UNITS];
+	static unsigned int polygonMode;
+
+public:
+	static Stats stats;
+	static void resetFrameStats();
+
+	// forget the shadow copy, for after code that changed state behind our back
+	static void invalidate();
+	// GL unbinds objects as they are deleted, these keep the shadow copy in step
+	static void vertexArrayDeleted(unsigned int vertexArray);
+	static void textureDeleted(unsigned int texture);
+
+	static void useProgram(unsigned int program);
+	static void bindVertexArray(unsigned int vertexArray);
+	static void activeTexture(unsigned int unit);
+	static void bindTexture(unsigned int unit, unsigned int texture);
+	static void setPolygonMode(unsigned int mode);
+
+	static unsigned int getProgram();
+	static unsigned int getVertexArray();
+	static unsigned int getTexture(unsigned int unit);
+	static unsigned int getPolygonMode();
+};
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "GeometryHeap.h"
+#include <glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "GLState.h"
+
+std::vector<std::unique_ptr<GeometryHeap::Page>> GeometryHeap::pages;
+std::vector<GeometryHeap::Slot> GeometryHeap::slots;
+std::vector<unsigned int> GeometryHeap::freeSlots;
+
+unsigned int GeometryHeap::createPage(VertexFormat format, unsigned int vertexCapacity, unsigned int indexCapacity) {
+	unsigned int p = 0;
+	while (p < pages.size() && pages[p]) p++;
+	if (p == pages.size()) pages.emplace_back();
+	pages[p] = std::make_unique<Page>();
+
+	Page& page = *pages[p];
+	page.format = format;
+	page.vertices.reset(vertexCapacity);
+	page.indices.reset(indexCapacity);
+	page.allocations = 0;
+
+	// storage only, meshes fill their ranges as they allocate them
+	page.vertexBuffer.create();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page.vertexBuffer.get());
+	glBufferData(GL_COPY_WRITE_BUFFER, (size_t) vertexCapacity * getVertexStride(format), NULL, GL_STATIC_DRAW);
+	page.indexBuffer.create();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page.indexBuffer.get());
+	glBufferData(GL_COPY_WRITE_BUFFER, (size_t) indexCapacity * GEOMETRY_INDEX_UNIT, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	page.vertexArray.create();
+	bindPageBuffers(page);
+	return p;
+}
+
+void GeometryHeap::bindPageBuffers(Page& page) {
+	GLState::bindVertexArray(page.vertexArray.get());
+	glBindBuffer(GL_ARRAY_BUFFER, page.vertexBuffer.get());
+	setVertexAttributes(page.format);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.indexBuffer.get());
+	GLState::bindVertexArray(0);
+}
+
+GeometryAllocation GeometryHeap::allocate(VertexFormat format, const void* vertices, unsigned int vertexCount,
+	const void* indices, size_t indexBytes) {
+	unsigned int stride = getVertexStride(format);
+	unsigned int indexUnits = (unsigned int) ((indexBytes + GEOMETRY_INDEX_UNIT - 1) / GEOMETRY_INDEX_UNIT);
+
+	// first page of the format with room for both halves
+	Slot slot{ TLSFAllocator::NO_SPACE, TLSFAllocator::NO_SPACE, TLSFAllocator::NO_SPACE, true };
+	for (unsigned int p = 0; p < pages.size() && slot.page == TLSFAllocator::NO_SPACE; p++) {
+		if (!pages[p] || pages[p]->format != format) continue;
+		unsigned int vertexBlock = pages[p]->vertices.allocate(vertexCount);
+		if (vertexBlock == TLSFAllocator::NO_SPACE) continue;
+		unsigned int indexBlock = pages[p]->indices.allocate(indexUnits);
+		if (indexBlock == TLSFAllocator::NO_SPACE) {
+			pages[p]->vertices.free(vertexBlock);
+			continue;
+		}
+		slot = Slot{ p, vertexBlock, indexBlock, true };
+	}
+	if (slot.page == TLSFAllocator::NO_SPACE) {
+		unsigned int p = createPage(format, std::max((unsigned int) GEOMETRY_PAGE_VERTEX_BYTES / stride, vertexCount),
+			std::max((unsigned int) GEOMETRY_PAGE_INDEX_BYTES / GEOMETRY_INDEX_UNIT, indexUnits));
+		slot = Slot{ p, pages[p]->vertices.allocate(vertexCount), pages[p]->indices.allocate(indexUnits), true };
+	}
+
+	Page& page = *pages[slot.page];
+	page.allocations++;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page.vertexBuffer.get());
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t) page.vertices.getOffset(slot.vertexBlock) * stride,
+		(size_t) vertexCount * stride, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page.indexBuffer.get());
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t) page.indices.getOffset(slot.indexBlock) * GEOMETRY_INDEX_UNIT,
+		indexBytes, indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	// slot numbers start at 1, 0 is the empty allocation
+	unsigned int id;
+	if (!freeSlots.empty()) {
+		id = freeSlots.back();
+		freeSlots.pop_back();
+		slots[id - 1] = slot;
+	}
+	else {
+		slots.push_back(slot);
+		id = (unsigned int) slots.size();
+	}
+	return GeometryAllocation{ id };
+}
+
+void GeometryHeap::free(unsigned int slot) {
+	Slot& s = slots[slot - 1];
+	Page& page = *pages[s.page];
+	page.vertices.free(s.vertexBlock);
+	page.indices.free(s.indexBlock);
+	page.allocations--;
+	s.live = false;
+	freeSlots.push_back(slot);
+}
+
+GeometryRange GeometryHeap::getRange(unsigned int slot) {
+	const Slot& s = slots[slot - 1];
+	const Page& page = *pages[s.page];
+	return GeometryRange{ page.vertexArray.get(), (int) page.vertices.getOffset(s.vertexBlock),
+		(size_t) page.indices.getOffset(s.indexBlock) * GEOMETRY_INDEX_UNIT };
+}
+
+size_t GeometryHeap::defragment() {
+	struct Move {
+		unsigned int slot;
+		unsigned int vertexOffset, vertexSize;
+		unsigned int indexOffset, indexSize;
+	};
+
+	size_t copied = 0;
+	std::vector<Move> moves;
+	for (unsigned int p = 0; p < pages.size(); p++) {
+		if (!pages[p]) continue;
+		Page& page = *pages[p];
+		if (page.allocations == 0) {
+			pages[p].reset();
+			continue;
+		}
+		// one free run per buffer is as good as it gets
+		if (page.vertices.getStats().freeBlocks <= 1 && page.indices.getStats().freeBlocks <= 1) continue;
+
+		moves.clear();
+		for (unsigned int i = 0; i < slots.size(); i++) {
+			const Slot& s = slots[i];
+			if (!s.live || s.page != p) continue;
+			moves.push_back(Move{ i, page.vertices.getOffset(s.vertexBlock), page.vertices.getSize(s.vertexBlock),
+				page.indices.getOffset(s.indexBlock), page.indices.getSize(s.indexBlock) });
+		}
+		std::sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) { return a.vertexOffset < b.vertexOffset; });
+
+		// a fresh allocator hands out ranges front to back, so reallocating in order packs them
+		unsigned int vertexCapacity = page.vertices.getCapacity();
+		unsigned int indexCapacity = page.indices.getCapacity();
+		page.vertices.reset(vertexCapacity);
+		page.indices.reset(indexCapacity);
+
+		unsigned int stride = getVertexStride(page.format);
+		GLBuffer vertexBuffer, indexBuffer;
+		vertexBuffer.create();
+		indexBuffer.create();
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer.get());
+		glBufferData(GL_COPY_WRITE_BUFFER, (size_t) vertexCapacity * stride, NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, page.vertexBuffer.get());
+		for (const Move& m : moves) {
+			Slot& s = slots[m.slot];
+			s.vertexBlock = page.vertices.allocate(m.vertexSize);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (size_t) m.vertexOffset * stride,
+				(size_t) page.vertices.getOffset(s.vertexBlock) * stride, (size_t) m.vertexSize * stride);
+			copied += (size_t) m.vertexSize * stride;
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer.get());
+		glBufferData(GL_COPY_WRITE_BUFFER, (size_t) indexCapacity * GEOMETRY_INDEX_UNIT, NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, page.indexBuffer.get());
+		for (const Move& m : moves) {
+			Slot& s = slots[m.slot];
+			s.indexBlock = page.indices.allocate(m.indexSize);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (size_t) m.indexOffset * GEOMETRY_INDEX_UNIT,
+				(size_t) page.indices.getOffset(s.indexBlock) * GEOMETRY_INDEX_UNIT, (size_t) m.indexSize * GEOMETRY_INDEX_UNIT);
+			copied += (size_t) m.indexSize * GEOMETRY_INDEX_UNIT;
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		// the old buffers are deleted as they are replaced, the VAO is pointed at the new ones
+		page.vertexBuffer = std::move(vertexBuffer);
+		page.indexBuffer = std::move(indexBuffer);
+		bindPageBuffers(page);
+	}
+	return copied;
+}
+
+void GeometryHeap::clear() {
+	pages.clear();
+	slots.clear();
+	freeSlots.clear();
+}
+
+GeometryHeapStats GeometryHeap::getStats() {
+	GeometryHeapStats stats;
+	size_t vertexFree = 0, vertexLargest = 0, indexFree = 0, indexLargest = 0;
+	for (const std::unique_ptr<Page>& page : pages) {
+		if (!page) continue;
+		unsigned int stride = getVertexStride(page->format);
+		FreeSpaceStats vertices = page->vertices.getStats();
+		FreeSpaceStats indices = page->indices.getStats();
+
+		stats.pages++;
+		stats.allocations += page->allocations;
+		stats.vertexBytes += (size_t) vertices.capacity * stride;
+		stats.vertexBytesUsed += (size_t) vertices.used * stride;
+		stats.indexBytes += (size_t) indices.capacity * GEOMETRY_INDEX_UNIT;
+		stats.indexBytesUsed += (size_t) indices.used * GEOMETRY_INDEX_UNIT;
+		stats.freeBlocks += vertices.freeBlocks + indices.freeBlocks;
+
+		vertexFree += vertices.capacity - vertices.used;
+		vertexLargest += vertices.largestFree;
+		indexFree += indices.capacity - indices.used;
+		indexLargest += indices.largestFree;
+	}
+	if (vertexFree > 0) stats.vertexFragmentation = 1.0f - (float) vertexLargest / vertexFree;
+	if (indexFree > 0) stats.indexFragmentation = 1.0f - (float) indexLargest / indexFree;
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "GLHandle.h"
+#include "TLSFAllocator.h"
+#include "VertexFormat.h"
+
+// a page holds this much vertex and index data, bigger meshes get a page of their own
+#define GEOMETRY_PAGE_VERTEX_BYTES (16 << 20)
+#define GEOMETRY_PAGE_INDEX_BYTES (8 << 20)
+// index ranges are allocated in these units, so both index sizes stay aligned
+#define GEOMETRY_INDEX_UNIT 4
+
+struct GeometryRange {
+	unsigned int vertexArray;
+	// added to every index by glDrawElementsBaseVertex
+	int baseVertex;
+	// byte offset into the page's element buffer
+	size_t indexOffset;
+};
+
+struct GeometryHeapStats {
+	unsigned int pages = 0;
+	unsigned int allocations = 0;
+	size_t vertexBytes = 0, vertexBytesUsed = 0;
+	size_t indexBytes = 0, indexBytesUsed = 0;
+	unsigned int freeBlocks = 0;
+	// share of the free space outside each page's largest free block, 0 when every page's
+	// free space is one run
+	float vertexFragmentation = 0.0f;
+	float indexFragmentation = 0.0f;
+};
+
+class GeometryAllocation;
+
+// Process wide vertex and index storage. Each vertex format has a few large pages, a VAO plus
+// one vertex and one element buffer, carved up by TLSF allocators, so meshes of one format share
+// a VAO and are drawn with a base vertex. GL thread only.
+class GeometryHeap {
+private:
+	struct Page {
+		VertexFormat format;
+		GLVertexArray vertexArray;
+		GLBuffer vertexBuffer, indexBuffer;
+		// vertices in units of the format's stride, indices in GEOMETRY_INDEX_UNIT bytes
+		TLSFAllocator vertices, indices;
+		unsigned int allocations;
+	};
+
+	struct Slot {
+		unsigned int page;
+		unsigned int vertexBlock, indexBlock;
+		bool live;
+	};
+
+	// emptied pages leave a null entry so slot page numbers stay valid
+	static std::vector<std::unique_ptr<Page>> pages;
+	static std::vector<Slot> slots;
+	static std::vector<unsigned int> freeSlots;
+
+	static unsigned int createPage(VertexFormat format, unsigned int vertexCapacity, unsigned int indexCapacity);
+	static void bindPageBuffers(Page& page);
+
+public:
+	// copies the vertices, already in format's layout, and indexBytes of indices into a page
+	static GeometryAllocation allocate(VertexFormat format, const void* vertices, unsigned int vertexCount,
+		const void* indices, size_t indexBytes);
+	static void free(unsigned int slot);
+
+	static GeometryRange getRange(unsigned int slot);
+
+	// moves every page's allocations to the front of fresh buffers and drops empty pages,
+	// for after models unload. Returns the bytes copied
+	static size_t defragment();
+	// frees every page, nothing may still hold an allocation
+	static void clear();
+
+	static GeometryHeapStats getStats();
+};
+
+// One mesh's share of the heap, freed on destruction. Move only like GLHandle
+class GeometryAllocation {
+private:
+	unsigned int slot;
+
+public:
+	GeometryAllocation() : slot(0) {}
+	explicit GeometryAllocation(unsigned int slot) : slot(slot) {}
+	~GeometryAllocation() { reset(); }
+
+	GeometryAllocation(const GeometryAllocation&) = delete;
+	GeometryAllocation& operator=(const GeometryAllocation&) = delete;
+
+	GeometryAllocation(GeometryAllocation&& other) noexcept : slot(other.slot) { other.slot = 0; }
+	GeometryAllocation& operator=(GeometryAllocation&& other) noexcept {
+		if (this != &other) {
+			reset();
+			slot = other.slot;
+			other.slot = 0;
+		}
+		return *this;
+	}
+
+	void reset() {
+		if (slot != 0) {
+			GeometryHeap::free(slot);
+			slot = 0;
+		}
+	}
+
+	// 0 for an empty allocation, otherwise the heap's slot number
+	unsigned int get() const { return slot; }
+};
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "InstancedRenderer.h"
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#include "GLState.h"
+
+InstancedRenderer::InstancedRenderer(unsigned int VAO, unsigned int elementCount, bool indexed)
+	: VAO(VAO), capacity(0), count(0), indexed(indexed), elementCount(elementCount)
+{
+	instanceVBO.create();
+
+	GLState::bindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+
+	// a mat4 attribute is four vec4 columns
+	for (unsigned int i = 0; i < 4; i++) {
+		glEnableVertexAttribArray(INSTANCE_ATTRIB_MODEL + i);
+		glVertexAttribPointer(INSTANCE_ATTRIB_MODEL + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			(void*) (offsetof(InstanceData, model) + i * sizeof(glm::vec4)));
+		glVertexAttribDivisor(INSTANCE_ATTRIB_MODEL + i, 1);
+	}
+
+	glEnableVertexAttribArray(INSTANCE_ATTRIB_TINT);
+	glVertexAttribPointer(INSTANCE_ATTRIB_TINT, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*) offsetof(InstanceData, tint));
+	glVertexAttribDivisor(INSTANCE_ATTRIB_TINT, 1);
+
+	GLState::bindVertexArray(0);
+}
+
+void InstancedRenderer::setInstances(const InstanceData* instances, size_t count) {
+	this->count = count;
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+	if (count > capacity) {
+		capacity = count;
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), instances, GL_DYNAMIC_DRAW);
+	}
+	else {
+		// orphan the old storage so we never wait on draws still reading it
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), NULL, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstancedRenderer::draw() {
+	if (count == 0) return;
+
+	GLState::bindVertexArray(VAO);
+	if (indexed) {
+		glDrawElementsInstanced(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, 0, (GLsizei) count);
+	}
+	else {
+		glDrawArraysInstanced(GL_TRIANGLES, 0, elementCount, (GLsizei) count);
+	}
+}
+
+size_t InstancedRenderer::getCount() const {
+	return count;
+}
\ No newline at end of file
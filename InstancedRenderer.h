@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+
+#include "GLHandle.h"
+
+// first attribute location used for per-instance data, the model matrix
+// takes four consecutive locations and the tint the one after
+#define INSTANCE_ATTRIB_MODEL 3
+#define INSTANCE_ATTRIB_TINT 7
+
+struct InstanceData {
+	glm::mat4 model;
+	glm::vec4 tint;
+};
+
+// Draws one mesh many times with a single instanced call. The per-instance
+// buffer is attached to an existing VAO, so the mesh's own attributes stay as they are.
+class InstancedRenderer {
+private:
+	unsigned int VAO;
+	GLBuffer instanceVBO;
+	size_t capacity;
+	size_t count;
+
+	bool indexed;
+	unsigned int elementCount;
+
+public:
+	// elementCount is the vertex count for glDrawArrays or the index count when indexed
+	InstancedRenderer(unsigned int VAO, unsigned int elementCount, bool indexed = false);
+
+	// replaces the instance data, growing the buffer when needed
+	void setInstances(const InstanceData* instances, size_t count);
+	void draw();
+
+	size_t getCount() const;
+};
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// the lane the current thread owns, set on workers only. The main lane is known by thread id
+static thread_local JobSystem* laneSystem = nullptr;
+static thread_local int laneIndex = -1;
+
+// finished jobs on this thread, handed out again by the next spawn
+struct JobCache {
+	std::vector<Job*> jobs;
+
+	~JobCache() {
+		for (Job* job : jobs) delete job;
+	}
+};
+static thread_local JobCache jobCache;
+
+JobCounter::JobCounter()
+	: pending(0), finishing(0)
+{}
+
+JobCounter::~JobCounter() {}
+
+bool JobCounter::isDone() const {
+	return pending.load() == 0 && finishing.load() == 0;
+}
+
+JobDeque::JobDeque()
+	: top(0), bottom(0), buffer(new std::atomic<Job*>[JOB_DEQUE_CAPACITY])
+{}
+
+bool JobDeque::push(Job* job) {
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= JOB_DEQUE_CAPACITY) return false;
+	buffer[b & (JOB_DEQUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+Job* JobDeque::pop() {
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+	if (t > b) {
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = buffer[b & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (t == b) {
+		// the last one, a thief may be after it too
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* JobDeque::steal() {
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b) return nullptr;
+
+	Job* job = buffer[t & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+	return job;
+}
+
+bool JobDeque::empty() const {
+	return bottom.load() <= top.load();
+}
+
+JobSystem::JobSystem(unsigned int threads)
+	: mainThread(std::this_thread::get_id()), injectedCount(0), sleeping(0), stopping(false)
+{
+	if (threads == 0) {
+		unsigned int cores = std::thread::hardware_concurrency();
+		threads = (cores > 1) ? cores - 1 : 1;
+	}
+	laneCount = threads + 1;
+	lanes.reset(new Lane[laneCount]);
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock{ sleepMutex };
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	// jobs nobody got to yet, the workers may have spawned some on their way out
+	while (true) {
+		Job* job = takeMainJob();
+		if (!job) job = findJob(-1, nullptr);
+		if (!job) break;
+		execute(job);
+	}
+}
+
+Job* JobSystem::allocateJob() {
+	if (jobCache.jobs.empty()) return new Job;
+	Job* job = jobCache.jobs.back();
+	jobCache.jobs.pop_back();
+	return job;
+}
+
+void JobSystem::releaseJob(Job* job) {
+	if (jobCache.jobs.size() < JOB_CACHE_SIZE) jobCache.jobs.push_back(job);
+	else delete job;
+}
+
+int JobSystem::getLane() const {
+	if (laneSystem == this) return laneIndex;
+	return (std::this_thread::get_id() == mainThread) ? 0 : -1;
+}
+
+void JobSystem::push(Job* job) {
+	int lane = getLane();
+	if (lane < 0 || !lanes[lane].deque.push(job)) {
+		// a full worker lane does the job itself rather than growing without bound. The main
+		// lane must not end up in a long job, so it hands its overflow to the workers instead
+		if (lane > 0) execute(job);
+		else inject(job);
+		return;
+	}
+	wakeWorker();
+}
+
+void JobSystem::inject(Job* job) {
+	{
+		std::lock_guard<std::mutex> lock{ injectedMutex };
+		injected.push_back(job);
+		injectedCount++;
+	}
+	wakeWorker();
+}
+
+void JobSystem::wakeWorker() {
+	// pairs with the fence in workerLoop(), either a sleeper is seen here or it sees the job
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleeping.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock{ sleepMutex };
+		wake.notify_one();
+	}
+}
+
+void JobSystem::execute(Job* job) {
+	JobCounter* counter = job->counter;
+	job->function(job);
+	releaseJob(job);
+	if (counter) finish(counter);
+}
+
+void JobSystem::finish(JobCounter* counter) {
+	counter->finishing.fetch_add(1);
+	if (counter->pending.fetch_sub(1) != 1) {
+		counter->finishing.fetch_sub(1);
+		return;
+	}
+
+	std::vector<Job*> ready;
+	{
+		std::lock_guard<std::mutex> lock{ counter->mutex };
+		ready.swap(counter->continuations);
+	}
+	// the counter may be gone from here on
+	counter->finishing.fetch_sub(1);
+	for (Job* job : ready) {
+		push(job);
+	}
+}
+
+Job* JobSystem::takeMainJob() {
+	std::lock_guard<std::mutex> lock{ mainMutex };
+	if (mainJobs.empty()) return nullptr;
+	Job* job = mainJobs.front();
+	mainJobs.pop_front();
+	return job;
+}
+
+Job* JobSystem::findJob(int lane, const JobCounter* waiting) {
+	if (lane == 0) {
+		// the GL thread only helps with what it waits for. Anything else it spawned, a texture
+		// decode say, goes to the workers rather than stall a frame behind the wait
+		while (Job* job = lanes[0].deque.pop()) {
+			if (job->counter == waiting) return job;
+			inject(job);
+		}
+		return takeMainJob();
+	}
+	if (lane > 0) {
+		Job* job = lanes[lane].deque.pop();
+		if (job) return job;
+	}
+
+	if (injectedCount.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock{ injectedMutex };
+		if (!injected.empty()) {
+			Job* job = injected.front();
+			injected.pop_front();
+			injectedCount--;
+			return job;
+		}
+	}
+
+	// every other lane, starting after this one so thieves spread out
+	unsigned int start = (lane > 0) ? (unsigned int) lane : 0;
+	for (unsigned int i = 1; i <= laneCount; i++) {
+		unsigned int victim = (start + i) % laneCount;
+		if ((int) victim == lane) continue;
+		Job* job = lanes[victim].deque.steal();
+		if (job) return job;
+	}
+	return nullptr;
+}
+
+bool JobSystem::hasWork() const {
+	if (injectedCount.load() > 0) return true;
+	for (unsigned int i = 0; i < laneCount; i++) {
+		if (!lanes[i].deque.empty()) return true;
+	}
+	return false;
+}
+
+void JobSystem::workerLoop(unsigned int lane) {
+	laneSystem = this;
+	laneIndex = (int) lane;
+
+	unsigned int idle = 0;
+	while (true) {
+		Job* job = findJob((int) lane, nullptr);
+		if (job) {
+			execute(job);
+			idle = 0;
+			continue;
+		}
+		if (stopping) return;
+		if (++idle < JOB_IDLE_SPINS) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		idle = 0;
+		std::unique_lock<std::mutex> lock{ sleepMutex };
+		sleeping.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!stopping && !hasWork()) wake.wait(lock);
+		sleeping.fetch_sub(1);
+	}
+}
+
+void JobSystem::wait(JobCounter& counter) {
+	int lane = getLane();
+	while (!counter.isDone()) {
+		Job* job = findJob(lane, &counter);
+		if (job) execute(job);
+		else std::this_thread::yield();
+	}
+}
+
+void JobSystem::runMainJobs() {
+	// only what is queued now, a job that queues another leaves it for next time
+	std::deque<Job*> queued;
+	{
+		std::lock_guard<std::mutex> lock{ mainMutex };
+		queued.swap(mainJobs);
+	}
+	for (Job* job : queued) {
+		execute(job);
+	}
+}
+
+void JobSystem::splitRange(unsigned int begin, unsigned int end, unsigned int grain,
+	const std::function<void(unsigned int)>* fn, JobCounter* counter)
+{
+	// hand the upper half to whoever steals it and keep halving the rest
+	while (end - begin > grain) {
+		unsigned int middle = begin + (end - begin) / 2;
+		spawn([this, middle, end, grain, fn, counter] { splitRange(middle, end, grain, fn, counter); }, counter);
+		end = middle;
+	}
+	for (unsigned int i = begin; i < end; i++) {
+		(*fn)(i);
+	}
+}
+
+void JobSystem::parallelFor(unsigned int count, const std::function<void(unsigned int)>& fn, unsigned int grain) {
+	grain = std::max(grain, 1u);
+	if (count <= grain) {
+		for (unsigned int i = 0; i < count; i++) fn(i);
+		return;
+	}
+
+	JobCounter done;
+	splitRange(0, count, grain, &fn, &done);
+	wait(done);
+}
+
+unsigned int JobSystem::getThreadCount() const {
+	return (unsigned int) workers.size();
+}
+
+bool JobSystem::isMainThread() const {
+	return std::this_thread::get_id() == mainThread;
+}
\ No newline at end of file
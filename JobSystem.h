@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// jobs a lane can hold before spawn() runs new ones on the spot, a power of two
+#define JOB_DEQUE_CAPACITY 4096
+// bytes of captures a job closure may carry, so a job fits a cache line
+#define JOB_STORAGE_SIZE 48
+// finished jobs each thread keeps around for reuse instead of freeing them
+#define JOB_CACHE_SIZE 1024
+// tries at finding work before an idle worker goes to sleep
+#define JOB_IDLE_SPINS 64
+
+class JobCounter;
+
+struct Job {
+	void (*function)(Job* job);
+	JobCounter* counter;
+	alignas(16) unsigned char storage[JOB_STORAGE_SIZE];
+};
+
+// Counts unfinished jobs. Jobs spawned with it count it up and count it down once they
+// have run, JobSystem::wait() and spawnAfter() hold off until it is back at zero.
+class JobCounter {
+private:
+	friend class JobSystem;
+
+	std::atomic<unsigned int> pending;
+	// threads between counting down and letting go of the counter, so it is not
+	// destroyed under one that still has to release continuations
+	std::atomic<unsigned int> finishing;
+	std::mutex mutex;
+	std::vector<Job*> continuations;
+
+public:
+	JobCounter();
+	~JobCounter();
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool isDone() const;
+};
+
+// Single-owner deque after Chase and Lev: the owning lane pushes and pops at the bottom,
+// any other thread steals from the top. Fixed capacity, push() fails once it is full.
+class JobDeque {
+private:
+	alignas(64) std::atomic<int64_t> top;
+	alignas(64) std::atomic<int64_t> bottom;
+	std::unique_ptr<std::atomic<Job*>[]> buffer;
+
+public:
+	JobDeque();
+
+	bool push(Job* job);
+	Job* pop();
+	Job* steal();
+	bool empty() const;
+};
+
+// Work-stealing scheduler. Every worker owns a deque, and so does the thread that
+// constructs the system: the main lane, which is also the GL thread. Jobs spawned on a
+// lane go to its own deque and idle lanes steal from the others. The main lane never
+// steals, and waiting on the GL thread only runs the jobs of the counter it waits on, so
+// a long job it spawned for later never stalls a frame. Jobs pinned to it with
+// spawnOnMain() run only there, from runMainJobs() or wait().
+class JobSystem {
+private:
+	struct Lane {
+		JobDeque deque;
+	};
+
+	std::vector<std::thread> workers;
+	// lane 0 is the main lane, worker i owns lane i + 1
+	std::unique_ptr<Lane[]> lanes;
+	unsigned int laneCount;
+	std::thread::id mainThread;
+
+	// spawns from threads that own no lane
+	std::mutex injectedMutex;
+	std::deque<Job*> injected;
+	std::atomic<size_t> injectedCount;
+
+	std::mutex mainMutex;
+	std::deque<Job*> mainJobs;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<unsigned int> sleeping;
+	std::atomic<bool> stopping;
+
+	static Job* allocateJob();
+	static void releaseJob(Job* job);
+
+	template <typename Fn>
+	static Job* makeJob(Fn&& fn, JobCounter* counter) {
+		typedef typename std::decay<Fn>::type Callable;
+		static_assert(sizeof(Callable) <= JOB_STORAGE_SIZE, "job closure too large, capture a pointer to the data instead");
+		static_assert(alignof(Callable) <= 16, "job closure over-aligned");
+		Job* job = allocateJob();
+		new (job->storage) Callable(std::forward<Fn>(fn));
+		job->function = [](Job* job) {
+			Callable* callable = reinterpret_cast<Callable*>(job->storage);
+			(*callable)();
+			callable->~Callable();
+		};
+		job->counter = counter;
+		if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+		return job;
+	}
+
+	// -1 for threads outside the system
+	int getLane() const;
+	void push(Job* job);
+	// hands job to whichever worker gets to it first
+	void inject(Job* job);
+	void wakeWorker();
+	void execute(Job* job);
+	void finish(JobCounter* counter);
+	// what lane should run next, nullptr when there is nothing it may take. The main lane
+	// only takes pinned jobs and those counted by waiting
+	Job* findJob(int lane, const JobCounter* waiting);
+	Job* takeMainJob();
+	bool hasWork() const;
+	void workerLoop(unsigned int lane);
+	void splitRange(unsigned int begin, unsigned int end, unsigned int grain,
+		const std::function<void(unsigned int)>* fn, JobCounter* counter);
+
+public:
+	// defaults to one worker per core besides the caller's, never fewer than one.
+	// The constructing thread becomes the main lane
+	JobSystem(unsigned int threads = 0);
+	// runs whatever is still queued before the workers stop
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// fn must be callable with no arguments, counter is counted up until it has run
+	template <typename Fn>
+	void spawn(Fn&& fn, JobCounter* counter = nullptr) {
+		push(makeJob(std::forward<Fn>(fn), counter));
+	}
+
+	// spawns fn once dependency is done, counter is counted up right away
+	template <typename Fn>
+	void spawnAfter(JobCounter& dependency, Fn&& fn, JobCounter* counter = nullptr) {
+		Job* job = makeJob(std::forward<Fn>(fn), counter);
+		{
+			std::lock_guard<std::mutex> lock{ dependency.mutex };
+			if (dependency.pending.load() > 0) {
+				dependency.continuations.push_back(job);
+				return;
+			}
+		}
+		push(job);
+	}
+
+	// fn runs on the main lane, the next time it calls runMainJobs() or wait()
+	template <typename Fn>
+	void spawnOnMain(Fn&& fn, JobCounter* counter = nullptr) {
+		Job* job = makeJob(std::forward<Fn>(fn), counter);
+		std::lock_guard<std::mutex> lock{ mainMutex };
+		mainJobs.push_back(job);
+	}
+
+	// runs jobs until counter is done, on the main lane only counter's own and pinned ones.
+	// Waiting on main lane jobs from anywhere but the main lane only returns once the main
+	// lane gets to them
+	void wait(JobCounter& counter);
+	// main lane only, runs the pinned jobs queued so far
+	void runMainJobs();
+
+	// runs fn(i) for every i in [0, count), split in halves that idle lanes steal down to
+	// grain indices per job, and returns once all of them have
+	void parallelFor(unsigned int count, const std::function<void(unsigned int)>& fn, unsigned int grain = 1);
+
+	unsigned int getThreadCount() const;
+	bool isMainThread() const;
+};
\ No newline at end of file
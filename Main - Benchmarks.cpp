@@ -0,0 +1,1613 @@
+#include <glad.c>
+#include <SDL.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Shader.h"
+#include "GLState.h"
+#include "UniformBuffers.h"
+#include "InstancedRenderer.h"
+#include "Bounds.h"
+#include "BVH.h"
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include "CookedModel.h"
+#include "TextureStreamer.h"
+#include "TextureData.h"
+#include "BlockCompression.h"
+#include "MipChain.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexFormat.h"
+#include "GeometryHeap.h"
+#include "TextureCache.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
+#include "EntityStore.h"
+#include "stb_image.h"
+
+// Standalone benchmark program, build it in place of Main.cpp.
+// Run with no arguments for every benchmark or with a benchmark name for one.
+// The shader folder, a model and the texture folder can follow the name.
+
+using benchClock = std::chrono::steady_clock;
+
+static double msSince(benchClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(benchClock::now() - start).count();
+}
+
+// vertices, normal vectors, and texture coordinates for a cube
+static const float cubeVertices[] = {
+	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
+	 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
+	-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
+	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
+
+	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
+	-0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
+	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
+
+	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+	-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+	-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+
+	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+	 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+	 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+
+	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
+	 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
+	-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
+	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
+
+	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
+	-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
+	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
+};
+
+static unsigned int createCubeVAO() {
+	unsigned int VAO, VBO;
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+
+	GLState::bindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+
+	GLState::bindVertexArray(0);
+	return VAO;
+}
+
+// a cube of cubes centered in front of the camera
+static std::vector<InstanceData> cubeField(size_t count) {
+	std::vector<InstanceData> instances(count);
+	size_t side = (size_t) std::ceil(std::cbrt((double) count));
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 pos{ (float) (i % side), (float) ((i / side) % side), (float) (i / (side * side)) };
+		pos = (pos - glm::vec3{ side * 0.5f }) * 1.5f - glm::vec3{ 0.0f, 0.0f, side * 2.0f };
+
+		glm::mat4 model{ 1.0f };
+		model = glm::translate(model, pos);
+		instances[i] = InstanceData{ model, glm::vec4{ 1.0f } };
+	}
+	return instances;
+}
+
+static void benchInstancing(const std::string& shaderFolderPath) {
+	Shader perDraw{ (shaderFolderPath + "vShader1.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str() };
+	Shader instanced{ (shaderFolderPath + "vShaderInstanced.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str() };
+	UniformHandle modelUniform{ perDraw.getUniform("model") };
+
+	SceneUniformBuffer scene{};
+	scene.frame.view = glm::lookAt(glm::vec3{ 0.0f, 0.0f, 3.0f }, glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+	scene.frame.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 1000.0f);
+	scene.upload();
+
+	unsigned int VAO = createCubeVAO();
+	InstancedRenderer renderer{ VAO, 36 };
+
+	// the per-draw loop is not worth waiting on past this many cubes
+	const size_t maxPerDraw = 100000;
+	const int frames = 10;
+
+	std::printf("\n%-12s %16s %16s %10s\n", "instances", "per-draw ms/f", "instanced ms/f", "speedup");
+	for (size_t count = 10; count <= 1000000; count *= 10) {
+		std::vector<InstanceData> instances{ cubeField(count) };
+		renderer.setInstances(instances.data(), instances.size());
+
+		double perDrawMs = -1.0;
+		if (count <= maxPerDraw) {
+			perDraw.use();
+			GLState::bindVertexArray(VAO);
+			glFinish();
+			benchClock::time_point start = benchClock::now();
+			for (int f = 0; f < frames; f++) {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				for (size_t i = 0; i < count; i++) {
+					perDraw.setMat4fv(modelUniform, 1, false, instances[i].model);
+					glDrawArrays(GL_TRIANGLES, 0, 36);
+				}
+			}
+			glFinish();
+			perDrawMs = msSince(start) / frames;
+		}
+
+		instanced.use();
+		glFinish();
+		benchClock::time_point start = benchClock::now();
+		for (int f = 0; f < frames; f++) {
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			renderer.draw();
+		}
+		glFinish();
+		double instancedMs = msSince(start) / frames;
+
+		if (perDrawMs < 0.0) {
+			std::printf("%-12zu %16s %16.3f %10s\n", count, "skipped", instancedMs, "-");
+		}
+		else {
+			std::printf("%-12zu %16.3f %16.3f %9.1fx\n", count, perDrawMs, instancedMs, perDrawMs / instancedMs);
+		}
+	}
+}
+
+// random boxes scattered through a cube, the same set every run
+static std::vector<AABB> randomBoxes(size_t count, float worldSize, float minSize, float maxSize, unsigned int seed) {
+	std::mt19937 rng{ seed };
+	std::uniform_real_distribution<float> pos{ -worldSize * 0.5f, worldSize * 0.5f };
+	std::uniform_real_distribution<float> size{ minSize * 0.5f, maxSize * 0.5f };
+
+	std::vector<AABB> boxes(count);
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 center{ pos(rng), pos(rng), pos(rng) };
+		glm::vec3 extents{ size(rng), size(rng), size(rng) };
+		boxes[i] = AABB{ center - extents, center + extents };
+	}
+	return boxes;
+}
+
+static void benchBVH() {
+	const size_t count = 1000000;
+	const float worldSize = 1000.0f;
+	const int queries = 10000;
+	std::vector<AABB> boxes{ randomBoxes(count, worldSize, 0.5f, 2.0f, 1) };
+
+	std::printf("\nBVH over %zu primitives\n", count);
+
+	BVH bvh{};
+	benchClock::time_point start = benchClock::now();
+	bvh.build(boxes);
+	std::printf("%-28s %10.2f ms (%zu nodes)\n", "build", msSince(start), bvh.getNodeCount());
+
+	// move a slice of the primitives a short way and refit
+	std::mt19937 rng{ 2 };
+	std::uniform_real_distribution<float> offset{ -1.0f, 1.0f };
+	for (size_t moved : { count / 100, count }) {
+		for (size_t i = 0; i < moved; i++) {
+			unsigned int prim = (unsigned int) ((i * 7919) % count);
+			glm::vec3 delta{ offset(rng), offset(rng), offset(rng) };
+			boxes[prim] = AABB{ boxes[prim].min + delta, boxes[prim].max + delta };
+		}
+
+		start = benchClock::now();
+		for (size_t i = 0; i < moved; i++) {
+			unsigned int prim = (unsigned int) ((i * 7919) % count);
+			bvh.update(prim, boxes[prim]);
+		}
+		double updateMs = msSince(start);
+		start = benchClock::now();
+		bvh.refit();
+		std::printf("%-28s %10.2f ms (update %.2f ms)\n", (std::to_string(moved) + " moved, refit").c_str(), msSince(start), updateMs);
+	}
+
+	// a wide camera in the middle of the field
+	glm::mat4 view{ glm::lookAt(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f }) };
+	glm::mat4 projection{ glm::perspective(glm::radians(60.0f), 800.0f / 600.0f, 0.1f, worldSize * 0.5f) };
+	Frustum frustum{ Frustum::fromMatrix(projection * view) };
+
+	std::vector<unsigned int> visible;
+	start = benchClock::now();
+	bvh.queryFrustum(frustum, visible);
+	double bvhMs = msSince(start);
+
+	size_t linearVisible = 0;
+	start = benchClock::now();
+	for (size_t i = 0; i < count; i++) {
+		if (frustum.intersects(boxes[i])) linearVisible++;
+	}
+	double linearMs = msSince(start);
+	std::printf("%-28s %10.2f ms (%zu visible, linear scan %.2f ms, %zu visible)\n",
+		"frustum query", bvhMs, visible.size(), linearMs, linearVisible);
+
+	std::uniform_real_distribution<float> pos{ -worldSize * 0.5f, worldSize * 0.5f };
+	std::uniform_real_distribution<float> dir{ -1.0f, 1.0f };
+	std::vector<Ray> rays(queries);
+	for (Ray& r : rays) {
+		r.origin = glm::vec3{ pos(rng), pos(rng), pos(rng) };
+		r.direction = glm::normalize(glm::vec3{ dir(rng), dir(rng), dir(rng) } + glm::vec3{ 0.0f, 0.0f, 0.001f });
+	}
+
+	size_t hits = 0;
+	start = benchClock::now();
+	for (const Ray& r : rays) {
+		RayHit hit;
+		if (bvh.raycast(r, worldSize, hit)) hits++;
+	}
+	double rayMs = msSince(start);
+	std::printf("%-28s %10.2f us/ray (%zu of %d hit)\n", "nearest ray cast", rayMs * 1000.0 / queries, hits, queries);
+
+	size_t blocked = 0;
+	start = benchClock::now();
+	for (const Ray& r : rays) {
+		if (bvh.occluded(r, 50.0f)) blocked++;
+	}
+	rayMs = msSince(start);
+	std::printf("%-28s %10.2f us/ray (%zu of %d blocked within 50)\n", "line of sight", rayMs * 1000.0 / queries, blocked, queries);
+
+	std::vector<AABB> regions{ randomBoxes(queries, worldSize, 5.0f, 20.0f, 3) };
+	std::vector<unsigned int> overlapping;
+	start = benchClock::now();
+	for (const AABB& region : regions) {
+		bvh.queryOverlap(region, overlapping);
+	}
+	std::printf("%-28s %10.2f us/query (%zu overlaps)\n", "AABB overlap", msSince(start) * 1000.0 / queries, overlapping.size());
+}
+
+static void benchOcclusion() {
+	// a city block of cubes seen from street level, most of them behind the first rows
+	const int side = 100;
+	std::vector<glm::mat4> models;
+	std::vector<AABB> boxes;
+	AABB unitCube{ glm::vec3{ -0.5f }, glm::vec3{ 0.5f } };
+	for (int z = 0; z < side; z++) {
+		for (int x = 0; x < side; x++) {
+			glm::mat4 model{ 1.0f };
+			model = glm::translate(model, glm::vec3{ (x - side / 2) * 2.0f, 0.0f, -z * 2.0f - 5.0f });
+			model = glm::scale(model, glm::vec3{ 1.5f, 1.0f + (x * 7 + z * 13) % 5, 1.5f });
+			models.push_back(model);
+			boxes.push_back(unitCube.transform(model));
+		}
+	}
+
+	glm::mat4 view{ glm::lookAt(glm::vec3{ 0.0f, 1.0f, 0.0f }, glm::vec3{ 0.0f, 1.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f }) };
+	glm::mat4 projection{ glm::perspective(glm::radians(60.0f), 800.0f / 600.0f, 0.1f, 500.0f) };
+
+	std::printf("\nocclusion culling %d cubes, %dx%d depth buffer\n", side * side, OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+	std::printf("%-10s %10s %10s %10s %10s %12s\n", "threads", "setup ms", "raster ms", "test ms", "total ms", "occluded");
+	for (unsigned int threads : { 1u, std::max(1u, std::thread::hardware_concurrency() - 1) }) {
+		JobSystem jobs{ threads };
+		OcclusionCuller occlusion{ jobs };
+
+		const int frames = 20;
+		double total = 0.0;
+		for (int f = 0; f < frames; f++) {
+			occlusion.begin(projection * view);
+			for (size_t i = 0; i < models.size(); i++) {
+				occlusion.addOccluder(cubeVertices, 8 * sizeof(float), 36, NULL, 0, models[i]);
+				occlusion.addOccludee(boxes[i]);
+			}
+			benchClock::time_point start = benchClock::now();
+			occlusion.cullAsync();
+			occlusion.wait();
+			total += msSince(start);
+		}
+
+		const OcclusionCuller::Stats& stats = occlusion.getStats();
+		std::printf("%-10u %10.3f %10.3f %10.3f %10.3f %6u/%-5u\n", threads,
+			stats.setupMs, stats.rasterMs, stats.testMs, total / frames, stats.occluded, stats.tested);
+	}
+}
+
+static void benchLoad(const std::string& modelPath) {
+	// cold imports through assimp and writes the cooked file, warm maps the cooked file
+	std::error_code error;
+	std::filesystem::remove(modelPath + COOKED_MODEL_EXTENSION, error);
+
+	std::printf("\nmodel load %s\n", modelPath.c_str());
+	// both keep their CPU copies so the round trip can be compared
+	Model cold{ modelPath, NULL, NULL, VERTEX_FLOAT, true };
+	Model warm{ modelPath, NULL, NULL, VERTEX_FLOAT, true };
+	if (!warm.isCooked()) {
+		std::printf("cooked file was not written, nothing to compare\n");
+		return;
+	}
+
+	bool identical = cold.getMeshes().size() == warm.getMeshes().size() && cold.getNodes().size() == warm.getNodes().size();
+	size_t vertices = 0, indices = 0;
+	for (size_t i = 0; identical && i < cold.getMeshes().size(); i++) {
+		const Mesh& a = cold.getMeshes()[i];
+		const Mesh& b = warm.getMeshes()[i];
+		identical = a.getVertexCount() == b.getVertexCount() && a.getTotalIndexCount() == b.getTotalIndexCount()
+			&& a.getLodCount() == b.getLodCount() && a.getMeshlets().size() == b.getMeshlets().size()
+			&& std::memcmp(a.getVertexData(), b.getVertexData(), a.getVertexCount() * sizeof(Vertex)) == 0
+			&& std::memcmp(a.getIndexData(), b.getIndexData(), a.getTotalIndexCount() * sizeof(unsigned int)) == 0;
+		for (unsigned int l = 0; identical && l < a.getLodCount(); l++) {
+			identical = a.getLod(l).indexCount == b.getLod(l).indexCount && a.getLod(l).error == b.getLod(l).error;
+		}
+		vertices += a.getVertexCount();
+		indices += a.getTotalIndexCount();
+	}
+
+	std::printf("%zu meshes, %zu vertices, %zu indices, round trip %s\n", cold.getMeshes().size(), vertices, indices,
+		identical ? "identical" : "MISMATCH");
+	std::printf("%-28s %10s %10s %10s\n", "", "total ms", "texture ms", "geometry ms");
+	std::printf("%-28s %10.2f %10.2f %10.2f\n", "cold (assimp + cook)", cold.getLoadMs(), cold.getTextureMs(), cold.getLoadMs() - cold.getTextureMs());
+	std::printf("%-28s %10.2f %10.2f %10.2f\n", "warm (mapped .mdlbin)", warm.getLoadMs(), warm.getTextureMs(), warm.getLoadMs() - warm.getTextureMs());
+	std::printf("%-28s %10.1fx\n", "geometry speedup",
+		(cold.getLoadMs() - cold.getTextureMs()) / std::max(0.001, warm.getLoadMs() - warm.getTextureMs()));
+}
+
+static void benchImport(const std::string& modelPath) {
+	// always a full assimp import, the cooked file is removed before each run
+	unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	std::printf("\nparallel import %s\n", modelPath.c_str());
+	std::printf("%-10s %10s %10s %10s %10s\n", "threads", "total ms", "convert ms", "speedup", "output");
+	std::vector<std::vector<Vertex>> reference;
+	double serialConvert = 0.0;
+	for (unsigned int threads : threadCounts) {
+		std::error_code error;
+		std::filesystem::remove(modelPath + COOKED_MODEL_EXTENSION, error);
+
+		// the caller joins in on parallelFor, so n threads is n - 1 workers
+		std::unique_ptr<JobSystem> jobs;
+		if (threads > 1) jobs = std::make_unique<JobSystem>(threads - 1);
+		Model model{ modelPath, jobs.get(), NULL, VERTEX_FLOAT, true };
+
+		// every thread count has to produce the same meshes in the same order
+		bool identical = true;
+		for (size_t i = 0; i < model.getMeshes().size(); i++) {
+			const Mesh& mesh = model.getMeshes()[i];
+			if (reference.size() < model.getMeshes().size()) {
+				reference.emplace_back(mesh.getVertexData(), mesh.getVertexData() + mesh.getVertexCount());
+			}
+			else {
+				identical = identical && reference[i].size() == mesh.getVertexCount()
+					&& std::memcmp(reference[i].data(), mesh.getVertexData(), mesh.getVertexCount() * sizeof(Vertex)) == 0;
+			}
+		}
+		if (threads == 1) serialConvert = model.getConvertMs();
+
+		std::printf("%-10u %10.2f %10.2f %9.2fx %10s\n", threads, model.getLoadMs(), model.getConvertMs(),
+			serialConvert / std::max(0.001, model.getConvertMs()), identical ? "identical" : "MISMATCH");
+	}
+}
+
+static void benchTextures(const std::string& modelPath) {
+	// cook the geometry first so only texture loading differs between the two runs
+	{ Model warmup{ modelPath }; }
+
+	auto frame = [] {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glFinish();
+	};
+
+	std::printf("\ntexture loading %s\n", modelPath.c_str());
+	std::printf("%-28s %12s %12s %12s %8s\n", "", "first frame", "resident", "worst frame", "frames");
+
+	// everything decoded and uploaded before the first frame
+	benchClock::time_point start = benchClock::now();
+	{
+		Model model{ modelPath };
+		frame();
+	}
+	double syncMs = msSince(start);
+	std::printf("%-28s %12.2f %12.2f %12.2f %8d\n", "synchronous", syncMs, syncMs, syncMs, 1);
+
+	JobSystem jobs{};
+	TextureStreamer streamer{ jobs };
+	start = benchClock::now();
+	Model model{ modelPath, &jobs, &streamer };
+	double firstFrameMs = 0.0, worstMs = 0.0;
+	int frames = 0;
+	do {
+		benchClock::time_point frameStart = benchClock::now();
+		jobs.runMainJobs();
+		streamer.update();
+		frame();
+		worstMs = std::max(worstMs, msSince(frameStart));
+		if (frames++ == 0) firstFrameMs = msSince(start);
+	} while (!streamer.isIdle());
+
+	const TextureStreamer::Stats& stats = streamer.getStats();
+	std::printf("%-28s %12.2f %12.2f %12.2f %8d\n", "streamed", firstFrameMs, msSince(start), worstMs, frames);
+	std::printf("%u textures, %.1f MB through the PBO, %.2f ms decoding on %u workers, worst update %.2f ms\n",
+		stats.resident, stats.uploadedBytes / (1024.0 * 1024.0), stats.decodeMs, jobs.getThreadCount(), stats.worstUpdateMs);
+}
+
+static void benchCompression(const std::string& textureFolderPath) {
+	const char* images[] = { "container2.png", "container2_specular.png", "wall.jpg", "cobblestone.jpg", "backpack\\ao.jpg" };
+	unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+	JobSystem jobs{ threads > 1 ? threads - 1 : 1 };
+
+	std::printf("\nblock compression, 1 thread vs %u\n", threads);
+	std::printf("%-26s %6s %10s %10s %10s %10s %10s %10s\n", "", "format", "1T MP/s", "MT MP/s", "PSNR dB", "raw KB", "BC KB", "GL diff");
+	for (const char* name : images) {
+		std::string path = textureFolderPath + name;
+		int width, height, channels;
+		unsigned char* texels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+		if (!texels) {
+			std::printf("%-26s could not be loaded\n", name);
+			continue;
+		}
+
+		bool translucent = false;
+		for (int i = 3; channels == 4 && i < width * height * 4; i += 4) {
+			translucent = translucent || texels[i] != 255;
+		}
+		BlockFormat format = (channels == 2) ? BLOCK_BC5 : translucent ? BLOCK_BC3 : BLOCK_BC1;
+		std::vector<unsigned char> blocks(getCompressedSize(format, width, height));
+
+		const int runs = 5;
+		double megapixels = width * (double) height / 1e6;
+		benchClock::time_point start = benchClock::now();
+		for (int r = 0; r < runs; r++) compressImage(format, texels, width, height, channels, blocks.data(), NULL);
+		double serialMs = msSince(start) / runs;
+		start = benchClock::now();
+		for (int r = 0; r < runs; r++) compressImage(format, texels, width, height, channels, blocks.data(), &jobs);
+		double parallelMs = msSince(start) / runs;
+
+		// error over the channels the format keeps
+		std::vector<unsigned char> decoded((size_t) width * height * 4);
+		decompressImage(format, blocks.data(), width, height, decoded.data());
+		int kept = (format == BLOCK_BC5) ? 2 : (format == BLOCK_BC3) ? 4 : std::min(channels, 3);
+		double squaredError = 0.0;
+		for (size_t i = 0; i < (size_t) width * height; i++) {
+			for (int c = 0; c < kept; c++) {
+				int source = texels[i * channels + ((channels == 1) ? 0 : c)];
+				double difference = source - decoded[i * 4 + c];
+				squaredError += difference * difference;
+			}
+		}
+		double mse = squaredError / ((double) width * height * kept);
+		double psnr = (mse > 0.0) ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+
+		// what the driver decodes should match the reference decoder
+		static const unsigned int internalFormats[3] = { 0x83F0, 0x83F3, GL_COMPRESSED_RG_RGTC2 };
+		int glDifference = -1;
+		if (format == BLOCK_BC5 || isBlockCompressionSupported()) {
+			unsigned int texture;
+			glGenTextures(1, &texture);
+			GLState::bindTexture(0, texture);
+			glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalFormats[format], width, height, 0, (GLsizei) blocks.size(), blocks.data());
+			std::vector<unsigned char> readBack((size_t) width * height * 4);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, readBack.data());
+			glDifference = 0;
+			for (size_t i = 0; i < readBack.size(); i++) {
+				if (format == BLOCK_BC5 && i % 4 >= 2) continue;
+				glDifference = std::max(glDifference, std::abs(readBack[i] - decoded[i]));
+			}
+			glDeleteTextures(1, &texture);
+		}
+
+		static const char* formatNames[3] = { "BC1", "BC3", "BC5" };
+		std::printf("%-26s %6s %10.1f %10.1f %10.2f %10zu %10zu %10d\n", name, formatNames[format],
+			megapixels / (serialMs / 1000.0), megapixels / (parallelMs / 1000.0), psnr,
+			(size_t) width * height * channels / 1024, blocks.size() / 1024, glDifference);
+		stbi_image_free(texels);
+	}
+}
+
+// straightforward double precision version of one gamma correct 2x2 step, the accuracy reference
+// source texels an output texel covers along one side: two, one when the side is one
+// texel long, and three for the last one along an odd side
+static int referenceFootprint(int size, int outSize, int i) {
+	if (size == 1) return 1;
+	return (size % 2 == 1 && i == outSize - 1) ? 3 : 2;
+}
+
+// RGBA, the color as sRGB, every texel of the footprint weighed the same in linear light
+static void referenceDownsample(const unsigned char* in, int width, int height, unsigned char* out) {
+	int outWidth = std::max(1, width / 2), outHeight = std::max(1, height / 2);
+	for (int y = 0; y < outHeight; y++) {
+		int rows = referenceFootprint(height, outHeight, y);
+		for (int x = 0; x < outWidth; x++) {
+			int columns = referenceFootprint(width, outWidth, x);
+			for (int c = 0; c < 4; c++) {
+				double sum = 0.0;
+				for (int sy = y * 2; sy < y * 2 + rows; sy++) {
+					for (int sx = x * 2; sx < x * 2 + columns; sx++) {
+						double value = in[((size_t) sy * width + sx) * 4 + c] / 255.0;
+						sum += (c == 3) ? value : (value <= 0.04045) ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+					}
+				}
+				double average = sum / (rows * columns);
+				double encoded = (c == 3) ? average : (average <= 0.0031308) ? average * 12.92 : 1.055 * std::pow(average, 1.0 / 2.4) - 0.055;
+				out[((size_t) y * outWidth + x) * 4 + c] = (unsigned char) std::lround(encoded * 255.0);
+			}
+		}
+	}
+}
+
+// builds the whole chain for texels, each level checked against the reference made from
+// the level before it so errors do not compound. Returns the worst channel difference
+static int worstMipError(const std::vector<unsigned char>& texels, int width, int height) {
+	std::vector<unsigned char> level = texels, next, reference;
+	int worst = 0;
+	while (width > 1 || height > 1) {
+		int outWidth = std::max(1, width / 2), outHeight = std::max(1, height / 2);
+		next.resize((size_t) outWidth * outHeight * 4);
+		reference.resize(next.size());
+		downsampleLevel(level.data(), width, height, 4, true, next.data(), NULL);
+		referenceDownsample(level.data(), width, height, reference.data());
+		for (size_t j = 0; j < next.size(); j++) {
+			worst = std::max(worst, std::abs(next[j] - reference[j]));
+		}
+		level.swap(next);
+		width = outWidth;
+		height = outHeight;
+	}
+	return worst;
+}
+
+static void benchMipmaps() {
+	// a fine black and white checker over a color ramp, where naive averaging visibly darkens
+	const int size = 2048;
+	std::vector<unsigned char> texels((size_t) size * size * 4);
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			unsigned char* texel = &texels[((size_t) y * size + x) * 4];
+			bool white = ((x ^ y) & 1) != 0;
+			texel[0] = white ? 255 : (unsigned char) (x * 255 / size);
+			texel[1] = white ? 255 : (unsigned char) (y * 255 / size);
+			texel[2] = white ? 255 : 0;
+			texel[3] = 255;
+		}
+	}
+
+	std::vector<int> sizes{ size };
+	std::vector<size_t> offsets{ 0 };
+	while (sizes.back() > 1) {
+		offsets.push_back(offsets.back() + (size_t) sizes.back() * sizes.back() * 4);
+		sizes.push_back(sizes.back() / 2);
+	}
+	std::vector<unsigned char> chain(offsets.back() + 4);
+	std::memcpy(chain.data(), texels.data(), texels.size());
+	auto buildChain = [&](JobSystem* jobs) {
+		for (size_t i = 1; i < sizes.size(); i++) {
+			downsampleLevel(chain.data() + offsets[i - 1], sizes[i - 1], sizes[i - 1], 4, true, chain.data() + offsets[i], jobs);
+		}
+	};
+
+	std::printf("\nmip chain for a %dx%d RGBA texture\n", size, size);
+	const int runs = 5;
+	benchClock::time_point start = benchClock::now();
+	for (int r = 0; r < runs; r++) buildChain(NULL);
+	std::printf("%-36s %10.2f ms\n", "CPU gamma correct, 1 thread", msSince(start) / runs);
+	JobSystem jobs{};
+	start = benchClock::now();
+	for (int r = 0; r < runs; r++) buildChain(&jobs);
+	std::printf("%-36s %10.2f ms\n", ("CPU gamma correct, " + std::to_string(jobs.getThreadCount() + 1) + " threads").c_str(), msSince(start) / runs);
+
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	GLState::bindTexture(0, texture);
+	double generateMs = 0.0, uploadMs = 0.0;
+	for (int r = 0; r < runs; r++) {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+		glFinish();
+		start = benchClock::now();
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glFinish();
+		generateMs += msSince(start);
+
+		start = benchClock::now();
+		for (size_t i = 1; i < sizes.size(); i++) {
+			glTexImage2D(GL_TEXTURE_2D, (GLint) i, GL_RGBA, sizes[i], sizes[i], 0, GL_RGBA, GL_UNSIGNED_BYTE, chain.data() + offsets[i]);
+		}
+		glFinish();
+		uploadMs += msSince(start);
+	}
+	std::printf("%-36s %10.2f ms\n", "glGenerateMipmap", generateMs / runs);
+	std::printf("%-36s %10.2f ms\n", "upload of the baked levels 1..n", uploadMs / runs);
+
+	// the driver's 1x1 level against ours, and our levels against the reference
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+	glGenerateMipmap(GL_TEXTURE_2D);
+	unsigned char driverTexel[4];
+	glGetTexImage(GL_TEXTURE_2D, (GLint) sizes.size() - 1, GL_RGBA, GL_UNSIGNED_BYTE, driverTexel);
+	glDeleteTextures(1, &texture);
+
+	const unsigned char* ours = chain.data() + offsets.back();
+	std::printf("1x1 level: gamma correct %d %d %d, glGenerateMipmap %d %d %d, worst error against reference %d\n",
+		ours[0], ours[1], ours[2], driverTexel[0], driverTexel[1], driverTexel[2], worstMipError(texels, size, size));
+
+	// odd sides all the way down, and a bright last row and column that must not get lost
+	const int oddWidth = 333, oddHeight = 75;
+	std::vector<unsigned char> odd((size_t) oddWidth * oddHeight * 4);
+	for (int y = 0; y < oddHeight; y++) {
+		for (int x = 0; x < oddWidth; x++) {
+			unsigned char* texel = &odd[((size_t) y * oddWidth + x) * 4];
+			bool edge = x == oddWidth - 1 || y == oddHeight - 1;
+			texel[0] = edge ? 255 : (unsigned char) (x * 255 / oddWidth);
+			texel[1] = edge ? 255 : (unsigned char) (y * 255 / oddHeight);
+			texel[2] = (unsigned char) (((x ^ y) & 1) * 255);
+			texel[3] = (unsigned char) (255 - x * 128 / oddWidth);
+		}
+	}
+	std::printf("%dx%d chain, worst error against reference %d\n", oddWidth, oddHeight, worstMipError(odd, oddWidth, oddHeight));
+}
+
+// a sphere with deep ripples so it hides parts of itself, triangles shuffled like a careless exporter
+static void rippledSphere(int rings, int segments, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	vertices.clear();
+	indices.clear();
+	for (int r = 0; r <= rings; r++) {
+		float theta = glm::pi<float>() * r / rings;
+		for (int s = 0; s <= segments; s++) {
+			float phi = 2.0f * glm::pi<float>() * s / segments;
+			glm::vec3 normal{ std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+			float radius = 1.0f + 0.35f * std::sin(8.0f * theta) * std::sin(8.0f * phi);
+			vertices.push_back(Vertex{ normal * radius, normal, glm::vec2{ (float) s / segments, (float) r / rings } });
+		}
+	}
+	std::vector<unsigned int> grid;
+	for (int r = 0; r < rings; r++) {
+		for (int s = 0; s < segments; s++) {
+			unsigned int a = r * (segments + 1) + s, b = a + segments + 1;
+			grid.insert(grid.end(), { a, b, a + 1, a + 1, b, b + 1 });
+		}
+	}
+	std::vector<unsigned int> order(grid.size() / 3);
+	for (unsigned int t = 0; t < order.size(); t++) order[t] = t;
+	std::mt19937 rng{ 15 };
+	std::shuffle(order.begin(), order.end(), rng);
+	for (unsigned int t : order) {
+		indices.insert(indices.end(), grid.begin() + t * 3, grid.begin() + t * 3 + 3);
+	}
+}
+
+static void benchOptimize(const std::string& shaderFolderPath, const std::string& modelPath) {
+	Shader shader{ (shaderFolderPath + "vShader1.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str() };
+	UniformHandle modelUniform{ shader.getUniform("model") };
+	SceneUniformBuffer scene{};
+	scene.frame.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+
+	std::vector<Vertex> source;
+	std::vector<unsigned int> sourceIndices;
+	rippledSphere(256, 512, source, sourceIndices);
+
+	// samples that passed the depth test over samples that ended up visible, from six sides
+	const glm::vec3 eyes[] = { { 3, 0, 0 }, { -3, 0, 0 }, { 0, 3, 0.01f }, { 0, -3, 0.01f }, { 0, 0, 3 }, { 0, 0, -3 } };
+	unsigned int query;
+	glGenQueries(1, &query);
+	auto samples = [&](Mesh& mesh) {
+		GLuint result = 0;
+		glBeginQuery(GL_SAMPLES_PASSED, query);
+		GLState::bindVertexArray(mesh.getVAO());
+		mesh.drawElements();
+		glEndQuery(GL_SAMPLES_PASSED);
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT, &result);
+		return (double) result;
+	};
+	auto measureOverdraw = [&](Mesh& mesh) {
+		double passed = 0.0, visible = 0.0;
+		shader.use();
+		shader.setMat4fv(modelUniform, 1, false, glm::mat4{ 1.0f });
+		for (const glm::vec3& eye : eyes) {
+			scene.frame.view = glm::lookAt(eye, glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+			scene.upload();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			passed += samples(mesh);
+			glDepthFunc(GL_EQUAL);
+			visible += samples(mesh);
+			glDepthFunc(GL_LESS);
+		}
+		return passed / std::max(1.0, visible);
+	};
+	// into a few pixels so vertex work dominates, that is the part the cache order changes
+	auto drawMs = [&](Mesh& mesh) {
+		const int draws = 10;
+		glViewport(0, 0, 8, 8);
+		scene.frame.view = glm::lookAt(eyes[0], glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+		scene.upload();
+		GLState::bindVertexArray(mesh.getVAO());
+		glFinish();
+		benchClock::time_point start = benchClock::now();
+		for (int d = 0; d < draws; d++) {
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			mesh.drawElements();
+		}
+		glFinish();
+		double ms = msSince(start) / draws;
+		glViewport(0, 0, 800, 600);
+		return ms;
+	};
+
+	// every corner its own vertex, the way OBJ faces arrive without joining identical vertices
+	std::vector<Vertex> exploded;
+	std::vector<unsigned int> explodedIndices;
+	for (unsigned int i = 0; i < sourceIndices.size(); i++) {
+		exploded.push_back(source[sourceIndices[i]]);
+		explodedIndices.push_back(i);
+	}
+	benchClock::time_point weldStart = benchClock::now();
+	unsigned int welded = weldVertices(exploded, explodedIndices);
+	double weldMs = msSince(weldStart);
+	bool identical = true;
+	for (unsigned int i = 0; i < sourceIndices.size(); i++) {
+		identical = identical && std::memcmp(&exploded[explodedIndices[i]], &source[sourceIndices[i]], sizeof(Vertex)) == 0;
+	}
+	std::printf("\nwelding %zu vertices: %u left (source has %zu) in %.2f ms, triangles %s\n", sourceIndices.size(), welded,
+		source.size(), weldMs, identical ? "identical" : "MISMATCH");
+
+	std::printf("\nmesh optimizer on a shuffled %zu triangle mesh, %d entry FIFO\n", sourceIndices.size() / 3, VERTEX_CACHE_SIZE);
+	std::printf("%-24s %8s %8s %10s %10s %10s %10s\n", "order", "ACMR", "ATVR", "overdraw", "culled", "opt ms", "draw ms");
+	for (int stage = 0; stage <= 3; stage++) {
+		std::vector<Vertex> vertices{ source };
+		std::vector<unsigned int> indices{ sourceIndices };
+		benchClock::time_point start = benchClock::now();
+		if (stage >= 1) optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+		if (stage >= 2) optimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+		if (stage >= 3) optimizeVertexFetch(vertices, indices);
+		double optimizeMs = msSince(start);
+
+		VertexCacheStats stats = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+		Mesh mesh{ std::move(vertices), std::move(indices), std::vector<Texture>{} };
+		const char* names[] = { "shuffled", "+ vertex cache", "+ overdraw", "+ vertex fetch" };
+		double overdraw = measureOverdraw(mesh);
+		glEnable(GL_CULL_FACE);
+		double culledOverdraw = measureOverdraw(mesh);
+		glDisable(GL_CULL_FACE);
+		double meshDrawMs = drawMs(mesh);
+		std::printf("%-24s %8.3f %8.3f %10.3f %10.3f %10.2f %10.3f\n", names[stage], stats.acmr, stats.atvr,
+			overdraw, culledOverdraw, optimizeMs, meshDrawMs);
+	}
+	glDeleteQueries(1, &query);
+
+	// what the last import measured, cooked files keep the numbers
+	Model model{ modelPath };
+	std::printf("\n%s (%s)\n", modelPath.c_str(), model.isCooked() ? "cooked" : "assimp");
+	std::printf("%-8s %10s %20s %7s %18s %18s\n", "mesh", "triangles", "vertices", "index", "ACMR", "ATVR");
+	for (size_t i = 0; i < model.getMeshes().size(); i++) {
+		const MeshOptimizeReport& report = model.getOptimizeReports()[i];
+		std::printf("%-8zu %10u %9u -> %7u %6ub %8.3f -> %5.3f %8.3f -> %5.3f\n", i, model.getMeshes()[i].getTriangleCount(),
+			report.verticesBefore, report.verticesAfter, model.getMeshes()[i].getIndexSize() * 8,
+			report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr);
+	}
+	const GeometryMemory& memory = model.getGeometryMemory();
+	std::printf("vertices %zu KB, %zu KB welded away, %zu KB saved by packing, indices %zu KB, %zu KB saved by 16 bit\n",
+		memory.vertexBytes / 1024, memory.vertexBytesSaved / 1024, memory.vertexBytesPacked / 1024, memory.indexBytes / 1024,
+		memory.indexBytesSaved / 1024);
+}
+
+static void benchVertexFormats(const std::string& shaderFolderPath, const std::string& modelPath) {
+	Shader shader{ (shaderFolderPath + "vShader1.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str() };
+	UniformHandle modelUniform{ shader.getUniform("model") };
+	SceneUniformBuffer scene{};
+	scene.frame.view = glm::lookAt(glm::vec3{ 0.0f, 0.0f, 3.0f }, glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+	scene.frame.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	scene.upload();
+
+	Model model{ modelPath, NULL, NULL, VERTEX_FLOAT, true };
+	std::vector<Mesh>& source = model.getMeshes();
+	size_t vertexCount = 0;
+	for (const Mesh& mesh : source) vertexCount += mesh.getVertexCount();
+
+	std::printf("\nvertex formats for %s, %zu vertices in %zu meshes\n", modelPath.c_str(), vertexCount, source.size());
+	std::printf("%-10s %7s %9s %12s %12s %10s %10s %10s %9s\n", "format", "bytes", "MB", "max pos", "mean pos",
+		"max deg", "mean deg", "UV texels", "draw ms");
+	for (int f = 0; f < VERTEX_FORMAT_COUNT; f++) {
+		VertexFormat format = (VertexFormat) f;
+		VertexFormatError worst{};
+		double meanPosition = 0.0, meanDegrees = 0.0;
+		std::vector<Mesh> meshes;
+		meshes.reserve(source.size());
+		for (const Mesh& mesh : source) {
+			VertexFormatError error = measureVertexFormatError(format, mesh.getVertexData(), mesh.getVertexCount(), mesh.getBounds());
+			worst.maxPosition = std::max(worst.maxPosition, error.maxPosition);
+			worst.maxNormalDegrees = std::max(worst.maxNormalDegrees, error.maxNormalDegrees);
+			worst.maxUV = std::max(worst.maxUV, error.maxUV);
+			meanPosition += (double) error.meanPosition * mesh.getVertexCount();
+			meanDegrees += (double) error.meanNormalDegrees * mesh.getVertexCount();
+			meshes.push_back(Mesh{ mesh.getVertexData(), mesh.getVertexCount(), mesh.getIndexData(), mesh.getIndexCount(),
+				std::vector<Texture>{}, mesh.getBounds(), mesh.getSphere(), format });
+		}
+
+		// a few pixels, so the time is vertex fetch and shading rather than fragments
+		const int frames = 10;
+		glViewport(0, 0, 8, 8);
+		shader.use();
+		shader.setMat4fv(modelUniform, 1, false, glm::mat4{ 1.0f });
+		glFinish();
+		benchClock::time_point start = benchClock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			for (Mesh& mesh : meshes) {
+				mesh.Draw(shader);
+			}
+		}
+		glFinish();
+		double drawMs = msSince(start) / frames;
+		glViewport(0, 0, 800, 600);
+
+		std::printf("%-10s %7u %9.2f %12.3g %12.3g %10.3f %10.3f %10.2f %9.3f\n", getVertexFormatName(format), getVertexStride(format),
+			vertexCount * getVertexStride(format) / (1024.0 * 1024.0), worst.maxPosition, meanPosition / std::max<size_t>(1, vertexCount),
+			worst.maxNormalDegrees, meanDegrees / std::max<size_t>(1, vertexCount), worst.maxUV * 2048.0f, drawMs);
+	}
+	std::printf("UV texels are the worst UV error on a 2048 texture\n");
+}
+
+static void printHeapStats(const char* label) {
+	GeometryHeapStats stats = GeometryHeap::getStats();
+	std::printf("%-22s %6u %8u %10.2f %10.2f %10.2f %10.2f %8u %9.3f %9.3f\n", label, stats.pages, stats.allocations,
+		stats.vertexBytes / (1024.0 * 1024.0), stats.vertexBytesUsed / (1024.0 * 1024.0), stats.indexBytes / (1024.0 * 1024.0),
+		stats.indexBytesUsed / (1024.0 * 1024.0), stats.freeBlocks, stats.vertexFragmentation, stats.indexFragmentation);
+}
+
+static void benchGeometryHeap(const std::string& shaderFolderPath) {
+	Shader shader{ (shaderFolderPath + "vShader1.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str() };
+	SceneUniformBuffer scene{};
+	scene.frame.view = glm::lookAt(glm::vec3{ 0.0f, 0.0f, 40.0f }, glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+	scene.frame.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	scene.upload();
+
+	// pages left empty by earlier benchmarks go first
+	GeometryHeap::defragment();
+
+	// a field of randomly sized patches in two formats, standing in for many small models
+	const unsigned int meshCount = 4096;
+	std::mt19937 rng{ 19 };
+	std::uniform_int_distribution<int> side{ 2, 48 };
+	std::vector<Mesh> meshes;
+	meshes.reserve(meshCount);
+	benchClock::time_point start = benchClock::now();
+	for (unsigned int m = 0; m < meshCount; m++) {
+		int rows = side(rng), cols = side(rng);
+		glm::vec3 origin{ (float) (m % 64) - 32.0f, (float) (m / 64) * 0.5f - 16.0f, -(float) (m % 7) };
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		for (int r = 0; r <= rows; r++) {
+			for (int c = 0; c <= cols; c++) {
+				glm::vec2 uv{ (float) c / cols, (float) r / rows };
+				vertices.push_back(Vertex{ origin + glm::vec3{ uv.x * 0.9f, uv.y * 0.45f, 0.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f }, uv });
+			}
+		}
+		for (int r = 0; r < rows; r++) {
+			for (int c = 0; c < cols; c++) {
+				unsigned int a = r * (cols + 1) + c, b = a + cols + 1;
+				indices.insert(indices.end(), { a, a + 1, b, b, a + 1, b + 1 });
+			}
+		}
+		meshes.push_back(Mesh{ std::move(vertices), std::move(indices), std::vector<Texture>{}, (m % 2) ? VERTEX_UNORM16 : VERTEX_FLOAT });
+	}
+	double allocateMs = msSince(start);
+
+	RenderQueue queue{};
+	std::vector<unsigned char> pixels(800 * 600 * 4);
+	auto drawAll = [&](std::vector<unsigned char>& out) {
+		glFinish();
+		benchClock::time_point drawStart = benchClock::now();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		queue.begin(scene.frame.view, 100.0f);
+		unsigned int identity = queue.addTransform(glm::mat4{ 1.0f });
+		for (Mesh& mesh : meshes) queue.submit(shader, mesh, identity);
+		queue.execute();
+		glFinish();
+		double ms = msSince(drawStart);
+		glReadPixels(0, 0, 800, 600, GL_RGBA, GL_UNSIGNED_BYTE, out.data());
+		return ms;
+	};
+
+	std::printf("\ngeometry heap, %u meshes\n", meshCount);
+	std::printf("%-22s %6s %8s %10s %10s %10s %10s %8s %9s %9s\n", "", "pages", "meshes", "vertex MB", "used", "index MB",
+		"used", "free", "vtx frag", "idx frag");
+	printHeapStats("allocated");
+	double drawMs = drawAll(pixels);
+	std::printf("allocated in %.2f ms, one frame %.2f ms with %u state changes for %u draws\n", allocateMs, drawMs,
+		queue.getStats().sortedStateChanges, queue.getStats().draws);
+
+	// unload a random half, as if models came and went
+	std::shuffle(meshes.begin(), meshes.end(), rng);
+	meshes.erase(meshes.begin() + meshCount / 2, meshes.end());
+	printHeapStats("half freed");
+	std::vector<unsigned char> before(pixels.size()), after(pixels.size());
+	drawAll(before);
+
+	start = benchClock::now();
+	size_t copied = GeometryHeap::defragment();
+	glFinish();
+	double defragmentMs = msSince(start);
+	printHeapStats("defragmented");
+	drawAll(after);
+	std::printf("defragment copied %.2f MB in %.2f ms, frame after it %s\n", copied / (1024.0 * 1024.0), defragmentMs,
+		before == after ? "identical" : "DIFFERENT");
+
+	meshes.clear();
+	GeometryHeap::defragment();
+	printHeapStats("all freed");
+}
+
+static void benchBatching(const std::string& shaderFolderPath, const std::string& modelPath) {
+	Shader perDraw{ (shaderFolderPath + "vShader1.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str() };
+	Shader batched{ (shaderFolderPath + "vShaderBatched.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str() };
+	Model model{ modelPath };
+
+	glm::vec3 minPos{ 0.0f }, maxPos{ 0.0f };
+	for (size_t i = 0; i < model.getMeshes().size(); i++) {
+		const AABB& bounds = model.getMeshes()[i].getBounds();
+		minPos = (i == 0) ? bounds.min : glm::min(minPos, bounds.min);
+		maxPos = (i == 0) ? bounds.max : glm::max(maxPos, bounds.max);
+	}
+	float spacing = glm::length(maxPos - minPos);
+
+	SceneUniformBuffer scene{};
+	scene.frame.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 1000.0f);
+
+	std::printf("\nmulti-draw batching, copies of %s (%zu meshes each)\n", modelPath.c_str(), model.getMeshes().size());
+	std::printf("%-10s %8s %12s %12s %12s %12s %10s\n", "copies", "draws", "calls", "batched", "per-draw ms", "batched ms",
+		"output");
+	RenderQueue queue{};
+	std::vector<unsigned char> perDrawPixels(800 * 600 * 4), batchedPixels(800 * 600 * 4);
+	for (int side = 4; side <= 32; side *= 2) {
+		// a grid of copies in front of the camera, every mesh its own packet
+		std::vector<glm::mat4> placements;
+		for (int y = 0; y < side; y++) {
+			for (int x = 0; x < side; x++) {
+				placements.push_back(glm::translate(glm::mat4{ 1.0f }, glm::vec3{ (x - side * 0.5f) * spacing, (y - side * 0.5f) * spacing, 0.0f }
+					- (minPos + maxPos) * 0.5f));
+			}
+		}
+		scene.frame.view = glm::lookAt(glm::vec3{ 0.0f, 0.0f, side * spacing * 1.3f }, glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+		scene.upload();
+
+		auto frame = [&](Shader& shader, std::vector<unsigned char>& pixels) {
+			const int frames = 5;
+			glFinish();
+			benchClock::time_point start = benchClock::now();
+			for (int f = 0; f < frames; f++) {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				queue.begin(scene.frame.view, side * spacing * 3.0f);
+				for (const glm::mat4& placement : placements) {
+					unsigned int transform = queue.addTransform(placement);
+					for (Mesh& mesh : model.getMeshes()) queue.submit(shader, mesh, transform);
+				}
+				queue.execute();
+			}
+			glFinish();
+			double ms = msSince(start) / frames;
+			glReadPixels(0, 0, 800, 600, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			return ms;
+		};
+		double perDrawMs = frame(perDraw, perDrawPixels);
+		unsigned int perDrawCalls = queue.getStats().drawCalls;
+		double batchedMs = frame(batched, batchedPixels);
+		std::printf("%-10d %8u %12u %12u %12.2f %12.2f %10s\n", side * side, queue.getStats().draws, perDrawCalls,
+			queue.getStats().drawCalls, perDrawMs, batchedMs, perDrawPixels == batchedPixels ? "identical" : "DIFFERENT");
+	}
+}
+
+static void benchLod(const std::string& shaderFolderPath, const std::string& modelPath) {
+	Shader shader{ (shaderFolderPath + "vShaderBatched.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str() };
+	// keeps the CPU copies, the simplifier runs again on the full levels below
+	Model model{ modelPath, NULL, NULL, VERTEX_FLOAT, true };
+
+	std::printf("\nimport time simplification of %s\n", modelPath.c_str());
+	std::printf("%-6s %10s %10s %10s %10s %10s %28s\n", "mesh", "radius", "lod 0", "lod 1", "lod 2", "lod 3", "error / radius");
+	double simplifyMs = 0.0;
+	size_t levelTriangles[MESH_LOD_MAX] = {};
+	for (size_t i = 0; i < model.getMeshes().size(); i++) {
+		const Mesh& mesh = model.getMeshes()[i];
+		std::vector<Vertex> vertices(mesh.getVertexData(), mesh.getVertexData() + mesh.getVertexCount());
+		std::vector<unsigned int> indices(mesh.getIndexData(), mesh.getIndexData() + mesh.getIndexCount());
+		benchClock::time_point start = benchClock::now();
+		std::vector<MeshLod> lods = generateLods(vertices, indices);
+		simplifyMs += msSince(start);
+
+		std::printf("%-6zu %10.3f", i, mesh.getSphere().radius);
+		std::string errors;
+		for (unsigned int l = 0; l < MESH_LOD_MAX; l++) {
+			if (l < lods.size()) {
+				std::printf(" %10u", lods[l].indexCount / 3);
+				levelTriangles[l] += lods[l].indexCount / 3;
+				char error[16];
+				std::snprintf(error, sizeof(error), " %.4f", lods[l].error / mesh.getSphere().radius);
+				errors += error;
+			}
+			else {
+				std::printf(" %10s", "-");
+			}
+		}
+		std::printf(" %28s\n", errors.c_str());
+	}
+	std::printf("%-6s %10s %10zu %10zu %10zu %10zu, %.1f ms to simplify\n", "total", "", levelTriangles[0], levelTriangles[1],
+		levelTriangles[2], levelTriangles[3], simplifyMs);
+
+	glm::vec3 minPos{ 0.0f }, maxPos{ 0.0f };
+	for (size_t i = 0; i < model.getMeshes().size(); i++) {
+		const AABB& bounds = model.getMeshes()[i].getBounds();
+		minPos = (i == 0) ? bounds.min : glm::min(minPos, bounds.min);
+		maxPos = (i == 0) ? bounds.max : glm::max(maxPos, bounds.max);
+	}
+	float spacing = glm::length(maxPos - minPos);
+
+	// a field of copies on the ground, the camera backs away from its near edge
+	const int side = 8;
+	std::vector<glm::mat4> placements;
+	for (int z = 0; z < side; z++) {
+		for (int x = 0; x < side; x++) {
+			placements.push_back(glm::translate(glm::mat4{ 1.0f }, glm::vec3{ (x - side * 0.5f) * spacing, 0.0f, -z * spacing }
+				- (minPos + maxPos) * 0.5f));
+		}
+	}
+	std::vector<unsigned int> lodStates(placements.size() * model.getMeshes().size());
+
+	SceneUniformBuffer scene{};
+	float farPlane = spacing * 1000.0f;
+	scene.frame.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, farPlane);
+	RenderQueue queue{};
+
+	std::printf("\nLOD selection, %dx%d copies, at most 1 pixel of error\n", side, side);
+	std::printf("%-12s %12s %12s %8s %10s %10s %12s %12s\n", "distance", "full tris", "lod tris", "ratio", "full ms", "lod ms",
+		"switches", "no hyst.");
+	for (float distance = spacing * 0.25f; distance <= spacing * 64.0f; distance *= 2.0f) {
+		// the camera wobbles a little every frame, hysteresis should keep the levels from following it
+		auto frame = [&](int f, float hysteresis, bool lod) {
+			float wobble = distance * (1.0f + 0.03f * (f % 2 == 0 ? 1.0f : -1.0f));
+			scene.frame.view = glm::lookAt(glm::vec3{ 0.0f, wobble * 0.3f, wobble }, glm::vec3{ 0.0f, 0.0f, -side * spacing * 0.5f },
+				glm::vec3{ 0.0f, 1.0f, 0.0f });
+			scene.upload();
+			if (lod) queue.setLodSelection(scene.frame.projection[1][1], 600.0f, 1.0f, hysteresis);
+			else queue.disableLodSelection();
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			queue.begin(scene.frame.view, farPlane);
+			unsigned int switches = 0;
+			for (size_t p = 0; p < placements.size(); p++) {
+				unsigned int transform = queue.addTransform(placements[p]);
+				for (size_t m = 0; m < model.getMeshes().size(); m++) {
+					unsigned int& state = lodStates[p * model.getMeshes().size() + m];
+					unsigned int previous = state;
+					queue.submit(shader, model.getMeshes()[m], transform, &state);
+					switches += (state != previous);
+				}
+			}
+			queue.execute();
+			return switches;
+		};
+
+		const int frames = 6;
+		auto run = [&](float hysteresis, bool lod, unsigned int& triangles, unsigned int& switches) {
+			// one frame to settle on this distance's levels, only the wobble after it counts
+			frame(0, hysteresis, lod);
+			switches = 0;
+			glFinish();
+			benchClock::time_point start = benchClock::now();
+			for (int f = 1; f <= frames; f++) {
+				switches += frame(f, hysteresis, lod);
+			}
+			glFinish();
+			triangles = queue.getStats().drawnTriangles;
+			return msSince(start) / frames;
+		};
+		unsigned int fullTriangles, lodTriangles, switches, unstableSwitches, unused;
+		double fullMs = run(LOD_HYSTERESIS, false, fullTriangles, unused);
+		double lodMs = run(LOD_HYSTERESIS, true, lodTriangles, switches);
+		run(0.0f, true, unused, unstableSwitches);
+		std::printf("%-12.1f %12u %12u %8.3f %10.2f %10.2f %12u %12u\n", distance, fullTriangles, lodTriangles,
+			(double) lodTriangles / fullTriangles, fullMs, lodMs, switches, unstableSwitches);
+	}
+}
+
+static void benchMeshlets(const std::string& shaderFolderPath, const std::string& modelPath) {
+	Shader shader{ (shaderFolderPath + "vShaderBatched.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str() };
+	Model model{ modelPath };
+
+	size_t meshlets = 0, triangles = 0;
+	glm::vec3 minPos{ 0.0f }, maxPos{ 0.0f };
+	for (size_t i = 0; i < model.getMeshes().size(); i++) {
+		const Mesh& mesh = model.getMeshes()[i];
+		meshlets += mesh.getMeshlets().size();
+		triangles += mesh.getTriangleCount();
+		minPos = (i == 0) ? mesh.getBounds().min : glm::min(minPos, mesh.getBounds().min);
+		maxPos = (i == 0) ? mesh.getBounds().max : glm::max(maxPos, mesh.getBounds().max);
+	}
+	float spacing = glm::length(maxPos - minPos);
+	std::printf("\nmeshlet culling, %s: %zu triangles in %zu meshlets, %.1f triangles each\n", modelPath.c_str(), triangles,
+		meshlets, (double) triangles / std::max<size_t>(meshlets, 1));
+
+	// a 4x4 grid of copies, seen from outside, from above and from among them
+	const int side = 4;
+	std::vector<glm::mat4> placements;
+	for (int z = 0; z < side; z++) {
+		for (int x = 0; x < side; x++) {
+			placements.push_back(glm::translate(glm::mat4{ 1.0f }, glm::vec3{ (x - side * 0.5f + 0.5f) * spacing, 0.0f,
+				(z - side * 0.5f + 0.5f) * spacing } - (minPos + maxPos) * 0.5f));
+		}
+	}
+	struct View {
+		const char* name;
+		glm::vec3 eye, target;
+	};
+	const View views[] = {
+		{ "front", glm::vec3{ 0.0f, 0.0f, side * spacing * 1.5f }, glm::vec3{ 0.0f } },
+		{ "corner", glm::vec3{ side * spacing, side * spacing * 0.5f, side * spacing }, glm::vec3{ 0.0f } },
+		{ "above", glm::vec3{ 0.0f, side * spacing * 1.5f, 0.01f }, glm::vec3{ 0.0f } },
+		{ "inside", glm::vec3{ spacing * 0.5f, 0.0f, spacing * 0.5f }, glm::vec3{ side * spacing, 0.0f, -side * spacing } },
+	};
+
+	SceneUniformBuffer scene{};
+	float farPlane = side * spacing * 10.0f;
+	scene.frame.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, farPlane);
+	RenderQueue queue{};
+	glEnable(GL_CULL_FACE);
+
+	std::printf("%-8s %10s %10s %10s %8s %10s %10s %8s %10s %10s %10s\n", "view", "in view", "drawn", "meshlets", "removed",
+		"whole us", "cull us", "ranges", "whole ms", "cull ms", "output");
+	std::vector<unsigned char> wholePixels(800 * 600 * 4), culledPixels(800 * 600 * 4);
+	for (const View& view : views) {
+		scene.frame.view = glm::lookAt(view.eye, view.target, glm::vec3{ 0.0f, 1.0f, 0.0f });
+		scene.upload();
+		Frustum frustum = Frustum::fromMatrix(scene.frame.projection * scene.frame.view);
+
+		// submission alone, many times over, to see what the meshlet tests add to it
+		auto submit = [&]() {
+			queue.begin(scene.frame.view, farPlane, frustum);
+			for (const glm::mat4& placement : placements) {
+				unsigned int transform = queue.addTransform(placement);
+				for (Mesh& mesh : model.getMeshes()) queue.submit(shader, mesh, transform);
+			}
+		};
+		auto cpu = [&](bool meshletCulling) {
+			const int repeats = 200;
+			queue.setMeshletCulling(meshletCulling);
+			benchClock::time_point start = benchClock::now();
+			for (int r = 0; r < repeats; r++) submit();
+			return msSince(start) * 1000.0 / repeats;
+		};
+		auto gpu = [&](bool meshletCulling, std::vector<unsigned char>& pixels) {
+			const int frames = 5;
+			queue.setMeshletCulling(meshletCulling);
+			glFinish();
+			benchClock::time_point start = benchClock::now();
+			for (int f = 0; f < frames; f++) {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				submit();
+				queue.execute();
+			}
+			glFinish();
+			double ms = msSince(start) / frames;
+			glReadPixels(0, 0, 800, 600, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			return ms;
+		};
+
+		double wholeUs = cpu(false);
+		double cullUs = cpu(true);
+		double wholeMs = gpu(false, wholePixels);
+		unsigned int inView = queue.getStats().drawnTriangles;
+		double cullMs = gpu(true, culledPixels);
+		RenderQueue::Stats stats = queue.getStats();
+		std::printf("%-8s %10u %10u %10u %7.1f%% %10.1f %10.1f %8u %10.2f %10.2f %10s\n", view.name, inView, stats.drawnTriangles,
+			stats.testedMeshlets, 100.0 * stats.culledMeshletTriangles / std::max(inView, 1u), wholeUs, cullUs,
+			stats.meshletRanges, wholeMs, cullMs, wholePixels == culledPixels ? "identical" : "DIFFERENT");
+	}
+	glDisable(GL_CULL_FACE);
+}
+
+// the usual pointer tree the scene graph replaces, every node recomputed from the root down
+struct PointerNode {
+	glm::mat4 local;
+	glm::mat4 world;
+	std::vector<std::unique_ptr<PointerNode>> children;
+};
+
+static void updatePointerTree(PointerNode& node, const glm::mat4& parentWorld) {
+	node.world = parentWorld * node.local;
+	for (auto& child : node.children) {
+		updatePointerTree(*child, node.world);
+	}
+}
+
+static void benchSceneGraph() {
+	const unsigned int nodeCount = 100000;
+	const unsigned int frames = 100;
+	std::printf("\nscene graph, %u nodes, 1%% of them moving every frame\n", nodeCount);
+	std::printf("%-10s %12s %12s %12s %14s %10s\n", "shape", "dirty ms", "full ms", "pointer ms", "recomputed", "result");
+
+	struct Shape {
+		const char* name;
+		// parent of node i, always before it
+		unsigned int (*parent)(unsigned int i, std::mt19937& rng);
+	};
+	const Shape shapes[] = {
+		// a balanced tree, four children per node, subtrees of a random node are small
+		{ "bushy", [](unsigned int i, std::mt19937&) { return (i - 1) / 4; } },
+		// every node under a random earlier one, shallow on average with a few long branches
+		{ "random", [](unsigned int i, std::mt19937& rng) { return std::uniform_int_distribution<unsigned int>{ 0, i - 1 }(rng); } },
+		// a thousand chains of a hundred, moving a node near the root drags the rest of its chain
+		{ "chains", [](unsigned int i, std::mt19937&) { return (i % 100 == 1 || i == 1) ? 0u : i - 1; } },
+	};
+
+	for (const Shape& shape : shapes) {
+		std::mt19937 rng{ 7 };
+		std::uniform_real_distribution<float> offset{ -1.0f, 1.0f };
+		SceneGraph graph;
+		std::vector<PointerNode*> pointerNodes;
+		PointerNode pointerRoot{};
+		pointerRoot.local = glm::mat4{ 1.0f };
+		for (unsigned int i = 0; i < nodeCount; i++) {
+			glm::mat4 local = glm::translate(glm::mat4{ 1.0f }, glm::vec3{ offset(rng), offset(rng), offset(rng) });
+			unsigned int parent = (i == 0) ? 0 : shape.parent(i, rng);
+			graph.addNode(local, (i == 0) ? SCENE_NO_PARENT : (int) parent);
+
+			PointerNode* node = &pointerRoot;
+			if (i > 0) {
+				pointerNodes[parent]->children.push_back(std::make_unique<PointerNode>());
+				node = pointerNodes[parent]->children.back().get();
+			}
+			node->local = local;
+			pointerNodes.push_back(node);
+		}
+		graph.update();
+
+		// the same moves for every variant
+		std::vector<unsigned int> moved;
+		std::vector<glm::mat4> moves;
+		for (unsigned int f = 0; f < frames; f++) {
+			for (unsigned int m = 0; m < nodeCount / 100; m++) {
+				unsigned int node = std::uniform_int_distribution<unsigned int>{ 0, nodeCount - 1 }(rng);
+				moved.push_back(node);
+				moves.push_back(glm::rotate(graph.getLocal(node), offset(rng), glm::vec3{ 0.0f, 1.0f, 0.0f }));
+			}
+		}
+
+		size_t recomputed = 0;
+		benchClock::time_point start = benchClock::now();
+		for (unsigned int f = 0; f < frames; f++) {
+			for (unsigned int m = f * (nodeCount / 100); m < (f + 1) * (nodeCount / 100); m++) {
+				graph.setLocal(moved[m], moves[m]);
+			}
+			recomputed += graph.update();
+		}
+		double dirtyMs = msSince(start) / frames;
+
+		// the result has to match recomputing everything
+		std::vector<glm::mat4> dirtyWorld(nodeCount);
+		for (unsigned int i = 0; i < nodeCount; i++) dirtyWorld[i] = graph.getWorld(i);
+		start = benchClock::now();
+		for (unsigned int f = 0; f < frames; f++) {
+			graph.invalidate();
+			graph.update();
+		}
+		double fullMs = msSince(start) / frames;
+		bool matches = true;
+		for (unsigned int i = 0; i < nodeCount && matches; i++) matches = dirtyWorld[i] == graph.getWorld(i);
+
+		for (size_t m = 0; m < moved.size(); m++) pointerNodes[moved[m]]->local = moves[m];
+		start = benchClock::now();
+		for (unsigned int f = 0; f < frames; f++) {
+			updatePointerTree(pointerRoot, glm::mat4{ 1.0f });
+		}
+		double pointerMs = msSince(start) / frames;
+		for (unsigned int i = 0; i < nodeCount && matches; i++) matches = pointerNodes[i]->world == graph.getWorld(i);
+
+		std::printf("%-10s %12.3f %12.3f %12.3f %14zu %10s\n", shape.name, dirtyMs, fullMs, pointerMs, recomputed / frames,
+			matches ? "matches" : "DIFFERENT");
+	}
+}
+
+// the usual object the entity store replaces, everything about a thing in one class
+struct GameObject {
+	std::string name;
+	glm::vec3 position{ 0.0f };
+	float scale = 1.0f;
+	glm::vec3 axis{ 0.0f, 1.0f, 0.0f };
+	float angle = 0.0f;
+	glm::mat4 world{ 1.0f };
+	bool renderable = false;
+	unsigned int mesh = 0;
+	unsigned int material = 0;
+	AABB localBounds;
+	AABB worldBounds;
+	bool light = false;
+	LightComponent lightData;
+
+	virtual ~GameObject() {}
+
+	void updateTransform() {
+		glm::mat4 m = glm::translate(glm::mat4{ 1.0f }, position);
+		if (angle != 0.0f) m = glm::rotate(m, angle, axis);
+		world = glm::scale(m, glm::vec3{ scale });
+	}
+};
+
+static void benchEntities() {
+	std::printf("\nentities, 90%% renderable with bounds, 1%% lights, three systems a frame\n");
+	std::printf("%-10s %-12s %12s %12s %12s %12s %10s %10s\n", "entities", "layout", "transform ms", "bounds ms", "cull ms",
+		"frame ms", "visible", "result");
+
+	JobSystem jobs{};
+	Frustum frustum = Frustum::fromMatrix(glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 200.0f));
+	const unsigned int counts[] = { 10000, 100000, 1000000 };
+	for (unsigned int count : counts) {
+		const unsigned int frames = std::max(2u, 2000000 / count);
+		std::mt19937 rng{ 11 };
+		std::uniform_real_distribution<float> spread{ -100.0f, 100.0f };
+		std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+		std::vector<GameObject> objects(count);
+		for (unsigned int i = 0; i < count; i++) {
+			GameObject& object = objects[i];
+			object.name = "object " + std::to_string(i);
+			object.position = glm::vec3{ spread(rng), spread(rng), spread(rng) };
+			object.scale = 0.5f + unit(rng);
+			object.axis = glm::normalize(glm::vec3{ unit(rng), unit(rng), unit(rng) } + 0.1f);
+			object.angle = unit(rng) * 6.0f;
+			object.light = (i % 100 == 99);
+			object.renderable = !object.light && (i % 10 != 0);
+			object.localBounds = AABB{ glm::vec3{ -0.5f }, glm::vec3{ 0.5f } };
+		}
+
+		double transformMs, boundsMs, cullMs;
+		unsigned int visible;
+		std::vector<glm::mat4> expected(count);
+
+		// heap objects reached through pointers, in the shuffled order a long running program leaves them
+		{
+			std::vector<std::unique_ptr<GameObject>> pointers;
+			for (const GameObject& object : objects) pointers.push_back(std::make_unique<GameObject>(object));
+			std::shuffle(pointers.begin(), pointers.end(), rng);
+
+			transformMs = boundsMs = cullMs = 0.0;
+			for (unsigned int f = 0; f < frames; f++) {
+				benchClock::time_point start = benchClock::now();
+				for (auto& object : pointers) object->updateTransform();
+				transformMs += msSince(start);
+				start = benchClock::now();
+				for (auto& object : pointers) {
+					if (object->renderable) object->worldBounds = object->localBounds.transform(object->world);
+				}
+				boundsMs += msSince(start);
+				start = benchClock::now();
+				visible = 0;
+				for (auto& object : pointers) {
+					if (object->renderable && frustum.intersects(object->worldBounds)) visible++;
+				}
+				cullMs += msSince(start);
+			}
+			std::printf("%-10u %-12s %12.3f %12.3f %12.3f %12.3f %10u %10s\n", count, "pointers", transformMs / frames, boundsMs / frames,
+				cullMs / frames, (transformMs + boundsMs + cullMs) / frames, visible, "-");
+		}
+
+		// the same objects packed in one array
+		transformMs = boundsMs = cullMs = 0.0;
+		unsigned int objectVisible = 0;
+		for (unsigned int f = 0; f < frames; f++) {
+			benchClock::time_point start = benchClock::now();
+			for (GameObject& object : objects) object.updateTransform();
+			transformMs += msSince(start);
+			start = benchClock::now();
+			for (GameObject& object : objects) {
+				if (object.renderable) object.worldBounds = object.localBounds.transform(object.world);
+			}
+			boundsMs += msSince(start);
+			start = benchClock::now();
+			objectVisible = 0;
+			for (GameObject& object : objects) {
+				if (object.renderable && frustum.intersects(object.worldBounds)) objectVisible++;
+			}
+			cullMs += msSince(start);
+		}
+		std::printf("%-10u %-12s %12.3f %12.3f %12.3f %12.3f %10u %10s\n", count, "objects", transformMs / frames, boundsMs / frames,
+			cullMs / frames, (transformMs + boundsMs + cullMs) / frames, objectVisible, objectVisible == visible ? "matches" : "DIFFERENT");
+		for (unsigned int i = 0; i < count; i++) expected[i] = objects[i].world;
+
+		EntityStore store;
+		store.getTransforms().reserve(count);
+		store.getRenderables().reserve(count);
+		store.getBounds().reserve(count);
+		for (const GameObject& object : objects) {
+			Entity entity = store.create();
+			store.getTransforms().add(entity, TransformComponent{ object.position, object.scale, object.axis, object.angle });
+			if (object.renderable) {
+				store.getRenderables().add(entity, RenderableComponent{ object.mesh, object.material });
+				store.getBounds().add(entity, BoundsComponent{ object.localBounds, object.localBounds });
+			}
+			if (object.light) store.getLights().add(entity, object.lightData);
+		}
+		std::vector<GameObject>().swap(objects);
+
+		std::vector<Entity> inView;
+		for (JobSystem* systemJobs : { (JobSystem*) nullptr, &jobs }) {
+			transformMs = boundsMs = cullMs = 0.0;
+			for (unsigned int f = 0; f < frames; f++) {
+				benchClock::time_point start = benchClock::now();
+				updateTransforms(store, systemJobs);
+				transformMs += msSince(start);
+				start = benchClock::now();
+				updateBounds(store, systemJobs);
+				boundsMs += msSince(start);
+				start = benchClock::now();
+				inView.clear();
+				cullRenderables(store, frustum, inView);
+				cullMs += msSince(start);
+			}
+
+			bool matches = inView.size() == visible;
+			const ComponentArray<TransformComponent>& transforms = store.getTransforms();
+			for (unsigned int i = 0; i < count && matches; i++) {
+				matches = transforms.data()[i].world == expected[transforms.getEntity(i) & ENTITY_INDEX_MASK];
+			}
+			std::printf("%-10u %-12s %12.3f %12.3f %12.3f %12.3f %10zu %10s\n", count, systemJobs ? "store jobs" : "store",
+				transformMs / frames, boundsMs / frames, cullMs / frames, (transformMs + boundsMs + cullMs) / frames, inView.size(),
+				matches ? "matches" : "DIFFERENT");
+		}
+	}
+	std::printf("job system: %u workers besides the caller\n", jobs.getThreadCount());
+}
+
+// something for a job to chew on that the compiler cannot drop
+static float busyWork(unsigned int seed, unsigned int iterations) {
+	float x = seed * 0.001f;
+	for (unsigned int i = 0; i < iterations; i++) {
+		x = std::sin(x) * 0.5f + 1.0f;
+	}
+	return x;
+}
+
+static void benchJobs() {
+	const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	std::printf("\njob system, %u hardware threads\n", cores);
+	std::printf("%-40s %12s %10s\n", "spawn overhead", "ns per job", "ran");
+
+	{
+		JobSystem jobs{};
+		const unsigned int count = 100000;
+		std::atomic<unsigned int> ran{ 0 };
+		auto report = [&](const char* name, double ms, unsigned int jobCount) {
+			std::printf("%-40s %12.1f %10u\n", name, ms * 1e6 / jobCount, ran.exchange(0));
+		};
+
+		JobCounter counter;
+		benchClock::time_point start = benchClock::now();
+		for (unsigned int i = 0; i < count; i++) {
+			jobs.spawn([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+		}
+		jobs.wait(counter);
+		report("spawn and wait, empty jobs", msSince(start), count);
+
+		// every job waits for the one before it, nothing overlaps
+		const unsigned int chain = 10000;
+		std::unique_ptr<JobCounter[]> links{ new JobCounter[chain] };
+		start = benchClock::now();
+		jobs.spawn([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &links[0]);
+		for (unsigned int i = 1; i < chain; i++) {
+			jobs.spawnAfter(links[i - 1], [&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &links[i]);
+		}
+		jobs.wait(links[chain - 1]);
+		report("dependency chain", msSince(start), chain);
+
+		start = benchClock::now();
+		jobs.parallelFor(count, [&ran](unsigned int) { ran.fetch_add(1, std::memory_order_relaxed); });
+		report("parallelFor, a job per index", msSince(start), count);
+
+		// what the engine had before the job system, a thread per task through std::async
+		const unsigned int asyncCount = 2000;
+		std::vector<std::future<void>> futures;
+		start = benchClock::now();
+		for (unsigned int i = 0; i < asyncCount; i++) {
+			futures.push_back(std::async(std::launch::async, [&ran] { ran.fetch_add(1, std::memory_order_relaxed); }));
+		}
+		for (std::future<void>& future : futures) future.wait();
+		report("std::async", msSince(start), asyncCount);
+	}
+
+	// the same fixed amount of work over more and more threads
+	const unsigned int tasks = 256;
+	const unsigned int iterations = 20000;
+	std::vector<float> expected(tasks), results(tasks);
+	benchClock::time_point start = benchClock::now();
+	for (unsigned int i = 0; i < tasks; i++) expected[i] = busyWork(i, iterations);
+	double serialMs = msSince(start);
+
+	std::printf("%-10s %12s %10s %10s\n", "threads", "ms", "speedup", "result");
+	std::printf("%-10s %12.2f %10.2f %10s\n", "serial", serialMs, 1.0, "-");
+	for (unsigned int threads = 2; threads <= std::max(cores, 4u); threads *= 2) {
+		// the main lane works too, so n threads is n - 1 workers
+		JobSystem jobs{ threads - 1 };
+		start = benchClock::now();
+		jobs.parallelFor(tasks, [&](unsigned int i) { results[i] = busyWork(i, iterations); });
+		double ms = msSince(start);
+		std::printf("%-10u %12.2f %10.2f %10s\n", threads, ms, serialMs / ms, results == expected ? "matches" : "DIFFERENT");
+	}
+}
+
+int main(int argc, char* args[]) {
+	std::string only = (argc > 1) ? args[1] : "";
+	std::string shaderFolderPath = "C:\\Users\\Jason\\Source\\Repos\\SDL2 OpenGL Tests\\SDL2 OpenGL Tests\\Shaders\\";
+	if (argc > 2) shaderFolderPath = args[2];
+	std::string modelPath = "C:\\Users\\Jason\\Source\\Repos\\SDL2 OpenGL Tests\\SDL2 OpenGL Tests\\Textures\\backpack\\backpack.obj";
+	if (argc > 3) modelPath = args[3];
+	std::string textureFolderPath = "C:\\Users\\Jason\\Source\\Repos\\SDL2 OpenGL Tests\\SDL2 OpenGL Tests\\Textures\\";
+	if (argc > 4) textureFolderPath = args[4];
+
+	// GPU benchmarks draw into a hidden window
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+		std::cout << "Could not initialize SDL: " << SDL_GetError() << std::endl;
+		return -1;
+	}
+
+	SDL_Window* window = SDL_CreateWindow("Benchmarks", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 800, 600, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+	SDL_GLContext context = (window == NULL) ? NULL : SDL_GL_CreateContext(window);
+	if (context == NULL || !gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress)) {
+		std::cout << "Failed to create an OpenGL 3.3 context: " << SDL_GetError() << std::endl;
+		return -1;
+	}
+	SDL_GL_SetSwapInterval(0);
+	glViewport(0, 0, 800, 600);
+	glEnable(GL_DEPTH_TEST);
+
+	if (only.empty() || only == "instancing") benchInstancing(shaderFolderPath);
+	if (only.empty() || only == "bvh") benchBVH();
+	if (only.empty() || only == "occlusion") benchOcclusion();
+	if (only.empty() || only == "load") benchLoad(modelPath);
+	if (only.empty() || only == "import") benchImport(modelPath);
+	if (only.empty() || only == "textures") benchTextures(modelPath);
+	if (only.empty() || only == "compression") benchCompression(textureFolderPath);
+	if (only.empty() || only == "mipmaps") benchMipmaps();
+	if (only.empty() || only == "optimize") benchOptimize(shaderFolderPath, modelPath);
+	if (only.empty() || only == "vertexformats") benchVertexFormats(shaderFolderPath, modelPath);
+	if (only.empty() || only == "geometryheap") benchGeometryHeap(shaderFolderPath);
+	if (only.empty() || only == "batching") benchBatching(shaderFolderPath, modelPath);
+	if (only.empty() || only == "lod") benchLod(shaderFolderPath, modelPath);
+	if (only.empty() || only == "meshlets") benchMeshlets(shaderFolderPath, modelPath);
+	if (only.empty() || only == "scenegraph") benchSceneGraph();
+	if (only.empty() || only == "entities") benchEntities();
+	if (only.empty() || only == "jobs") benchJobs();
+
+	// the static caches hold GL objects of their own
+	GeometryHeap::clear();
+	TextureCache::clear();
+	SDL_GL_DeleteContext(context);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+
+	return 0;
+}
\ No newline at end of file
@@ -7,9 +7,17 @@
 
 #include <iostream>
 #include <unordered_map>
+#include <vector>
 
 #include "Shader.h"
 #include "Camera.h"
+#include "GLState.h"
+#include "InstancedRenderer.h"
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include "Bounds.h"
+#include "UniformBuffers.h"
+#include "EntityStore.h"
 
 using keyMap = std::unordered_map<SDL_KeyCode, bool>;
 using floatPair = std::pair<float, float>;
@@ -32,7 +40,7 @@ unsigned int loadTexture(std::string filePath) {
 	if (data) {
 		GLint format{ (numChannels == 1) ? GL_RED :
 											((numChannels == 3) ? GL_RGB : GL_RGBA) };
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		GLState::bindTexture(0, textureID);
 		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -62,12 +70,10 @@ void processEvents(bool& running, SDL_Event* event, keyMap& keyDown, floatPair&
 				running = false;
 				break;
 			case SDLK_DOWN:
-				GLint data[2];
-				glGetIntegerv(GL_POLYGON_MODE, data);
-				if (data[1] == GL_LINE)
-					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+				if (GLState::getPolygonMode() == GL_LINE)
+					GLState::setPolygonMode(GL_FILL);
 				else
-					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+					GLState::setPolygonMode(GL_LINE);
 				break;
 			case SDLK_w:
 				keyDown[SDLK_w] = true;
@@ -165,9 +171,10 @@ void updateCamera(Camera& cam, float deltaTime, keyMap& keyDown, floatPair& delt
 	cam.updateFront(deltaMove.first * cam.getSensitivity(), deltaMove.second * cam.getSensitivity());
 }
 
-void render(unsigned int* VAO, Shader* prog, Camera& cam) {
-	glClearColor(185.0 / 255, 203.0 / 255, 153.0 / 255, 0);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void render(unsigned int* VAO, Shader* prog, InstancedRenderer& cubes, EntityStore& entities, Entity movingLight,
+	const float* cubeVertices, JobSystem& jobs, OcclusionCuller& occlusion, SceneUniformBuffer& scene, Camera& cam) {
+	scene.frame.view = cam.getView();
+	scene.frame.projection = glm::perspective(glm::radians(45.0f), (float)(800.0 / 600.0), 0.1f, 20.0f);
 
 	float slowness = 1;
 	float radius = 1.0f;
@@ -177,58 +184,58 @@ void render(unsigned int* VAO, Shader* prog, Camera& cam) {
 	glm::vec3 lightColor{ abs(sin(SDL_GetTicks() / 1000.0)), abs(cos(SDL_GetTicks() / 1000.0)), abs(cos(SDL_GetTicks() / 1000.0) * sin(SDL_GetTicks() / 1000.0)) };
 	//lightColor = glm::vec3{ 1.0f,1.0f,1.0f };
 
-	prog[0].use();
-
-	prog[0].set3fv("pntLights[0].position", 1, lightPos);
-	prog[0].set3fv("pntLights[0].ambient", 1, lightColor * glm::vec3(0.2));
-	prog[0].set3fv("pntLights[0].diffuse", 1, lightColor * glm::vec3(0.5));
-	prog[0].set3fv("pntLights[0].specular", 1, lightColor * glm::vec3(1.0));
-
-	prog[0].set3fv("spotLight.position", 1, cam.getPos());
-	prog[0].set3fv("spotLight.direction", 1, cam.getFront() - cam.getPos());
-
-	prog[0].set3fv("viewPos", 1, cam.getPos());
-	prog[0].setFloat("time", SDL_GetTicks() / 1000.0f);
+	entities.getTransforms().get(movingLight)->position = lightPos;
+	entities.getLights().get(movingLight)->color = lightColor;
+	updateTransforms(entities, &jobs);
+	updateBounds(entities, &jobs);
+
+	Frustum frustum = Frustum::fromMatrix(scene.frame.projection * scene.frame.view);
+	static std::vector<Entity> inView;
+	inView.clear();
+	cullRenderables(entities, frustum, inView);
+
+	// the cubes hide each other, cull them as a job while this thread sets up the frame
+	occlusion.begin(scene.frame.projection * scene.frame.view);
+	for (Entity cube : inView) {
+		occlusion.addOccluder(cubeVertices, 8 * sizeof(float), 36, NULL, 0, entities.getTransforms().get(cube)->world);
+		occlusion.addOccludee(entities.getBounds().get(cube)->world);
+	}
+	occlusion.cullAsync();
 
-	glm::vec3 cubePositions[] = {
-		glm::vec3(0.0f,  0.0f,  0.0f),
-		glm::vec3(2.0f,  5.0f, -15.0f),
-		glm::vec3(-1.5f, -2.2f, -2.5f),
-		glm::vec3(-3.8f, -2.0f, -12.3f),
-		glm::vec3(2.4f, -0.4f, -3.5f),
-		glm::vec3(-1.7f,  3.0f, -7.5f),
-		glm::vec3(1.3f, -2.0f, -2.5f),
-		glm::vec3(1.5f,  2.0f, -2.5f),
-		glm::vec3(1.5f,  0.2f, -1.5f),
-		glm::vec3(-1.3f,  1.0f, -1.5f)
-	};
+	glClearColor(185.0 / 255, 203.0 / 255, 153.0 / 255, 0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glm::mat4 view{ cam.getView() };
-	glm::mat4 projection{ glm::perspective(glm::radians(45.0f), (float)(800.0 / 600.0), 0.1f, 20.0f) };
+	// per-frame uniforms shared by both programs
+	scene.lights.numPointLights = (int) gatherLights(entities, frustum, scene.lights.pntLights, MAX_POINT_LIGHTS);
 
-	prog[0].setMat4fv("view", 1, GL_FALSE, view);
-	prog[0].setMat4fv("projection", 1, GL_FALSE, projection);
+	scene.lights.spotLight.position = cam.getPos();
+	scene.lights.spotLight.direction = cam.getFront() - cam.getPos();
 
-	for (int i = 0; i < 10; i++) {
-		glm::mat4 model{ 1.0f };
-		model = glm::translate(model, cubePositions[i]);
+	scene.frame.viewPos = cam.getPos();
+	scene.frame.time = SDL_GetTicks() / 1000.0f;
 
-		prog[0].setMat4fv("model", 1, GL_FALSE, model);
+	scene.upload();
 
-		glBindVertexArray(VAO[0]);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+	static std::vector<InstanceData> visibleCubes;
+	visibleCubes.clear();
+	occlusion.wait();
+	for (unsigned int i = 0; i < inView.size(); i++) {
+		if (occlusion.isVisible(i)) visibleCubes.push_back(InstanceData{ entities.getTransforms().get(inView[i])->world, glm::vec4{ 1.0f } });
 	}
+	cubes.setInstances(visibleCubes.data(), visibleCubes.size());
+
+	// the whole cube field in one instanced draw
+	prog[0].use();
+	cubes.draw();
 
 	glm::mat4 lightModel{ 1.0f };
 	lightModel = glm::translate(lightModel, lightPos);
 	lightModel = glm::scale(lightModel, glm::vec3{ 0.2f });
 	prog[1].use();
 	prog[1].setMat4fv("model", 1, GL_FALSE, lightModel);
-	prog[1].setMat4fv("view", 1, GL_FALSE, view);
-	prog[1].setMat4fv("projection", 1, GL_FALSE, projection);
 
 	prog[1].set3fv("lightColor", 1, lightColor);
-	glBindVertexArray(VAO[1]);
+	GLState::bindVertexArray(VAO[1]);
 	glDrawArrays(GL_TRIANGLES, 0, 36);
 }
 
@@ -284,7 +291,7 @@ int main(int argc, char* args[]) {
 	}
 
 	// SHADERS
-	Shader prog[2] = { *new Shader((shaderFolderPath + "vShader1.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str()) ,
+	Shader prog[2] = { *new Shader((shaderFolderPath + "vShaderInstanced.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str()) ,
 					   *new Shader((shaderFolderPath + "vShader2.vert").c_str(), (shaderFolderPath + "fShader2.frag").c_str()) };
 
 	// vertices and normal vectors for a cube 
@@ -383,7 +390,7 @@ int main(int argc, char* args[]) {
 	glGenVertexArrays(2, VAO);
 	glGenBuffers(1, VBO);
 
-	glBindVertexArray(VAO[0]);
+	GLState::bindVertexArray(VAO[0]);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(verts_norms_tex), verts_norms_tex, GL_STATIC_DRAW);
 
@@ -399,55 +406,22 @@ int main(int argc, char* args[]) {
 	prog[0].use();
 	prog[0].setFloat("material.shininess", 25.0f);
 
-	prog[0].set3fv("pntLights[0].ambient", 1, glm::vec3{ 0.2f, 0.2f, 0.2f });
-	prog[0].set3fv("pntLights[0].diffuse", 1, glm::vec3{ 0.5f, 0.5f, 0.5f });
-	prog[0].set3fv("pntLights[0].specular", 1, glm::vec3{ 1.0f, 1.0f, 1.0f });
-	prog[0].setFloat("pntLights[0].constant", 1.0f);
-	prog[0].setFloat("pntLights[0].linear", 0.09f);
-	prog[0].setFloat("pntLights[0].specular", 0.032f);
-
-	glm::vec3 lightColor{ 1.0f, 0.0f, 0.0f };
-	prog[0].set3fv("pntLights[1].position", 1, glm::vec3{ 1.0f, 0.0f, 0.0f });
-	prog[0].set3fv("pntLights[1].ambient", 1, lightColor* glm::vec3(0.2));
-	prog[0].set3fv("pntLights[1].diffuse", 1, lightColor* glm::vec3(0.5));
-	prog[0].set3fv("pntLights[1].specular", 1, lightColor* glm::vec3(1.0));
-	prog[0].setFloat("pntLights[1].constant", 1.0f);
-	prog[0].setFloat("pntLights[1].linear", 0.09f);
-	prog[0].setFloat("pntLights[1].specular", 0.032f);
-
-	lightColor = { 0.0f, 1.0f, 0.0f };
-	prog[0].set3fv("pntLights[2].position", 1, glm::vec3{ 1.0f, 1.0f, 0.0f });
-	prog[0].set3fv("pntLights[2].ambient", 1, lightColor* glm::vec3(0.2));
-	prog[0].set3fv("pntLights[2].diffuse", 1, lightColor* glm::vec3(0.5));
-	prog[0].set3fv("pntLights[2].specular", 1, lightColor* glm::vec3(1.0));
-	prog[0].setFloat("pntLights[2].constant", 1.0f);
-	prog[0].setFloat("pntLights[2].linear", 0.09f);
-	prog[0].setFloat("pntLights[2].specular", 0.032f);
-
-	lightColor = { 0.0f, 0.0f, 1.0f };
-	prog[0].set3fv("pntLights[3].position", 1, glm::vec3{ 0.0f, 1.0f, 1.0f });
-	prog[0].set3fv("pntLights[3].ambient", 1, lightColor* glm::vec3(0.2));
-	prog[0].set3fv("pntLights[3].diffuse", 1, lightColor* glm::vec3(0.5));
-	prog[0].set3fv("pntLights[3].specular", 1, lightColor* glm::vec3(1.0));
-	prog[0].setFloat("pntLights[3].constant", 1.0f);
-	prog[0].setFloat("pntLights[3].linear", 0.09f);
-	prog[0].setFloat("pntLights[3].specular", 0.032f);
-
-	lightColor = { (210/255.0), (108/255.0), (29/255.0) };
-	prog[0].set3fv("dirLight.direction", 1, glm::vec3{ 0.0f, -1.0f, -0.2f });
-	prog[0].set3fv("dirLight.ambient", 1, lightColor* glm::vec3(0.2));
-	prog[0].set3fv("dirLight.diffuse", 1, lightColor* glm::vec3(0.5));
-	prog[0].set3fv("dirLight.specular", 1, lightColor* glm::vec3(1.0));
+	SceneUniformBuffer scene{};
+	glm::vec3 lightColor{ (210/255.0), (108/255.0), (29/255.0) };
+	scene.lights.dirLight.direction = glm::vec3{ 0.0f, -1.0f, -0.2f };
+	scene.lights.dirLight.ambient = lightColor * glm::vec3(0.2);
+	scene.lights.dirLight.diffuse = lightColor * glm::vec3(0.5);
+	scene.lights.dirLight.specular = lightColor * glm::vec3(1.0);
 
 	lightColor = { 0.5f, 0.0f, 1.0f };
-	prog[0].setFloat("spotLight.cutoff", cos(glm::radians(45.0f)));
+	scene.lights.spotLight.cutoff = cos(glm::radians(45.0f));
 
-	prog[0].set3fv("spotLight.ambient", 1, lightColor* glm::vec3(0.8));
-	prog[0].set3fv("spotLight.diffuse", 1, lightColor* glm::vec3(0.8));
-	prog[0].set3fv("spotLight.specular", 1, lightColor* glm::vec3(1.0));
-	prog[0].setFloat("spotLight.constant", 1.0f);
-	prog[0].setFloat("spotLight.linear", 0.09f);
-	prog[0].setFloat("spotLight.specular", 0.032f);
+	scene.lights.spotLight.ambient = lightColor * glm::vec3(0.8);
+	scene.lights.spotLight.diffuse = lightColor * glm::vec3(0.8);
+	scene.lights.spotLight.specular = lightColor * glm::vec3(1.0);
+	scene.lights.spotLight.constant = 1.0f;
+	scene.lights.spotLight.linear = 0.09f;
+	scene.lights.spotLight.quadratic = 0.032f;
 
 	prog[0].setInt("material.diffuse", 0);
 	prog[0].setInt("material.specular", 1);
@@ -457,15 +431,54 @@ int main(int argc, char* args[]) {
 	unsigned int diffuseMap = loadTexture(textureFolderPath + "container2.png");
 	unsigned int specularMap = loadTexture(textureFolderPath + "container2_specular.png");
 	unsigned int emissionMap = loadTexture(textureFolderPath + "matrix.jpg");
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, diffuseMap);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, specularMap);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, emissionMap);
+	GLState::bindTexture(0, diffuseMap);
+	GLState::bindTexture(1, specularMap);
+	GLState::bindTexture(2, emissionMap);
+
+	// cube field and point lights, the first light circles the cubes
+	EntityStore entities;
+	glm::vec3 cubePositions[] = {
+		glm::vec3(0.0f,  0.0f,  0.0f),
+		glm::vec3(2.0f,  5.0f, -15.0f),
+		glm::vec3(-1.5f, -2.2f, -2.5f),
+		glm::vec3(-3.8f, -2.0f, -12.3f),
+		glm::vec3(2.4f, -0.4f, -3.5f),
+		glm::vec3(-1.7f,  3.0f, -7.5f),
+		glm::vec3(1.3f, -2.0f, -2.5f),
+		glm::vec3(1.5f,  2.0f, -2.5f),
+		glm::vec3(1.5f,  0.2f, -1.5f),
+		glm::vec3(-1.3f,  1.0f, -1.5f)
+	};
+
+	AABB cubeBounds{ glm::vec3{ -0.5f }, glm::vec3{ 0.5f } };
+	for (const glm::vec3& position : cubePositions) {
+		Entity cube = entities.create();
+		entities.getTransforms().add(cube, TransformComponent{ position });
+		entities.getRenderables().add(cube, RenderableComponent{});
+		entities.getBounds().add(cube, BoundsComponent{ cubeBounds, cubeBounds });
+	}
+
+	struct { glm::vec3 position, color; } pointLights[] = {
+		{ glm::vec3{ 0.0f }, glm::vec3{ 1.0f } },
+		{ glm::vec3{ 1.0f, 0.0f, 0.0f }, glm::vec3{ 1.0f, 0.0f, 0.0f } },
+		{ glm::vec3{ 1.0f, 1.0f, 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f } },
+		{ glm::vec3{ 0.0f, 1.0f, 1.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f } }
+	};
+	Entity movingLight = ENTITY_NULL;
+	for (const auto& pointLight : pointLights) {
+		Entity light = entities.create();
+		entities.getTransforms().add(light, TransformComponent{ pointLight.position });
+		entities.getLights().add(light, LightComponent{ pointLight.color });
+		if (movingLight == ENTITY_NULL) movingLight = light;
+	}
+
+	InstancedRenderer cubes{ VAO[0], 36 };
+
+	JobSystem jobs{};
+	OcclusionCuller occlusion{ jobs };
 
 	// light cube
-	glBindVertexArray(VAO[1]);
+	GLState::bindVertexArray(VAO[1]);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices_norms), vertices_norms, GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
@@ -502,7 +515,7 @@ int main(int argc, char* args[]) {
 		updateCamera(cam, deltaTime, keyDown, *new floatPair{ deltaX, deltaY });
 
 		// RENDER
-		render(VAO, prog, cam);
+		render(VAO, prog, cubes, entities, movingLight, verts_norms_tex, jobs, occlusion, scene, cam);
 
 		SDL_GL_SwapWindow(window);
 	}
@@ -5,18 +5,46 @@
 #include <glm/gtc/type_ptr.hpp>
 #include "stb_image.h"
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <unordered_map>
 
 #include "Model.h"
+#include "GeometryHeap.h"
+#include "SceneGraph.h"
+#include "BVH.h"
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include "TextureStreamer.h"
+#include "TextureCache.h"
+#include "RenderQueue.h"
 #include "Shader.h"
 #include "Camera.h"
+#include "GLState.h"
+#include "UniformBuffers.h"
+#include "Span.h"
 
 using keyMap = std::unordered_map<SDL_KeyCode, bool>;
 using floatPair = std::pair<float, float>;
 
+// meshes above this are too costly to rasterize as occluders, they are still tested as occludees
+const unsigned int maxOccluderTriangles = 4096;
+// how many pixels a mesh level may be off by before a finer one is drawn
+const float maxLodPixelError = 1.0f;
+
+// one placed mesh, numbered by its index in the scene BVH
+struct MeshInstance {
+	Mesh* mesh;
+	// scene graph node the mesh hangs off, model is that node's world matrix
+	unsigned int node;
+	glm::mat4 model;
+	// level drawn last frame, for the queue's hysteresis
+	unsigned int lod;
+};
+
 void showErrorBox(const char* title, const char* msg = NULL) {
 	if (msg == NULL) {
 		SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, title, title, NULL);
@@ -26,7 +54,7 @@ void showErrorBox(const char* title, const char* msg = NULL) {
 	}
 }
 
-void processEvents(bool& running, SDL_Event* event, keyMap& keyDown, floatPair& currMousePos) {
+void processEvents(bool& running, SDL_Event* event, keyMap& keyDown, floatPair& currMousePos, bool& pick) {
 	while (SDL_PollEvent(event) != 0) {
 		switch (event->type) {
 		case SDL_QUIT:
@@ -38,12 +66,10 @@ void processEvents(bool& running, SDL_Event* event, keyMap& keyDown, floatPair&
 				running = false;
 				break;
 			case SDLK_DOWN:
-				GLint data[2];
-				glGetIntegerv(GL_POLYGON_MODE, data);
-				if (data[1] == GL_LINE)
-					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+				if (GLState::getPolygonMode() == GL_LINE)
+					GLState::setPolygonMode(GL_FILL);
 				else
-					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+					GLState::setPolygonMode(GL_LINE);
 				break;
 			case SDLK_w:
 				keyDown[SDLK_w] = true;
@@ -91,6 +117,9 @@ void processEvents(bool& running, SDL_Event* event, keyMap& keyDown, floatPair&
 				break;
 			}
 			break;
+		case SDL_MOUSEBUTTONDOWN:
+			pick = true;
+			break;
 		case SDL_MOUSEMOTION:
 			currMousePos.first = event->motion.xrel;
 			currMousePos.second = event->motion.yrel;
@@ -141,7 +170,29 @@ void updateCamera(Camera& cam, float deltaTime, keyMap& keyDown, floatPair& delt
 	cam.updateFront(deltaMove.first * cam.getSensitivity(), deltaMove.second * cam.getSensitivity());
 }
 
-void render(std::vector<Model> models, Shader* prog, Camera& cam) {
+void render(Span<MeshInstance> instances, BVH& sceneIndex, unsigned int sceneTriangles, OcclusionCuller& occlusion,
+	Shader* prog, RenderQueue& queue, SceneUniformBuffer& scene, Camera& cam) {
+	scene.frame.view = cam.getView();
+	scene.frame.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+
+	// the BVH tests every instance against the frustum
+	static std::vector<unsigned int> visible;
+	visible.clear();
+	Frustum frustum = cam.getFrustum(scene.frame.projection);
+	sceneIndex.queryFrustum(frustum, visible);
+
+	// what is left goes through occlusion culling as a job while this thread sets up the frame
+	occlusion.begin(scene.frame.projection * scene.frame.view);
+	for (unsigned int i : visible) {
+		Mesh& mesh = *instances[i].mesh;
+		if (mesh.getTriangleCount() <= maxOccluderTriangles) {
+			occlusion.addOccluder(&mesh.getVertexData()->Position.x, sizeof(Vertex), mesh.getVertexCount(),
+				mesh.getIndexData(), mesh.getIndexCount(), instances[i].model);
+		}
+		occlusion.addOccludee(sceneIndex.getPrimBounds(i));
+	}
+	occlusion.cullAsync();
+
 	glClearColor(185.0 / 255, 203.0 / 255, 153.0 / 255, 0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -153,35 +204,41 @@ void render(std::vector<Model> models, Shader* prog, Camera& cam) {
 	glm::vec3 lightColor{ abs(sin(SDL_GetTicks() / 1000.0)), abs(cos(SDL_GetTicks() / 1000.0)), abs(cos(SDL_GetTicks() / 1000.0) * sin(SDL_GetTicks() / 1000.0)) };
 	//lightColor = glm::vec3{ 1.0f,1.0f,1.0f };
 
-	// set uniforms
-	prog[0].use();
-
-	prog[0].set3fv("pntLights[0].position", 1, lightPos);
-	prog[0].set3fv("pntLights[0].ambient", 1, lightColor * glm::vec3(0.2));
-	prog[0].set3fv("pntLights[0].diffuse", 1, lightColor * glm::vec3(0.5));
-	prog[0].set3fv("pntLights[0].specular", 1, lightColor * glm::vec3(1.0));
-
-	prog[0].set3fv("spotLight.position", 1, cam.getPos());
-	prog[0].set3fv("spotLight.direction", 1, cam.getFront() - cam.getPos());
-
-	prog[0].set3fv("viewPos", 1, cam.getPos());
-
-	// transform matrices
-	glm::mat4 model{ 1.0f };
-	model = glm::scale(model, glm::vec3{ 0.3f });
-	glm::mat4 view{ cam.getView() };
-	glm::mat4 projection{ glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f) };
-
-	prog[0].setMat4fv("model", 1, false, model);
-	prog[0].setMat4fv("view", 1, false, view);
-	prog[0].setMat4fv("projection", 1, false, projection);
-
-	for (int i = 0; i < models.size(); i++) {
-		models[i].Draw(prog[0]);
+	// per-frame uniforms shared by every program
+	scene.lights.pntLights[0].position = lightPos;
+	scene.lights.pntLights[0].ambient = lightColor * glm::vec3(0.2);
+	scene.lights.pntLights[0].diffuse = lightColor * glm::vec3(0.5);
+	scene.lights.pntLights[0].specular = lightColor * glm::vec3(1.0);
+
+	scene.lights.spotLight.position = cam.getPos();
+	scene.lights.spotLight.direction = cam.getFront() - cam.getPos();
+
+	scene.frame.viewPos = cam.getPos();
+	scene.frame.time = SDL_GetTicks() / 1000.0f;
+
+	scene.upload();
+
+	occlusion.wait();
+	// the BVH already culled whole meshes, the queue's frustum is for their meshlets
+	queue.begin(scene.frame.view, 100.0f, frustum);
+	queue.setMeshletCulling(true);
+	queue.setLodSelection(scene.frame.projection[1][1], 600.0f, maxLodPixelError);
+	unsigned int drawn = 0, drawnTriangles = 0;
+	for (unsigned int j = 0; j < visible.size(); j++) {
+		if (!occlusion.isVisible(j)) continue;
+		unsigned int i = visible[j];
+		queue.submit(prog[0], *instances[i].mesh, queue.addTransform(instances[i].model), &instances[i].lod);
+		drawn++;
+		drawnTriangles += instances[i].mesh->getTriangleCount();
 	}
+	// full detail counts, the queue's drawn triangles are after LOD selection
+	queue.addCulled((unsigned int) instances.size() - drawn, sceneTriangles - drawnTriangles);
+	queue.execute();
 }
 
 int main(int argc, char* args[]) {
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
 	// INITIALIZE SDL AND OPENGL
 	std::cout << "Initializing SDL.\n";
 
@@ -232,74 +289,186 @@ int main(int argc, char* args[]) {
 		return -1;
 	}
 
-	// SHADERS
-	Shader prog[1] = { *new Shader((shaderFolderPath + "vShader1.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str()) };
-
-	stbi_set_flip_vertically_on_load(true);
-	Model backpack(textureFolderPath + "backpack\\backpack.obj");
-
-	// LIGHTS
-	prog[0].use();
-	prog[0].setFloat("material.shininess", 25.0f);
-	prog[0].setFloat("pntLights[0].constant", 1.0f);
-	prog[0].setFloat("pntLights[0].linear", 0.09f);
-	prog[0].setFloat("pntLights[0].specular", 0.032f);
-
-	glm::vec3 lightColor = { (210 / 255.0), (108 / 255.0), (29 / 255.0) };
-	prog[0].set3fv("dirLight.direction", 1, glm::vec3{ 0.0f, -1.0f, -0.2f });
-	prog[0].set3fv("dirLight.ambient", 1, lightColor * glm::vec3(0.2));
-	prog[0].set3fv("dirLight.diffuse", 1, lightColor * glm::vec3(0.5));
-	prog[0].set3fv("dirLight.specular", 1, lightColor * glm::vec3(1.0));
-
-	lightColor = { 0.0f, 0.0f, 0.0f };
-	prog[0].setFloat("spotLight.cutoff", cos(glm::radians(45.0f)));
-
-	prog[0].set3fv("spotLight.ambient", 1, lightColor * glm::vec3(0.8));
-	prog[0].set3fv("spotLight.diffuse", 1, lightColor * glm::vec3(0.8));
-	prog[0].set3fv("spotLight.specular", 1, lightColor * glm::vec3(1.0));
-	prog[0].setFloat("spotLight.constant", 1.0f);
-	prog[0].setFloat("spotLight.linear", 0.09f);
-	prog[0].setFloat("spotLight.specular", 0.032f);
-
-	// EVENT-RENDER LOOP
-	Camera cam{};
-
-	keyMap keyDown{};
-	floatPair lastMousePos{};
-	floatPair currMousePos{};
-
-	float lastFrame;
-	float currFrame = SDL_GetTicks();
-	float deltaTime = 1;
-
-	glEnable(GL_DEPTH_TEST);
-	SDL_SetRelativeMouseMode(SDL_TRUE);
-	while (running) {
-		lastFrame = currFrame;
-		currFrame = SDL_GetTicks();
-		deltaTime = (currFrame - lastFrame) / 1000;
-
-		// FRAME COUNT
-		SDL_SetWindowTitle(window, ("SDL/OpenGL | msPF: " + std::to_string((int) (currFrame - lastFrame))).c_str());
-
-		// EVENTS
-		lastMousePos.first = currMousePos.first;
-		lastMousePos.second = currMousePos.second;
-		processEvents(running, &event, keyDown, currMousePos);
-
-		// update camera
-		float deltaX = (currMousePos.first == lastMousePos.first) ? 0.0f : currMousePos.first;
-		float deltaY = (currMousePos.second == lastMousePos.second) ? 0.0f : -currMousePos.second; // flipped since y coords rise from bottom to top
-		updateCamera(cam, deltaTime, keyDown, *new floatPair{ deltaX, deltaY });
-
-		// RENDER
-		render(std::vector<Model>{ backpack }, prog, cam);
-
-		SDL_GL_SwapWindow(window);
+	// everything below owns GL objects, the scope makes sure they are all gone before the context
+	{
+		// SHADERS
+		// the batched vertex shader reads model matrices by draw index, so the queue can merge draws
+		Shader prog[1] = { Shader{ (shaderFolderPath + "vShaderBatched.vert").c_str(), (shaderFolderPath + "fShader1.frag").c_str() } };
+
+		JobSystem jobs{};
+		TextureStreamer textures{ jobs };
+
+		stbi_set_flip_vertically_on_load(true);
+		// kept resident, the occlusion culler rasterizes the CPU positions every frame
+		std::vector<Model> models;
+		models.emplace_back(textureFolderPath + "backpack\\backpack.obj", &jobs, &textures, VERTEX_UNORM16, true);
+
+		// every model's node hierarchy hangs off one root, meshes are placed by their node
+		SceneGraph sceneGraph{};
+		unsigned int sceneRoot = sceneGraph.addNode(glm::scale(glm::mat4{ 1.0f }, glm::vec3{ 0.3f }));
+		std::vector<MeshInstance> instances;
+		unsigned int sceneTriangles = 0;
+		for (size_t i = 0; i < models.size(); i++) {
+			unsigned int firstNode = sceneGraph.addModel(models[i], (int) sceneRoot);
+			const std::vector<ModelNode>& nodes = models[i].getNodes();
+			for (unsigned int n = 0; n < nodes.size(); n++) {
+				for (unsigned int m : nodes[n].meshes) {
+					Mesh& mesh = models[i].getMeshes()[m];
+					instances.push_back(MeshInstance{ &mesh, firstNode + n, glm::mat4{ 1.0f }, 0 });
+					sceneTriangles += mesh.getTriangleCount();
+				}
+			}
+		}
+		sceneGraph.update();
+
+		// index the world space bounds
+		std::vector<AABB> instanceBounds;
+		for (MeshInstance& instance : instances) {
+			instance.model = sceneGraph.getWorld(instance.node);
+			instanceBounds.push_back(instance.mesh->getBounds().transform(instance.model));
+		}
+		BVH sceneIndex{};
+		sceneIndex.build(instanceBounds);
+
+		OcclusionCuller occlusion{ jobs };
+
+		// MATERIALS
+		prog[0].use();
+		prog[0].setFloat("material.shininess", 25.0f);
+
+		// LIGHTS
+		SceneUniformBuffer scene{};
+		scene.lights.numPointLights = 1;
+		scene.lights.pntLights[0].constant = 1.0f;
+		scene.lights.pntLights[0].linear = 0.09f;
+		scene.lights.pntLights[0].quadratic = 0.032f;
+
+		glm::vec3 lightColor = { (210 / 255.0), (108 / 255.0), (29 / 255.0) };
+		scene.lights.dirLight.direction = glm::vec3{ 0.0f, -1.0f, -0.2f };
+		scene.lights.dirLight.ambient = lightColor * glm::vec3(0.2);
+		scene.lights.dirLight.diffuse = lightColor * glm::vec3(0.5);
+		scene.lights.dirLight.specular = lightColor * glm::vec3(1.0);
+
+		lightColor = { 0.0f, 0.0f, 0.0f };
+		scene.lights.spotLight.cutoff = cos(glm::radians(45.0f));
+
+		scene.lights.spotLight.ambient = lightColor * glm::vec3(0.8);
+		scene.lights.spotLight.diffuse = lightColor * glm::vec3(0.8);
+		scene.lights.spotLight.specular = lightColor * glm::vec3(1.0);
+		scene.lights.spotLight.constant = 1.0f;
+		scene.lights.spotLight.linear = 0.09f;
+		scene.lights.spotLight.quadratic = 0.032f;
+
+		// EVENT-RENDER LOOP
+		Camera cam{};
+		RenderQueue queue{};
+
+		keyMap keyDown{};
+		floatPair lastMousePos{};
+		floatPair currMousePos{};
+		bool pick = false;
+
+		float lastFrame;
+		float currFrame = SDL_GetTicks();
+		float deltaTime = 1;
+
+		// how long until something is on screen, and how bad frames get while textures stream in
+		bool streaming = true;
+		double firstFrameMs = 0.0;
+		double worstLoadingFrameMs = 0.0;
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+		glEnable(GL_DEPTH_TEST);
+		// meshlet cone culling drops clusters facing away, so back faces must not be visible anyway
+		glEnable(GL_CULL_FACE);
+		SDL_SetRelativeMouseMode(SDL_TRUE);
+		while (running) {
+			lastFrame = currFrame;
+			currFrame = SDL_GetTicks();
+			deltaTime = (currFrame - lastFrame) / 1000;
+
+			// FRAME COUNT
+			SDL_SetWindowTitle(window, ("SDL/OpenGL | msPF: " + std::to_string((int) (currFrame - lastFrame))
+				+ " | uniform lookups: " + std::to_string(Shader::nameLookups)
+				+ " | meshes drawn: " + std::to_string(queue.getStats().draws)
+				+ "/" + std::to_string(queue.getStats().draws + queue.getStats().culledMeshes)
+				+ " | tris drawn: " + std::to_string(queue.getStats().drawnTriangles)
+				+ " culled: " + std::to_string(queue.getStats().culledTriangles)
+				+ " (+" + std::to_string(queue.getStats().culledMeshletTriangles) + " in meshlets)"
+				+ " | draw calls: " + std::to_string(queue.getStats().drawCalls)
+				+ " | occluded: " + std::to_string(occlusion.getStats().occluded)
+				+ " (" + std::to_string(occlusion.getStats().rasterizedTriangles) + " occluder tris)"
+				+ " | state changes: " + std::to_string(queue.getStats().unsortedStateChanges)
+				+ " -> " + std::to_string(queue.getStats().sortedStateChanges)
+				+ " | textures: " + std::to_string(TextureCache::stats.live)
+				+ " (" + std::to_string(TextureCache::stats.pathHits + TextureCache::stats.contentHits) + " shared)"
+				+ " | GL calls filtered: " + std::to_string(GLState::stats.filtered + GLState::stats.uniformsFiltered)
+				+ "/" + std::to_string(GLState::stats.issued + GLState::stats.filtered + GLState::stats.uniformsIssued + GLState::stats.uniformsFiltered)).c_str());
+			Shader::resetFrameStats();
+			GLState::resetFrameStats();
+
+			// EVENTS
+			lastMousePos.first = currMousePos.first;
+			lastMousePos.second = currMousePos.second;
+			processEvents(running, &event, keyDown, currMousePos, pick);
+
+			// clicking picks whatever is under the crosshair
+			if (pick) {
+				RayHit hit;
+				if (sceneIndex.raycast(Ray{ cam.getPos(), cam.getFront() }, 100.0f, hit)) {
+					std::cout << "Picked mesh " << hit.prim << " at distance " << hit.distance << std::endl;
+				}
+				pick = false;
+			}
+
+			// update camera
+			float deltaX = (currMousePos.first == lastMousePos.first) ? 0.0f : currMousePos.first;
+			float deltaY = (currMousePos.second == lastMousePos.second) ? 0.0f : -currMousePos.second; // flipped since y coords rise from bottom to top
+			floatPair deltaMove{ deltaX, deltaY };
+			updateCamera(cam, deltaTime, keyDown, deltaMove);
+
+			// anything that moved drags its subtree along, and the BVH follows
+			if (sceneGraph.update() > 0) {
+				jobs.parallelFor((unsigned int) instances.size(), [&](unsigned int i) {
+					instances[i].model = sceneGraph.getWorld(instances[i].node);
+					instanceBounds[i] = instances[i].mesh->getBounds().transform(instances[i].model);
+				}, 64);
+				for (unsigned int i = 0; i < instances.size(); i++) {
+					sceneIndex.update(i, instanceBounds[i]);
+				}
+				sceneIndex.refit();
+			}
+
+			// RENDER
+			// pinned GL work from the jobs, decoded textures among it
+			jobs.runMainJobs();
+			textures.update();
+			render(instances, sceneIndex, sceneTriangles, occlusion, prog, queue, scene, cam);
+
+			SDL_GL_SwapWindow(window);
+
+			std::chrono::steady_clock::time_point frameEnd = std::chrono::steady_clock::now();
+			if (firstFrameMs == 0.0) {
+				firstFrameMs = std::chrono::duration<double, std::milli>(frameEnd - startTime).count();
+			}
+			else if (streaming) {
+				worstLoadingFrameMs = std::max(worstLoadingFrameMs, std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+			}
+			if (streaming && textures.isIdle()) {
+				std::cout << "First frame after " << firstFrameMs << " ms, textures resident after "
+					<< std::chrono::duration<double, std::milli>(frameEnd - startTime).count() << " ms, worst frame while loading "
+					<< worstLoadingFrameMs << " ms" << std::endl;
+				streaming = false;
+			}
+			frameStart = frameEnd;
+		}
 	}
 
 	// COLLECT GARBAGE
 	std::cout << "Quitting SDL.\n";
+	// the static caches hold GL objects of their own
+	GeometryHeap::clear();
+	TextureCache::clear();
 	SDL_GL_DeleteContext(context);
 	SDL_DestroyWindow(window);
 	window = nullptr;
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file, unmapped when destroyed.
+class MappedFile {
+private:
+	const unsigned char* bytes;
+	size_t length;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fd;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* data() const;
+	size_t size() const;
+	bool isOpen() const;
+};
+
+// size and modification time, what cooked files record to notice their source changed
+bool getFileStamp(const std::string& path, uint64_t& size, int64_t& time);
\ No newline at end of file
@@ -1,54 +1,91 @@
 #include <glm/glm.hpp>
 #include <glad.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
 #include <string>
 #include <vector>
 
 #include "Mesh.h"
 #include "Shader.h"
+#include "GLState.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) 
-	: vertices(vertices), indices(indices), textures(textures)
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, VertexFormat format,
+	std::vector<MeshLod> lods, std::vector<Meshlet> meshlets)
+	: externalVertices(nullptr), externalIndices(nullptr),
+	vertexCount((unsigned int) vertices.size()), indexCount((unsigned int) indices.size()),
+	totalIndexCount((unsigned int) indices.size()), lods(std::move(lods)), meshlets(std::move(meshlets)),
+	meshletBounds(this->meshlets), vertexFormat(format), formatProgram(0), samplerProgram(0),
+	vertices(std::move(vertices)), indices(std::move(indices)), textures(textures)
 {
+	if (this->lods.empty()) {
+		this->lods.push_back(MeshLod{ 0, totalIndexCount, 0.0f });
+	}
+	indexCount = this->lods[0].indexCount;
+
+	// quantized positions are relative to the bounds, so they come first
+	computeBounds();
 	setupMesh();
+	setupSamplers();
+	setupMaterial();
 }
 
-void Mesh::setupMesh() {
-	// buffer data
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-	glGenBuffers(1, &EBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+Mesh::Mesh(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount,
+	std::vector<Texture> textures, const AABB& bounds, const BoundingSphere& sphere, VertexFormat format, std::vector<MeshLod> lods,
+	std::vector<Meshlet> meshlets)
+	: externalVertices(vertices), externalIndices(indices), vertexCount(vertexCount), indexCount(indexCount),
+	totalIndexCount(indexCount), lods(std::move(lods)), meshlets(std::move(meshlets)), meshletBounds(this->meshlets), vertexFormat(format), formatProgram(0), samplerProgram(0),
+	bounds(bounds), sphere(sphere), textures(textures)
+{
+	if (this->lods.empty()) {
+		this->lods.push_back(MeshLod{ 0, totalIndexCount, 0.0f });
+	}
+	this->indexCount = this->lods[0].indexCount;
 
-	// setup vertex attribute pointers
-	// vertex positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, Position));
+	setupMesh();
+	setupSamplers();
+	setupMaterial();
+}
 
-	// vertex normals
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, Normal));
+void Mesh::setupMaterial() {
+	// dense material ids so they fit in a few bits of a sort key
+	static std::map<std::vector<unsigned int>, unsigned int> materialIDs;
+	std::vector<unsigned int> textureIDs;
+	for (unsigned int i = 0; i < textures.size(); i++) {
+		textureIDs.push_back(textures[i].id);
+	}
+	auto it = materialIDs.find(textureIDs);
+	if (it == materialIDs.end()) {
+		it = materialIDs.emplace(textureIDs, (unsigned int) materialIDs.size()).first;
+	}
+	materialID = it->second;
+}
 
-	// vertex texture coordinates
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, TexCoords));
+void Mesh::computeBounds() {
+	glm::vec3 minPos{ vertices.empty() ? glm::vec3{ 0.0f } : vertices[0].Position };
+	glm::vec3 maxPos{ minPos };
+	for (unsigned int i = 0; i < vertices.size(); i++) {
+		minPos = glm::min(minPos, vertices[i].Position);
+		maxPos = glm::max(maxPos, vertices[i].Position);
+	}
+	bounds = AABB{ minPos, maxPos };
 
-	glBindVertexArray(0);
+	// centered on the box but sized by the farthest vertex, tighter than the box's half diagonal
+	sphere.center = bounds.getCenter();
+	float radiusSq = 0.0f;
+	for (unsigned int i = 0; i < vertices.size(); i++) {
+		glm::vec3 offset{ vertices[i].Position - sphere.center };
+		radiusSq = std::max(radiusSq, glm::dot(offset, offset));
+	}
+	sphere.radius = std::sqrt(radiusSq);
 }
 
-void Mesh::Draw(Shader& shader) {
-	// assign textures
+void Mesh::setupSamplers() {
 	unsigned int diffuseNum = 1;
 	unsigned int specularNum = 1;
 
 	for (unsigned int i = 0; i < textures.size(); i++) {
-		glActiveTexture(GL_TEXTURE0 + i);
-		
 		std::string name = textures[i].type;
 		std::string num;
 		if (name == "texture_diffuse") {
@@ -58,16 +95,137 @@ void Mesh::Draw(Shader& shader) {
 			num = std::to_string(specularNum++);
 		}
 
-		shader.setInt("material." + name + num, i);
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		samplerNames.push_back("material." + name + num);
+	}
+}
+
+void Mesh::setupMesh() {
+	// buffer data
+	const void* vertexData = getVertexData();
+	std::vector<unsigned char> packed;
+	if (vertexFormat != VERTEX_FLOAT) {
+		dequantize = packVertices(vertexFormat, getVertexData(), vertexCount, bounds, packed);
+		vertexData = packed.data();
+	}
+
+	// indices are relative to the base vertex, so 16 bits are enough wherever the heap puts the mesh
+	const void* indexData = getIndexData();
+	std::vector<unsigned short> shortIndices;
+	if (vertexCount <= 65536) {
+		indexType = GL_UNSIGNED_SHORT;
+		shortIndices.assign(getIndexData(), getIndexData() + totalIndexCount);
+		indexData = shortIndices.data();
+	}
+	else {
+		indexType = GL_UNSIGNED_INT;
 	}
-	glActiveTexture(GL_TEXTURE0);
+
+	geometry = GeometryHeap::allocate(vertexFormat, vertexData, vertexCount, indexData, (size_t) totalIndexCount * getIndexSize());
+}
+
+void Mesh::Draw(Shader& shader) {
+	bindTextures(shader);
 
 	// draw mesh
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+	bindVertexFormat(shader);
+	GLState::bindVertexArray(getVAO());
+	drawElements();
+}
+
+void Mesh::bindTextures(Shader& shader) {
+	// resolve sampler handles the first time this program draws the mesh
+	if (samplerProgram != shader.getID()) {
+		samplerHandles.clear();
+		for (unsigned int i = 0; i < samplerNames.size(); i++) {
+			samplerHandles.push_back(shader.getUniform(samplerNames[i]));
+		}
+		samplerProgram = shader.getID();
+	}
+
+	// assign textures
+	for (unsigned int i = 0; i < textures.size(); i++) {
+		shader.setInt(samplerHandles[i], i);
+		GLState::bindTexture(i, textures[i].id);
+	}
+}
+
+void Mesh::bindVertexFormat(Shader& shader) {
+	if (formatProgram != shader.getID()) {
+		positionScaleHandle = shader.getUniform("positionScale");
+		positionOffsetHandle = shader.getUniform("positionOffset");
+		octahedralNormalsHandle = shader.getUniform("octahedralNormals");
+		formatProgram = shader.getID();
+	}
+
+	// float meshes set the identity too, the previous mesh may have been quantized
+	shader.set3fv(positionScaleHandle, 1, dequantize.positionScale);
+	shader.set3fv(positionOffsetHandle, 1, dequantize.positionOffset);
+	shader.setBool(octahedralNormalsHandle, dequantize.octahedralNormals);
+}
+
+void Mesh::drawElements(unsigned int lod) {
+	GeometryRange range = GeometryHeap::getRange(geometry.get());
+	const MeshLod& level = lods[lod];
+	glDrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, indexType,
+		(void*) (range.indexOffset + (size_t) level.firstIndex * getIndexSize()), range.baseVertex);
+}
+
+void Mesh::drawElements(const MeshletRange* ranges, unsigned int rangeCount) {
+	// GL thread only, so the argument arrays can be reused across calls
+	static std::vector<GLsizei> counts;
+	static std::vector<const void*> offsets;
+	static std::vector<GLint> baseVertices;
+	GeometryRange range = GeometryHeap::getRange(geometry.get());
+	counts.clear();
+	offsets.clear();
+	for (unsigned int i = 0; i < rangeCount; i++) {
+		counts.push_back((GLsizei) ranges[i].indexCount);
+		offsets.push_back((const void*) (range.indexOffset + (size_t) ranges[i].firstIndex * getIndexSize()));
+	}
+	baseVertices.assign(rangeCount, range.baseVertex);
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), indexType, offsets.data(), (GLsizei) rangeCount, baseVertices.data());
+}
+
+unsigned int Mesh::selectLod(float errorScale, float maxError, float hysteresis, unsigned int previous) const {
+	unsigned int lod = std::min(previous, (unsigned int) lods.size() - 1);
+	while (lod > 0 && lods[lod].error * errorScale > maxError * (1.0f + hysteresis)) {
+		lod--;
+	}
+	while (lod + 1 < lods.size() && lods[lod + 1].error * errorScale <= maxError * (1.0f - hysteresis)) {
+		lod++;
+	}
+	return lod;
+}
+
+void Mesh::releaseCPUData() {
+	std::vector<Vertex>().swap(vertices);
+	std::vector<unsigned int>().swap(indices);
+	externalVertices = nullptr;
+	externalIndices = nullptr;
+}
+
+size_t Mesh::getCPUBytes() const {
+	return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int);
+}
+
+unsigned int Mesh::getVAO() const { return GeometryHeap::getRange(geometry.get()).vertexArray; }
+GeometryRange Mesh::getGeometryRange() const { return GeometryHeap::getRange(geometry.get()); }
+unsigned int Mesh::getMaterialID() const { return materialID; }
+glm::vec3 Mesh::getCenter() const { return bounds.getCenter(); }
+const AABB& Mesh::getBounds() const { return bounds; }
+const BoundingSphere& Mesh::getSphere() const { return sphere; }
+unsigned int Mesh::getTriangleCount() const { return indexCount / 3; }
 
-	// reset
-	glBindVertexArray(0);
-	glActiveTexture(GL_TEXTURE0);
-}
\ No newline at end of file
+const Vertex* Mesh::getVertexData() const { return vertices.empty() ? externalVertices : vertices.data(); }
+unsigned int Mesh::getVertexCount() const { return vertexCount; }
+const unsigned int* Mesh::getIndexData() const { return indices.empty() ? externalIndices : indices.data(); }
+unsigned int Mesh::getIndexCount() const { return indexCount; }
+unsigned int Mesh::getTotalIndexCount() const { return totalIndexCount; }
+unsigned int Mesh::getLodCount() const { return (unsigned int) lods.size(); }
+const MeshLod& Mesh::getLod(unsigned int lod) const { return lods[lod]; }
+const std::vector<Meshlet>& Mesh::getMeshlets() const { return meshlets; }
+const MeshletBounds& Mesh::getMeshletBounds() const { return meshletBounds; }
+VertexFormat Mesh::getVertexFormat() const { return vertexFormat; }
+const VertexDequantize& Mesh::getDequantize() const { return dequantize; }
+unsigned int Mesh::getIndexSize() const { return (indexType == GL_UNSIGNED_SHORT) ? sizeof(unsigned short) : sizeof(unsigned int); }
+unsigned int Mesh::getIndexType() const { return indexType; }
\ No newline at end of file
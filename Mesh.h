@@ -5,6 +5,10 @@
 #include <vector>
 
 #include "Shader.h"
+#include "Bounds.h"
+#include "VertexFormat.h"
+#include "GeometryHeap.h"
+#include "Meshlet.h"
 
 struct Vertex {
 	glm::vec3 Position;
@@ -12,24 +16,127 @@ struct Vertex {
 	glm::vec2 TexCoords;
 };
 
+// a level of detail, a run of the mesh's indices over the same vertices
+struct MeshLod {
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	// how far the surface may be from the full mesh, in object space units
+	float error;
+};
+
 struct Texture {
 	unsigned int id;
 	std::string type;
 	std::string path;
 };
 
+// Owns its range of the geometry heap, so it can be moved but not copied.
 class Mesh {
 private:
-	unsigned int VBO, EBO;
+	GeometryAllocation geometry;
+
+	// cooked meshes leave vertices and indices empty and point into the mapped file instead
+	const Vertex* externalVertices;
+	const unsigned int* externalIndices;
+	unsigned int vertexCount, indexCount;
+	// indexCount is the full mesh, the coarser levels follow it in the same buffer
+	unsigned int totalIndexCount;
+	std::vector<MeshLod> lods;
+	// clusters of the full level, in index order, and their bounds laid out for culling
+	std::vector<Meshlet> meshlets;
+	MeshletBounds meshletBounds;
+	// GL_UNSIGNED_SHORT whenever every vertex is reachable with 16 bits, the CPU copy stays 32 bit
+	unsigned int indexType;
+	// the layout in the VBO and what the vertex shader needs to unpack it
+	VertexFormat vertexFormat;
+	VertexDequantize dequantize;
+	UniformHandle positionScaleHandle, positionOffsetHandle, octahedralNormalsHandle;
+	unsigned int formatProgram;
+
+	// sampler uniform names are built once, their handles are resolved per program
+	std::vector<std::string> samplerNames;
+	std::vector<UniformHandle> samplerHandles;
+	unsigned int samplerProgram;
+
+	unsigned int materialID;
+	AABB bounds;
+	BoundingSphere sphere;
 
 	void setupMesh();
+	void setupSamplers();
+	void setupMaterial();
+	void computeBounds();
 
 public:
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
-	unsigned int VAO;
 
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+		VertexFormat format = VERTEX_FLOAT, std::vector<MeshLod> lods = {}, std::vector<Meshlet> meshlets = {});
+	// uploads straight from memory the caller keeps alive, bounds come precomputed
+	Mesh(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount,
+		std::vector<Texture> textures, const AABB& bounds, const BoundingSphere& sphere, VertexFormat format = VERTEX_FLOAT,
+		std::vector<MeshLod> lods = {}, std::vector<Meshlet> meshlets = {});
+
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) noexcept = default;
+	Mesh& operator=(Mesh&&) noexcept = default;
+
 	void Draw(Shader &shader);
+
+	// Draw() split into its state and draw halves for the render queue,
+	// drawElements() expects getVAO() to be bound already
+	void bindTextures(Shader& shader);
+	// the dequantization uniforms, needed whenever the bound VAO changes to this mesh's
+	void bindVertexFormat(Shader& shader);
+	void drawElements(unsigned int lod = 0);
+	// parts of the full level, as left by meshlet culling, in one call
+	void drawElements(const MeshletRange* ranges, unsigned int rangeCount);
+
+	// shared by every mesh in the same heap page
+	unsigned int getVAO() const;
+	// where drawElements() finds the mesh in that VAO's buffers
+	GeometryRange getGeometryRange() const;
+	// meshes with the same texture set share a material id
+	unsigned int getMaterialID() const;
+	glm::vec3 getCenter() const;
+
+	// object space bounds, computed once at import
+	const AABB& getBounds() const;
+	const BoundingSphere& getSphere() const;
+	unsigned int getTriangleCount() const;
+
+	// level 0 is the full mesh, meshes imported without levels only have that one
+	unsigned int getLodCount() const;
+	const MeshLod& getLod(unsigned int lod) const;
+	// the coarsest level whose error, times errorScale, stays under maxError. Levels only change
+	// once the error is past maxError by the hysteresis fraction, so a mesh sitting at a
+	// threshold does not flicker between two of them
+	unsigned int selectLod(float errorScale, float maxError, float hysteresis, unsigned int previous) const;
+
+	// meshes imported without meshlets have none and are only culled whole
+	const std::vector<Meshlet>& getMeshlets() const;
+	const MeshletBounds& getMeshletBounds() const;
+
+	// drops the CPU copy once nothing but the GPU needs it, the data getters return NULL
+	// afterwards. Counts, bounds and the heap range stay
+	void releaseCPUData();
+	// bytes of CPU geometry this mesh owns, cooked data belongs to the model's mapping
+	size_t getCPUBytes() const;
+
+	// CPU side geometry, wherever it lives
+	const Vertex* getVertexData() const;
+	unsigned int getVertexCount() const;
+	const unsigned int* getIndexData() const;
+	// the full mesh's indices, getIndexData() holds every level's
+	unsigned int getIndexCount() const;
+	unsigned int getTotalIndexCount() const;
+	// bytes per index in the element buffer, 2 or 4
+	unsigned int getIndexSize() const;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	unsigned int getIndexType() const;
+	VertexFormat getVertexFormat() const;
+	const VertexDequantize& getDequantize() const;
 };
\ No newline at end of file
@@ -0,0 +1,348 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "MeshOptimizer.h"
+
+// FIFO cache simulation by timestamp: a vertex is cached while fewer than cacheSize misses
+// have happened since its own. Starting the clock past cacheSize makes everything a miss
+namespace {
+	struct CacheClock {
+		std::vector<unsigned int> stamps;
+		unsigned int time;
+		unsigned int size;
+
+		CacheClock(size_t vertexCount, unsigned int cacheSize)
+			: stamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+		// true on a miss
+		bool touch(unsigned int vertex) {
+			if (time - stamps[vertex] <= size) {
+				return false;
+			}
+			stamps[vertex] = time++;
+			return true;
+		}
+		// the next triangle sees an empty cache
+		void flush() {
+			time += size + 1;
+		}
+	};
+}
+
+namespace {
+	const int VERTEX_FLOATS = sizeof(Vertex) / sizeof(float);
+	static_assert(sizeof(Vertex) == VERTEX_FLOATS * sizeof(float), "welding assumes a vertex of plain floats");
+
+	// what two vertices have to share to be welded, their bit patterns or their grid cells
+	struct WeldKey {
+		uint32_t words[VERTEX_FLOATS];
+
+		bool operator==(const WeldKey& other) const {
+			return std::memcmp(words, other.words, sizeof(words)) == 0;
+		}
+	};
+
+	WeldKey makeWeldKey(const Vertex& vertex, float epsilon) {
+		float components[VERTEX_FLOATS];
+		std::memcpy(components, &vertex, sizeof(Vertex));
+		WeldKey key;
+		for (int i = 0; i < VERTEX_FLOATS; i++) {
+			if (epsilon > 0.0f) {
+				key.words[i] = (uint32_t) (int32_t) std::floor(components[i] / epsilon + 0.5f);
+			}
+			else {
+				// -0 and +0 are the same vertex
+				float value = (components[i] == 0.0f) ? 0.0f : components[i];
+				std::memcpy(&key.words[i], &value, sizeof(float));
+			}
+		}
+		return key;
+	}
+
+	uint32_t hashWeldKey(const WeldKey& key) {
+		uint32_t hash = 2166136261u;
+		for (int i = 0; i < VERTEX_FLOATS; i++) {
+			hash = (hash ^ key.words[i]) * 16777619u;
+			hash ^= hash >> 15;
+		}
+		return hash;
+	}
+}
+
+unsigned int weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float epsilon) {
+	// open addressing at under half load, slots hold indices into the welded array
+	size_t capacity = 16;
+	while (capacity < vertices.size() * 2) {
+		capacity *= 2;
+	}
+	const unsigned int empty = ~0u;
+	std::vector<unsigned int> slots(capacity, empty);
+	std::vector<WeldKey> keys;
+	std::vector<Vertex> welded;
+	std::vector<unsigned int> remap(vertices.size());
+	keys.reserve(vertices.size());
+	welded.reserve(vertices.size());
+
+	for (size_t v = 0; v < vertices.size(); v++) {
+		WeldKey key = makeWeldKey(vertices[v], epsilon);
+		size_t slot = hashWeldKey(key) & (capacity - 1);
+		while (slots[slot] != empty && !(keys[slots[slot]] == key)) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+		if (slots[slot] == empty) {
+			slots[slot] = (unsigned int) welded.size();
+			keys.push_back(key);
+			welded.push_back(vertices[v]);
+		}
+		remap[v] = slots[slot];
+	}
+
+	for (unsigned int& index : indices) {
+		index = remap[index];
+	}
+	vertices.swap(welded);
+	return (unsigned int) vertices.size();
+}
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize) {
+	VertexCacheStats stats{ 0.0f, 0.0f };
+	if (indexCount < 3) {
+		return stats;
+	}
+
+	CacheClock cache{ vertexCount, cacheSize };
+	std::vector<bool> used(vertexCount, false);
+	size_t misses = 0, unique = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		misses += cache.touch(indices[i]);
+		if (!used[indices[i]]) {
+			used[indices[i]] = true;
+			unique++;
+		}
+	}
+	stats.acmr = (float) misses / (float) (indexCount / 3);
+	stats.atvr = (float) misses / (float) unique;
+	return stats;
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// triangles around each vertex, and how many of them are still to be emitted
+	std::vector<unsigned int> live(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i++) {
+		live[indices[i]]++;
+	}
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		offsets[v + 1] = offsets[v] + live[v];
+	}
+	std::vector<unsigned int> adjacency(indexCount);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indexCount; i++) {
+		adjacency[fill[indices[i]]++] = (unsigned int) (i / 3);
+	}
+
+	const unsigned int none = ~0u;
+	std::vector<unsigned int> stamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> out;
+	deadEnd.reserve(indexCount);
+	out.reserve(indexCount);
+	unsigned int time = cacheSize + 1;
+	size_t cursor = 0;
+
+	// recently used vertices first, then the lowest numbered one with triangles left
+	auto skipDeadEnd = [&]() {
+		while (!deadEnd.empty()) {
+			unsigned int vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[vertex] > 0) {
+				return vertex;
+			}
+		}
+		for (; cursor < vertexCount; cursor++) {
+			if (live[cursor] > 0) {
+				return (unsigned int) cursor;
+			}
+		}
+		return none;
+	};
+
+	unsigned int fan = skipDeadEnd();
+	while (fan != none) {
+		candidates.clear();
+		for (unsigned int a = offsets[fan]; a < offsets[fan + 1]; a++) {
+			unsigned int triangle = adjacency[a];
+			if (emitted[triangle]) {
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				unsigned int vertex = indices[triangle * 3 + k];
+				out.push_back(vertex);
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				live[vertex]--;
+				if (time - stamps[vertex] > cacheSize) {
+					stamps[vertex] = time++;
+				}
+			}
+			emitted[triangle] = true;
+		}
+
+		// the oldest candidate that is still cached after fanning its remaining triangles,
+		// any candidate with triangles left otherwise
+		unsigned int next = none;
+		int best = -1;
+		for (unsigned int vertex : candidates) {
+			if (live[vertex] == 0) {
+				continue;
+			}
+			int priority = 0;
+			if (time - stamps[vertex] + 2 * live[vertex] <= cacheSize) {
+				priority = (int) (time - stamps[vertex]);
+			}
+			if (priority > best) {
+				best = priority;
+				next = vertex;
+			}
+		}
+		fan = (next != none) ? next : skipDeadEnd();
+	}
+
+	std::copy(out.begin(), out.end(), indices);
+}
+
+void optimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+	float threshold, unsigned int cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2) {
+		return;
+	}
+
+	// hard boundaries are where the cache order restarted, all three vertices missed
+	std::vector<size_t> hard{ 0 };
+	CacheClock cache{ vertexCount, cacheSize };
+	for (size_t t = 0; t < triangleCount; t++) {
+		int misses = cache.touch(indices[t * 3]) + cache.touch(indices[t * 3 + 1]) + cache.touch(indices[t * 3 + 2]);
+		if (misses == 3 && t > 0) {
+			hard.push_back(t);
+		}
+	}
+	hard.push_back(triangleCount);
+
+	// soft boundaries split a hard cluster as soon as the part so far, drawn from a cold cache,
+	// is within threshold of the whole cluster's ACMR
+	std::vector<size_t> starts;
+	for (size_t c = 0; c + 1 < hard.size(); c++) {
+		size_t begin = hard[c], end = hard[c + 1];
+		cache.flush();
+		size_t misses = 0;
+		for (size_t t = begin; t < end; t++) {
+			misses += cache.touch(indices[t * 3]) + cache.touch(indices[t * 3 + 1]) + cache.touch(indices[t * 3 + 2]);
+		}
+		float limit = threshold * (float) misses / (float) (end - begin);
+
+		starts.push_back(begin);
+		cache.flush();
+		misses = 0;
+		size_t first = begin;
+		for (size_t t = begin; t + 1 < end; t++) {
+			misses += cache.touch(indices[t * 3]) + cache.touch(indices[t * 3 + 1]) + cache.touch(indices[t * 3 + 2]);
+			if ((float) misses <= limit * (float) (t + 1 - first)) {
+				starts.push_back(t + 1);
+				cache.flush();
+				misses = 0;
+				first = t + 1;
+			}
+		}
+	}
+	starts.push_back(triangleCount);
+
+	// clusters facing away from the mesh centre are likely in front of the rest, so they go first
+	struct Cluster {
+		size_t begin, end;
+		float sortKey;
+	};
+	std::vector<Cluster> clusters;
+	std::vector<glm::vec3> centroids;
+	std::vector<glm::vec3> normals;
+	glm::vec3 meshCentroid{ 0.0f };
+	float meshArea = 0.0f;
+	for (size_t c = 0; c + 1 < starts.size(); c++) {
+		glm::vec3 centroid{ 0.0f }, normal{ 0.0f };
+		float area = 0.0f;
+		for (size_t t = starts[c]; t < starts[c + 1]; t++) {
+			const glm::vec3& a = vertices[indices[t * 3]].Position;
+			const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+			const glm::vec3& d = vertices[indices[t * 3 + 2]].Position;
+			glm::vec3 cross = glm::cross(b - a, d - a);
+			float triangleArea = glm::length(cross);
+			centroid += (a + b + d) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		meshCentroid += centroid;
+		meshArea += area;
+		centroids.push_back(area > 0.0f ? centroid / area : centroid);
+		float length = glm::length(normal);
+		normals.push_back(length > 0.0f ? normal / length : normal);
+		clusters.push_back(Cluster{ starts[c], starts[c + 1], 0.0f });
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid /= meshArea;
+	}
+	for (size_t c = 0; c < clusters.size(); c++) {
+		clusters[c].sortKey = glm::dot(centroids[c] - meshCentroid, normals[c]);
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<unsigned int> out;
+	out.reserve(indexCount);
+	for (const Cluster& cluster : clusters) {
+		out.insert(out.end(), indices + cluster.begin * 3, indices + cluster.end * 3);
+	}
+	std::copy(out.begin(), out.end(), indices);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	const unsigned int none = ~0u;
+	std::vector<unsigned int> remap(vertices.size(), none);
+	std::vector<Vertex> out;
+	out.reserve(vertices.size());
+	for (unsigned int& index : indices) {
+		if (remap[index] == none) {
+			remap[index] = (unsigned int) out.size();
+			out.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(out);
+}
+
+MeshOptimizeReport optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float weldEpsilon) {
+	MeshOptimizeReport report;
+	report.before = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+	report.verticesBefore = (unsigned int) vertices.size();
+	weldVertices(vertices, indices, weldEpsilon);
+	// points and lines left over from triangulation are drawn as they came
+	if (indices.size() % 3 == 0) {
+		optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+		optimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+		optimizeVertexFetch(vertices, indices);
+	}
+	report.after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+	report.verticesAfter = (unsigned int) vertices.size();
+	return report;
+}
\ No newline at end of file
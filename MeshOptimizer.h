@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+
+// the simulated post-transform cache, a 16 entry FIFO is close to what most GPUs keep
+#define VERTEX_CACHE_SIZE 16
+// an overdraw cluster may cost this much more ACMR than the cache order it was cut from
+#define OVERDRAW_THRESHOLD 1.05f
+
+// ACMR is vertex shader runs per triangle, 0.5 is the ideal for a regular grid and 3 the worst.
+// ATVR is runs per unique vertex, 1 is ideal
+struct VertexCacheStats {
+	float acmr;
+	float atvr;
+};
+
+struct MeshOptimizeReport {
+	VertexCacheStats before;
+	VertexCacheStats after;
+	unsigned int verticesBefore;
+	unsigned int verticesAfter;
+};
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount,
+	unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// merges vertices whose position, normal and UV all match and remaps the indices, keeping the
+// first of each. With an epsilon the components are snapped to that grid before comparing, so
+// near duplicates either side of a grid line stay apart. Returns the new vertex count
+unsigned int weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float epsilon = 0.0f);
+
+// Tipsify (Sander, Nehab and Barczak 2007): fans around the vertex most likely to still be cached,
+// in linear time. Indices are triangle lists and are rewritten in place
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount,
+	unsigned int cacheSize = VERTEX_CACHE_SIZE);
+// cuts the cache order into clusters where a fresh cache costs at most threshold times more,
+// then draws the most outward facing clusters first so they occlude the rest of the mesh
+void optimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+	float threshold = OVERDRAW_THRESHOLD, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+// renumbers vertices in the order the indices first use them, unused ones are dropped
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// welding and then the three orderings, with the cache numbers from before and after
+MeshOptimizeReport optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float weldEpsilon = 0.0f);
\ No newline at end of file
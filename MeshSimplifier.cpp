@@ -0,0 +1,297 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+// every pass collapses a set of edges whose neighbourhoods do not overlap, most meshes
+// reach half their triangles in well under this many
+#define SIMPLIFY_MAX_PASSES 64
+// open borders weigh this much more than the surface, so outlines stay where they are
+#define SIMPLIFY_BORDER_WEIGHT 10.0
+
+namespace {
+	enum VertexKind : unsigned char {
+		KIND_MANIFOLD,
+		// on an open border, only moves along it
+		KIND_BORDER,
+		// seam, non-manifold or a border corner, never moves
+		KIND_LOCKED
+	};
+
+	// sum of squared plane distances, p'Ap + 2b'p + c, and the weight that turns it into a mean
+	struct Quadric {
+		double a00, a11, a22, a01, a02, a12;
+		double b0, b1, b2;
+		double c;
+		double weight;
+	};
+
+	void addPlane(Quadric& q, const glm::vec3& n, float d, double weight) {
+		q.a00 += weight * n.x * n.x;
+		q.a11 += weight * n.y * n.y;
+		q.a22 += weight * n.z * n.z;
+		q.a01 += weight * n.x * n.y;
+		q.a02 += weight * n.x * n.z;
+		q.a12 += weight * n.y * n.z;
+		q.b0 += weight * n.x * d;
+		q.b1 += weight * n.y * d;
+		q.b2 += weight * n.z * d;
+		q.c += weight * d * d;
+		q.weight += weight;
+	}
+
+	void addQuadric(Quadric& q, const Quadric& other) {
+		q.a00 += other.a00;
+		q.a11 += other.a11;
+		q.a22 += other.a22;
+		q.a01 += other.a01;
+		q.a02 += other.a02;
+		q.a12 += other.a12;
+		q.b0 += other.b0;
+		q.b1 += other.b1;
+		q.b2 += other.b2;
+		q.c += other.c;
+		q.weight += other.weight;
+	}
+
+	// weighted sum of squared distances from p to the planes
+	double evaluate(const Quadric& q, const glm::vec3& p) {
+		double x = p.x, y = p.y, z = p.z;
+		double error = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+			+ 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+		return std::max(error, 0.0);
+	}
+
+	uint64_t edgeKey(unsigned int a, unsigned int b) {
+		return ((uint64_t) a << 32) | b;
+	}
+
+	struct Collapse {
+		unsigned int from, to;
+		double cost;
+	};
+}
+
+std::vector<unsigned int> simplifyMesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount, float maxError, float* resultError) {
+	std::vector<unsigned int> result(indices, indices + indexCount);
+	if (resultError) *resultError = 0.0f;
+	if (indexCount % 3 != 0 || indexCount <= targetIndexCount) {
+		return result;
+	}
+
+	// vertices at the same position share one id for border detection, more than one is a seam
+	std::vector<unsigned int> byPosition(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++) byPosition[v] = v;
+	std::sort(byPosition.begin(), byPosition.end(), [&](unsigned int a, unsigned int b) {
+		const glm::vec3& pa = vertices[a].Position;
+		const glm::vec3& pb = vertices[b].Position;
+		if (pa.x != pb.x) return pa.x < pb.x;
+		if (pa.y != pb.y) return pa.y < pb.y;
+		return pa.z < pb.z;
+	});
+	std::vector<unsigned int> positionOf(vertexCount);
+	std::vector<bool> seam(vertexCount, false);
+	for (size_t i = 0; i < vertexCount;) {
+		size_t end = i + 1;
+		while (end < vertexCount && vertices[byPosition[end]].Position == vertices[byPosition[i]].Position) end++;
+		for (size_t j = i; j < end; j++) {
+			positionOf[byPosition[j]] = byPosition[i];
+			seam[byPosition[j]] = (end - i > 1);
+		}
+		i = end;
+	}
+
+	// every vertex starts with the planes of the triangles around it, weighted by area
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t t = 0; t < indexCount; t += 3) {
+		const glm::vec3& p0 = vertices[indices[t]].Position;
+		glm::vec3 normal = glm::cross(vertices[indices[t + 1]].Position - p0, vertices[indices[t + 2]].Position - p0);
+		float area = glm::length(normal);
+		if (area == 0.0f) continue;
+		normal /= area;
+		for (int k = 0; k < 3; k++) {
+			addPlane(quadrics[indices[t + k]], normal, -glm::dot(normal, p0), area * 0.5);
+		}
+	}
+
+	std::vector<unsigned int> remap(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++) remap[v] = v;
+	std::vector<VertexKind> kinds(vertexCount);
+	std::vector<unsigned char> bordersOut(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<uint64_t> edges;
+	std::vector<unsigned int> adjacencyStart(vertexCount + 1), adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<Collapse> best(vertexCount);
+	double maxCost = (double) maxError * maxError;
+	double appliedCost = 0.0;
+
+	for (int pass = 0; pass < SIMPLIFY_MAX_PASSES && result.size() > targetIndexCount; pass++) {
+		size_t triangleCount = result.size() / 3;
+
+		// half edges between positions, one whose twin is missing lies on an open border
+		edges.clear();
+		for (size_t t = 0; t < result.size(); t += 3) {
+			for (int k = 0; k < 3; k++) {
+				edges.push_back(edgeKey(positionOf[result[t + k]], positionOf[result[t + (k + 1) % 3]]));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		auto edgeCount = [&](unsigned int a, unsigned int b) {
+			auto range = std::equal_range(edges.begin(), edges.end(), edgeKey(a, b));
+			return (size_t) (range.second - range.first);
+		};
+
+		for (size_t v = 0; v < vertexCount; v++) {
+			kinds[v] = seam[v] ? KIND_LOCKED : KIND_MANIFOLD;
+			bordersOut[v] = 0;
+		}
+		for (size_t t = 0; t < result.size(); t += 3) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int a = result[t + k], b = result[t + (k + 1) % 3];
+				unsigned int pa = positionOf[a], pb = positionOf[b];
+				if (edgeCount(pa, pb) > 1) {
+					kinds[a] = kinds[b] = KIND_LOCKED;
+				}
+				if (edgeCount(pb, pa) == 0) {
+					// a vertex where two borders meet has more than one way to slide, it stays
+					if (kinds[a] != KIND_LOCKED) kinds[a] = (bordersOut[a]++ > 0) ? KIND_LOCKED : KIND_BORDER;
+					if (kinds[b] == KIND_MANIFOLD) kinds[b] = KIND_BORDER;
+
+					if (pass == 0) {
+						const glm::vec3& p0 = vertices[a].Position;
+						glm::vec3 edge = vertices[b].Position - p0;
+						glm::vec3 normal = glm::cross(vertices[result[t + 1]].Position - vertices[result[t]].Position,
+							vertices[result[t + 2]].Position - vertices[result[t]].Position);
+						glm::vec3 side = glm::cross(edge, normal);
+						float length = glm::length(side);
+						if (length > 0.0f) {
+							side /= length;
+							double weight = glm::dot(edge, edge) * SIMPLIFY_BORDER_WEIGHT;
+							addPlane(quadrics[a], side, -glm::dot(side, p0), weight);
+							addPlane(quadrics[b], side, -glm::dot(side, p0), weight);
+						}
+					}
+				}
+			}
+		}
+
+		// triangles around each vertex
+		std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+		for (unsigned int index : result) adjacencyStart[index + 1]++;
+		for (size_t v = 0; v < vertexCount; v++) adjacencyStart[v + 1] += adjacencyStart[v];
+		adjacency.resize(result.size());
+		{
+			std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+			for (size_t i = 0; i < result.size(); i++) adjacency[fill[result[i]]++] = (unsigned int) (i / 3);
+		}
+
+		// the cheapest allowed collapse out of every vertex
+		for (size_t v = 0; v < vertexCount; v++) best[v] = Collapse{ (unsigned int) v, ~0u, DBL_MAX };
+		for (size_t t = 0; t < result.size(); t += 3) {
+			for (int k = 0; k < 6; k++) {
+				unsigned int u = result[t + k % 3], v = result[t + (k / 3 + k + 1) % 3];
+				if (kinds[u] == KIND_LOCKED) continue;
+				if (kinds[u] == KIND_BORDER) {
+					unsigned int pu = positionOf[u], pv = positionOf[v];
+					bool borderEdge = edgeCount(pu, pv) == 0 || edgeCount(pv, pu) == 0;
+					if (!borderEdge || kinds[v] == KIND_MANIFOLD) continue;
+				}
+				const glm::vec3& target = vertices[v].Position;
+				double cost = (evaluate(quadrics[u], target) + evaluate(quadrics[v], target))
+					/ std::max(quadrics[u].weight + quadrics[v].weight, 1e-30);
+				if (cost < best[u].cost) best[u] = Collapse{ u, v, cost };
+			}
+		}
+		collapses.clear();
+		for (size_t v = 0; v < vertexCount; v++) {
+			if (best[v].to != ~0u) collapses.push_back(best[v]);
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		// cheapest first, skipping any that would overlap a collapse already made this pass
+		std::fill(touched.begin(), touched.end(), false);
+		size_t applied = 0;
+		for (const Collapse& c : collapses) {
+			if (triangleCount * 3 <= targetIndexCount || c.cost > maxCost) break;
+			if (touched[c.from] || touched[c.to]) continue;
+
+			// no triangle around the moving vertex may turn over
+			bool flips = false;
+			const glm::vec3& target = vertices[c.to].Position;
+			for (unsigned int a = adjacencyStart[c.from]; a < adjacencyStart[c.from + 1] && !flips; a++) {
+				const unsigned int* tri = &result[adjacency[a] * 3];
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) continue;
+				glm::vec3 p[3], q[3];
+				for (int k = 0; k < 3; k++) {
+					p[k] = vertices[tri[k]].Position;
+					q[k] = (tri[k] == c.from) ? target : p[k];
+				}
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+				flips = glm::dot(before, after) <= 0.0f;
+			}
+			if (flips) continue;
+
+			remap[c.from] = c.to;
+			addQuadric(quadrics[c.to], quadrics[c.from]);
+			appliedCost = std::max(appliedCost, c.cost);
+			for (unsigned int a = adjacencyStart[c.from]; a < adjacencyStart[c.from + 1]; a++) {
+				const unsigned int* tri = &result[adjacency[a] * 3];
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) triangleCount--;
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+			}
+			touched[c.to] = true;
+			applied++;
+		}
+		if (applied == 0) break;
+
+		// collapsed vertices are never targets in the same pass, so one lookup is enough
+		size_t write = 0;
+		for (size_t t = 0; t < result.size(); t += 3) {
+			unsigned int a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+			if (a == b || b == c || a == c) continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	if (resultError) *resultError = (float) std::sqrt(appliedCost);
+	return result;
+}
+
+std::vector<MeshLod> generateLods(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	std::vector<MeshLod> lods{ MeshLod{ 0, (unsigned int) indices.size(), 0.0f } };
+	if (indices.size() % 3 != 0) {
+		return lods;
+	}
+
+	// each level is simplified from the one before, so its error adds to theirs
+	std::vector<unsigned int> previous{ indices };
+	float error = 0.0f;
+	while (lods.size() < MESH_LOD_MAX) {
+		size_t target = (size_t) (previous.size() / 3 * MESH_LOD_REDUCTION) * 3;
+		float levelError;
+		std::vector<unsigned int> level = simplifyMesh(vertices.data(), vertices.size(), previous.data(), previous.size(), target,
+			FLT_MAX, &levelError);
+		if (level.empty() || level.size() > previous.size() * MESH_LOD_MIN_REDUCTION) {
+			break;
+		}
+
+		optimizeVertexCache(level.data(), level.size(), vertices.size());
+		error += levelError;
+		lods.push_back(MeshLod{ (unsigned int) indices.size(), (unsigned int) level.size(), error });
+		indices.insert(indices.end(), level.begin(), level.end());
+		previous.swap(level);
+	}
+	return lods;
+}
\ No newline at end of file
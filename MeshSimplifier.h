@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+
+// levels per mesh including the full one, each aiming for this share of the one before
+#define MESH_LOD_MAX 4
+#define MESH_LOD_REDUCTION 0.5f
+// a level that keeps more than this share of the previous one's triangles is not worth its indices
+#define MESH_LOD_MIN_REDUCTION 0.85f
+
+// Quadric error edge collapse (Garland and Heckbert 1997) that only moves vertices onto their
+// neighbours, so the result indexes the same vertex array. Vertices on UV or normal seams and
+// non-manifold ones stay put, open borders only collapse along themselves. Stops at
+// targetIndexCount or once the next collapse would be off by more than maxError, and writes the
+// distance the surface may have moved to resultError
+std::vector<unsigned int> simplifyMesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount, float maxError, float* resultError);
+
+// appends up to MESH_LOD_MAX - 1 coarser levels to indices, each cache optimized, and returns
+// every level's range with the full mesh first
+std::vector<MeshLod> generateLods(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
\ No newline at end of file
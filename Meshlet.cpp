@@ -0,0 +1,298 @@
+#include "Meshlet.h"
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "Mesh.h"
+#include "Bounds.h"
+#include "MeshOptimizer.h"
+
+// a lane per meshlet, as wide as the build targets
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MESHLET_LANES 8
+typedef __m256 lanes;
+static inline lanes lanesSet(float v) { return _mm256_set1_ps(v); }
+static inline lanes lanesLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline lanes lanesAdd(lanes a, lanes b) { return _mm256_add_ps(a, b); }
+static inline lanes lanesSub(lanes a, lanes b) { return _mm256_sub_ps(a, b); }
+static inline lanes lanesMul(lanes a, lanes b) { return _mm256_mul_ps(a, b); }
+static inline lanes lanesSqrt(lanes a) { return _mm256_sqrt_ps(a); }
+static inline lanes lanesLess(lanes a, lanes b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline lanes lanesOr(lanes a, lanes b) { return _mm256_or_ps(a, b); }
+static inline lanes lanesNone() { return _mm256_setzero_ps(); }
+static inline unsigned int lanesBits(lanes mask) { return (unsigned int) _mm256_movemask_ps(mask); }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHLET_LANES 4
+typedef __m128 lanes;
+static inline lanes lanesSet(float v) { return _mm_set1_ps(v); }
+static inline lanes lanesLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline lanes lanesAdd(lanes a, lanes b) { return _mm_add_ps(a, b); }
+static inline lanes lanesSub(lanes a, lanes b) { return _mm_sub_ps(a, b); }
+static inline lanes lanesMul(lanes a, lanes b) { return _mm_mul_ps(a, b); }
+static inline lanes lanesSqrt(lanes a) { return _mm_sqrt_ps(a); }
+static inline lanes lanesLess(lanes a, lanes b) { return _mm_cmplt_ps(a, b); }
+static inline lanes lanesOr(lanes a, lanes b) { return _mm_or_ps(a, b); }
+static inline lanes lanesNone() { return _mm_setzero_ps(); }
+static inline unsigned int lanesBits(lanes mask) { return (unsigned int) _mm_movemask_ps(mask); }
+#else
+#define MESHLET_LANES 1
+typedef float lanes;
+static inline lanes lanesSet(float v) { return v; }
+static inline lanes lanesLoad(const float* p) { return *p; }
+static inline lanes lanesAdd(lanes a, lanes b) { return a + b; }
+static inline lanes lanesSub(lanes a, lanes b) { return a - b; }
+static inline lanes lanesMul(lanes a, lanes b) { return a * b; }
+static inline lanes lanesSqrt(lanes a) { return std::sqrt(a); }
+static inline lanes lanesLess(lanes a, lanes b) { return (a < b) ? 1.0f : 0.0f; }
+static inline lanes lanesOr(lanes a, lanes b) { return (a != 0.0f || b != 0.0f) ? 1.0f : 0.0f; }
+static inline lanes lanesNone() { return 0.0f; }
+static inline unsigned int lanesBits(lanes mask) { return mask != 0.0f ? 1u : 0u; }
+#endif
+
+std::vector<Meshlet> buildMeshlets(const Vertex* vertices, size_t vertexCount, unsigned int* indices, size_t indexCount) {
+	std::vector<Meshlet> meshlets;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || indexCount % 3 != 0) {
+		return meshlets;
+	}
+
+	// triangles around each vertex
+	std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0), adjacency(indexCount);
+	for (size_t i = 0; i < indexCount; i++) adjacencyStart[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++) adjacencyStart[v + 1] += adjacencyStart[v];
+	{
+		std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (size_t i = 0; i < indexCount; i++) adjacency[fill[indices[i]]++] = (unsigned int) (i / 3);
+	}
+
+	// unit normals, degenerate triangles get none and never limit a cone
+	std::vector<glm::vec3> normals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++) {
+		const glm::vec3& p0 = vertices[indices[t * 3]].Position;
+		glm::vec3 n = glm::cross(vertices[indices[t * 3 + 1]].Position - p0, vertices[indices[t * 3 + 2]].Position - p0);
+		float length = glm::length(n);
+		normals[t] = (length > 0.0f) ? n / length : glm::vec3{ 0.0f };
+	}
+
+	// which meshlet took a triangle, lists it as a candidate, or already has a vertex
+	std::vector<unsigned int> meshletOf(triangleCount, ~0u), candidateOf(triangleCount, ~0u), vertexOf(vertexCount, ~0u);
+	std::vector<unsigned int> result;
+	result.reserve(indexCount);
+	std::vector<unsigned int> members, candidates, local, localToVertex;
+	size_t seed = 0;
+	while (true) {
+		// each meshlet starts from the first free triangle, so they follow the original order
+		while (seed < triangleCount && meshletOf[seed] != ~0u) seed++;
+		if (seed == triangleCount) break;
+
+		unsigned int id = (unsigned int) meshlets.size();
+		unsigned int meshletVertices = 0;
+		glm::vec3 normalSum{ 0.0f };
+		members.clear();
+		candidates.clear();
+		auto add = [&](unsigned int t) {
+			meshletOf[t] = id;
+			members.push_back(t);
+			normalSum += normals[t];
+			for (int k = 0; k < 3; k++) {
+				unsigned int v = indices[t * 3 + k];
+				if (vertexOf[v] == id) continue;
+				vertexOf[v] = id;
+				meshletVertices++;
+				for (unsigned int a = adjacencyStart[v]; a < adjacencyStart[v + 1]; a++) {
+					unsigned int n = adjacency[a];
+					if (meshletOf[n] == ~0u && candidateOf[n] != id) {
+						candidateOf[n] = id;
+						candidates.push_back(n);
+					}
+				}
+			}
+		};
+		add((unsigned int) seed);
+
+		while (members.size() < MESHLET_MAX_TRIANGLES) {
+			// fewest new vertices first, the closest facing breaks ties
+			glm::vec3 axis = (glm::dot(normalSum, normalSum) > 0.0f) ? glm::normalize(normalSum) : glm::vec3{ 0.0f };
+			size_t best = candidates.size();
+			float bestScore = FLT_MAX;
+			for (size_t c = 0; c < candidates.size(); c++) {
+				unsigned int t = candidates[c];
+				if (meshletOf[t] != ~0u) {
+					candidates[c--] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				unsigned int newVertices = 0;
+				for (int k = 0; k < 3; k++) newVertices += (vertexOf[indices[t * 3 + k]] != id);
+				if (meshletVertices + newVertices > MESHLET_MAX_VERTICES) continue;
+
+				float score = newVertices * 3.0f + (1.0f - glm::dot(normals[t], axis));
+				if (score < bestScore) {
+					bestScore = score;
+					best = c;
+				}
+			}
+			if (best == candidates.size()) break;
+
+			unsigned int t = candidates[best];
+			candidates[best] = candidates.back();
+			candidates.pop_back();
+			add(t);
+		}
+
+		Meshlet meshlet;
+		meshlet.firstIndex = (unsigned int) result.size();
+		meshlet.indexCount = (unsigned int) members.size() * 3;
+		// growth order is not cache order, each meshlet is reordered on its own few vertices
+		local.clear();
+		localToVertex.clear();
+		for (unsigned int t : members) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int v = indices[t * 3 + k];
+				auto it = std::find(localToVertex.begin(), localToVertex.end(), v);
+				local.push_back((unsigned int) (it - localToVertex.begin()));
+				if (it == localToVertex.end()) localToVertex.push_back(v);
+			}
+		}
+		optimizeVertexCache(local.data(), local.size(), localToVertex.size());
+
+		glm::vec3 minPos{ FLT_MAX }, maxPos{ -FLT_MAX };
+		for (unsigned int l : local) {
+			unsigned int v = localToVertex[l];
+			result.push_back(v);
+			minPos = glm::min(minPos, vertices[v].Position);
+			maxPos = glm::max(maxPos, vertices[v].Position);
+		}
+		meshlet.sphere.center = (minPos + maxPos) * 0.5f;
+		float radiusSq = 0.0f;
+		for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++) {
+			glm::vec3 offset = vertices[result[i]].Position - meshlet.sphere.center;
+			radiusSq = std::max(radiusSq, glm::dot(offset, offset));
+		}
+		meshlet.sphere.radius = std::sqrt(radiusSq);
+
+		// the cone holds every normal, too wide and no camera position sees only back faces
+		meshlet.coneAxis = (glm::dot(normalSum, normalSum) > 0.0f) ? glm::normalize(normalSum) : glm::vec3{ 0.0f, 0.0f, 1.0f };
+		float minDot = 1.0f;
+		for (unsigned int t : members) {
+			if (normals[t] != glm::vec3{ 0.0f }) minDot = std::min(minDot, glm::dot(normals[t], meshlet.coneAxis));
+		}
+		meshlet.coneCutoff = (minDot < MESHLET_CONE_MIN_DOT) ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+		meshlets.push_back(meshlet);
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+	return meshlets;
+}
+
+MeshletBounds::MeshletBounds()
+	: count(0)
+{}
+
+MeshletBounds::MeshletBounds(const std::vector<Meshlet>& meshlets)
+	: count((unsigned int) meshlets.size())
+{
+	// the padding lanes are tested too, their results are ignored
+	size_t padded = (meshlets.size() + MESHLET_LANES - 1) / MESHLET_LANES * MESHLET_LANES;
+	centerX.resize(padded);
+	centerY.resize(padded);
+	centerZ.resize(padded);
+	radius.resize(padded);
+	axisX.resize(padded);
+	axisY.resize(padded);
+	axisZ.resize(padded);
+	cutoff.resize(padded, 1.0f);
+	firstIndex.resize(padded);
+	indexCount.resize(padded);
+	for (size_t i = 0; i < meshlets.size(); i++) {
+		centerX[i] = meshlets[i].sphere.center.x;
+		centerY[i] = meshlets[i].sphere.center.y;
+		centerZ[i] = meshlets[i].sphere.center.z;
+		radius[i] = meshlets[i].sphere.radius;
+		axisX[i] = meshlets[i].coneAxis.x;
+		axisY[i] = meshlets[i].coneAxis.y;
+		axisZ[i] = meshlets[i].coneAxis.z;
+		cutoff[i] = meshlets[i].coneCutoff;
+		firstIndex[i] = meshlets[i].firstIndex;
+		indexCount[i] = meshlets[i].indexCount;
+	}
+}
+
+unsigned int MeshletBounds::size() const {
+	return count;
+}
+
+unsigned int MeshletBounds::cull(const glm::mat4& model, const Frustum& frustum, const glm::vec3& cameraPos,
+	std::vector<MeshletRange>& ranges) const {
+	// the planes and camera go to object space instead of every meshlet to world space.
+	// With a uniform scale the plane distances stay in world units
+	glm::mat3 linear{ model };
+	glm::vec3 translation{ model[3] };
+	float scale = glm::length(linear[0]);
+	if (scale == 0.0f) {
+		return 0;
+	}
+	glm::mat3 toObject = glm::transpose(linear);
+	lanes planes[FRUSTUM_PLANE_COUNT][4];
+	for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+		const Plane& plane = frustum.planes[p];
+		glm::vec3 normal = toObject * plane.normal;
+		planes[p][0] = lanesSet(normal.x);
+		planes[p][1] = lanesSet(normal.y);
+		planes[p][2] = lanesSet(normal.z);
+		planes[p][3] = lanesSet(glm::dot(plane.normal, translation) + plane.d);
+	}
+	glm::vec3 camera = toObject * (cameraPos - translation) / (scale * scale);
+	lanes cameraX = lanesSet(camera.x), cameraY = lanesSet(camera.y), cameraZ = lanesSet(camera.z);
+	lanes negScale = lanesSet(-scale);
+	// a mirroring transform turns the winding over, the cones would point the wrong way
+	bool cones = glm::dot(glm::cross(linear[0], linear[1]), linear[2]) > 0.0f;
+
+	unsigned int culled = 0;
+	size_t firstRange = ranges.size();
+	for (unsigned int base = 0; base < count; base += MESHLET_LANES) {
+		lanes x = lanesLoad(&centerX[base]), y = lanesLoad(&centerY[base]), z = lanesLoad(&centerZ[base]);
+		lanes r = lanesLoad(&radius[base]);
+
+		// outside when the sphere is entirely behind any plane
+		lanes outside = lanesNone();
+		lanes limit = lanesMul(r, negScale);
+		for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+			lanes distance = lanesAdd(lanesAdd(lanesMul(planes[p][0], x), lanesMul(planes[p][1], y)),
+				lanesAdd(lanesMul(planes[p][2], z), planes[p][3]));
+			outside = lanesOr(outside, lanesLess(distance, limit));
+		}
+
+		// back facing when the camera is on the far side of every triangle's plane,
+		// dot(center - camera, axis) > cutoff * |center - camera| + radius
+		if (cones) {
+			lanes dx = lanesSub(x, cameraX), dy = lanesSub(y, cameraY), dz = lanesSub(z, cameraZ);
+			lanes distance = lanesSqrt(lanesAdd(lanesAdd(lanesMul(dx, dx), lanesMul(dy, dy)), lanesMul(dz, dz)));
+			lanes facing = lanesAdd(lanesAdd(lanesMul(dx, lanesLoad(&axisX[base])), lanesMul(dy, lanesLoad(&axisY[base]))),
+				lanesMul(dz, lanesLoad(&axisZ[base])));
+			lanes bound = lanesAdd(lanesMul(lanesLoad(&cutoff[base]), distance), r);
+			outside = lanesOr(outside, lanesLess(bound, facing));
+		}
+
+		// survivors join the previous range when they follow it in the index buffer
+		unsigned int bits = lanesBits(outside);
+		unsigned int end = std::min(count, base + MESHLET_LANES);
+		for (unsigned int i = base; i < end; i++) {
+			if (bits & (1u << (i - base))) {
+				culled += indexCount[i] / 3;
+			}
+			else if (ranges.size() > firstRange && ranges.back().firstIndex + ranges.back().indexCount == firstIndex[i]) {
+				ranges.back().indexCount += indexCount[i];
+			}
+			else {
+				ranges.push_back(MeshletRange{ firstIndex[i], indexCount[i] });
+			}
+		}
+	}
+	return culled;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+#include "Bounds.h"
+
+struct Vertex;
+
+// small enough that a cluster is mostly facing one way, large enough that the
+// per-cluster test stays cheap next to the triangles it saves
+#define MESHLET_MAX_TRIANGLES 64
+#define MESHLET_MAX_VERTICES 64
+// clusters whose triangles spread wider than this, as the cosine from the average normal,
+// get no cone and are never back-face culled
+#define MESHLET_CONE_MIN_DOT 0.1f
+
+// a run of nearby triangles in its mesh's full level, with bounds for culling it on its own
+struct Meshlet {
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	BoundingSphere sphere;
+	// every triangle's normal is within the cone around axis, cutoff is the sine of the
+	// smallest angle between a normal and axis, 1 when there is no usable cone
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+// what survives meshlet culling, neighbouring meshlets merged into one range
+struct MeshletRange {
+	unsigned int firstIndex;
+	unsigned int indexCount;
+};
+
+// regroups the triangles of indices in place into meshlets of at most MESHLET_MAX_TRIANGLES
+// triangles and MESHLET_MAX_VERTICES vertices, grown across shared vertices while preferring
+// triangles that face the way the meshlet already does. Returns them in index order
+std::vector<Meshlet> buildMeshlets(const Vertex* vertices, size_t vertexCount, unsigned int* indices, size_t indexCount);
+
+// One mesh's meshlet bounds in SoA arrays padded to the SIMD width, tested a lane per
+// meshlet. The transform is assumed to be rotation, translation and uniform scale.
+class MeshletBounds {
+private:
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> axisX, axisY, axisZ, cutoff;
+	std::vector<unsigned int> firstIndex, indexCount;
+	unsigned int count;
+
+public:
+	MeshletBounds();
+	explicit MeshletBounds(const std::vector<Meshlet>& meshlets);
+
+	unsigned int size() const;
+
+	// appends the ranges of meshlets inside frustum and facing cameraPos to ranges, both in world
+	// space, and returns how many triangles were culled
+	unsigned int cull(const glm::mat4& model, const Frustum& frustum, const glm::vec3& cameraPos,
+		std::vector<MeshletRange>& ranges) const;
+};
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "MipChain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "JobSystem.h"
+
+// wide lanes follow the instruction set the build targets, /arch:AVX2 on MSVC
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIP_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_SSE2
+#endif
+
+// output rows handed to a task at a time
+#define MIP_ROWS_PER_TASK 16
+// linear values are kept in 15 bits so sums of two never leave an unsigned 16 bit lane
+#define MIP_LINEAR_MAX 32767
+
+// [0] stores values as they are, [1] converts between sRGB and linear light
+static uint16_t decodeTable[2][256];
+static uint8_t encodeTable[2][MIP_LINEAR_MAX + 1];
+static std::once_flag tablesBuilt;
+
+static void buildTables() {
+	for (int i = 0; i < 256; i++) {
+		double value = i / 255.0;
+		double linear = (value <= 0.04045) ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+		decodeTable[0][i] = (uint16_t) std::lround(value * MIP_LINEAR_MAX);
+		decodeTable[1][i] = (uint16_t) std::lround(linear * MIP_LINEAR_MAX);
+	}
+	for (int i = 0; i <= MIP_LINEAR_MAX; i++) {
+		double linear = i / (double) MIP_LINEAR_MAX;
+		double value = (linear <= 0.0031308) ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+		encodeTable[0][i] = (uint8_t) std::lround(linear * 255.0);
+		encodeTable[1][i] = (uint8_t) std::lround(std::min(1.0, value) * 255.0);
+	}
+}
+
+// averages the 2x2 blocks of two decoded rows, four lanes a texel, into outWidth texels
+static void averageRows(const uint16_t* row0, const uint16_t* row1, int outWidth, uint16_t* out) {
+	int x = 0;
+#if defined(MIP_AVX2)
+	for (; x + 4 <= outWidth; x += 4) {
+		const __m256i* a = (const __m256i*) (row0 + x * 8);
+		const __m256i* b = (const __m256i*) (row1 + x * 8);
+		__m256i vertical0 = _mm256_avg_epu16(_mm256_loadu_si256(a), _mm256_loadu_si256(b));
+		__m256i vertical1 = _mm256_avg_epu16(_mm256_loadu_si256(a + 1), _mm256_loadu_si256(b + 1));
+		// each 128 bit lane holds a horizontal pair, the average lands in its low half
+		__m256i pair0 = _mm256_avg_epu16(vertical0, _mm256_srli_si256(vertical0, 8));
+		__m256i pair1 = _mm256_avg_epu16(vertical1, _mm256_srli_si256(vertical1, 8));
+		__m256i texels = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(pair0, pair1), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i*) (out + x * 4), texels);
+	}
+#elif defined(MIP_SSE2)
+	for (; x + 2 <= outWidth; x += 2) {
+		const __m128i* a = (const __m128i*) (row0 + x * 8);
+		const __m128i* b = (const __m128i*) (row1 + x * 8);
+		__m128i vertical0 = _mm_avg_epu16(_mm_loadu_si128(a), _mm_loadu_si128(b));
+		__m128i vertical1 = _mm_avg_epu16(_mm_loadu_si128(a + 1), _mm_loadu_si128(b + 1));
+		__m128i pair0 = _mm_avg_epu16(vertical0, _mm_srli_si128(vertical0, 8));
+		__m128i pair1 = _mm_avg_epu16(vertical1, _mm_srli_si128(vertical1, 8));
+		_mm_storeu_si128((__m128i*) (out + x * 4), _mm_unpacklo_epi64(pair0, pair1));
+	}
+#endif
+	// same rounding as the avg instructions, (a + b + 1) / 2 at each step
+	for (; x < outWidth; x++) {
+		for (int c = 0; c < 4; c++) {
+			int left = (row0[x * 8 + c] + row1[x * 8 + c] + 1) >> 1;
+			int right = (row0[x * 8 + 4 + c] + row1[x * 8 + 4 + c] + 1) >> 1;
+			out[x * 4 + c] = (uint16_t) ((left + right + 1) >> 1);
+		}
+	}
+}
+
+// the table lookups dominate, so the channel count is a template parameter to unroll them
+template<int CHANNELS>
+static void downsampleRows(const unsigned char* texels, int width, int height, const int tables[4],
+	unsigned char* out, int outWidth, int outHeight, int firstRow, int lastRow)
+{
+	const uint16_t* decode[4] = { decodeTable[tables[0]], decodeTable[tables[1]], decodeTable[tables[2]], decodeTable[tables[3]] };
+	const uint8_t* encode[4] = { encodeTable[tables[0]], encodeTable[tables[1]], encodeTable[tables[2]], encodeTable[tables[3]] };
+
+	// an odd side folds its last three texels into one, a side of one is repeated instead
+	bool oddWidth = width > 1 && (width & 1), oddHeight = height > 1 && (height & 1);
+	int decodedWidth = oddWidth ? outWidth * 2 + 1 : outWidth * 2;
+
+	// every texel widened to four 16 bit lanes
+	std::vector<uint16_t> row0(decodedWidth * 4, 0), row1(decodedWidth * 4, 0), row2, average(outWidth * 4);
+	if (oddHeight) row2.resize(decodedWidth * 4, 0);
+	auto decodeRow = [&](int y, uint16_t* row) {
+		const unsigned char* in = texels + (size_t) y * width * CHANNELS;
+		for (int x = 0; x < decodedWidth; x++) {
+			const unsigned char* texel = in + (size_t) std::min(x, width - 1) * CHANNELS;
+			for (int c = 0; c < CHANNELS; c++) {
+				row[x * 4 + c] = decode[c][texel[c]];
+			}
+		}
+	};
+
+	for (int y = firstRow; y < lastRow; y++) {
+		const uint16_t* top = row0.data();
+		const uint16_t* bottom = row1.data();
+		decodeRow(std::min(y * 2, height - 1), row0.data());
+		decodeRow(std::min(y * 2 + 1, height - 1), row1.data());
+		if (oddHeight && y == outHeight - 1) {
+			// the three rows become one, averaging it with itself leaves it as it is
+			decodeRow(y * 2 + 2, row2.data());
+			for (size_t i = 0; i < row0.size(); i++) {
+				row0[i] = (uint16_t) ((row0[i] + row1[i] + row2[i] + 1) / 3);
+			}
+			bottom = top;
+		}
+		averageRows(top, bottom, outWidth, average.data());
+		if (oddWidth) {
+			uint16_t* last = average.data() + (outWidth - 1) * 4;
+			const int first = (outWidth - 1) * 8;
+			for (int c = 0; c < 4; c++) {
+				int sum = 0;
+				for (int i = 0; i < 3; i++) {
+					sum += (top[first + i * 4 + c] + bottom[first + i * 4 + c] + 1) >> 1;
+				}
+				last[c] = (uint16_t) ((sum + 1) / 3);
+			}
+		}
+
+		unsigned char* outRow = out + (size_t) y * outWidth * CHANNELS;
+		for (int x = 0; x < outWidth; x++) {
+			for (int c = 0; c < CHANNELS; c++) {
+				outRow[x * CHANNELS + c] = encode[c][average[x * 4 + c]];
+			}
+		}
+	}
+}
+
+void downsampleLevel(const unsigned char* texels, int width, int height, int channels, bool srgb,
+	unsigned char* out, JobSystem* jobs)
+{
+	std::call_once(tablesBuilt, buildTables);
+
+	int outWidth = std::max(1, width / 2), outHeight = std::max(1, height / 2);
+	int tables[4];
+	for (int c = 0; c < 4; c++) {
+		tables[c] = (srgb && channels >= 3 && c < 3) ? 1 : 0;
+	}
+
+	auto downsampleTask = [&](unsigned int task) {
+		int firstRow = (int) task * MIP_ROWS_PER_TASK;
+		int lastRow = std::min(outHeight, firstRow + MIP_ROWS_PER_TASK);
+		switch (channels) {
+		case 1: downsampleRows<1>(texels, width, height, tables, out, outWidth, outHeight, firstRow, lastRow); break;
+		case 2: downsampleRows<2>(texels, width, height, tables, out, outWidth, outHeight, firstRow, lastRow); break;
+		case 3: downsampleRows<3>(texels, width, height, tables, out, outWidth, outHeight, firstRow, lastRow); break;
+		default: downsampleRows<4>(texels, width, height, tables, out, outWidth, outHeight, firstRow, lastRow); break;
+		}
+	};
+
+	unsigned int tasks = (unsigned int) (outHeight + MIP_ROWS_PER_TASK - 1) / MIP_ROWS_PER_TASK;
+	if (jobs && tasks > 1) {
+		jobs->parallelFor(tasks, downsampleTask);
+	}
+	else {
+		for (unsigned int task = 0; task < tasks; task++) {
+			downsampleTask(task);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+
+class JobSystem;
+
+// Halves a level with a 2x2 box filter into max(1, width / 2) x max(1, height / 2)
+// texels. Along an odd side the last output texel averages three source texels, so
+// no row or column is dropped and the level stays aligned. With srgb set the color
+// channels of 3 and 4 channel images are averaged as linear light and stored back
+// as sRGB, alpha and 1 or 2 channel images are averaged as stored. Output rows are
+// spread over the job system when one is given.
+void downsampleLevel(const unsigned char* texels, int width, int height, int channels, bool srgb,
+	unsigned char* out, JobSystem* jobs);
\ No newline at end of file
@@ -2,8 +2,8 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
-#include "stb_image.h"
 
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -11,111 +11,272 @@
 #include "Model.h"
 #include "Shader.h"
 #include "Mesh.h"
+#include "GLState.h"
+#include "CookedModel.h"
+#include "JobSystem.h"
+#include "TextureStreamer.h"
+#include "TextureCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
 
-Model::Model(std::string path)
-{
-	loadModel(path);
-}
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MODEL_SSE2
+#endif
 
-void Model::loadModel(std::string path) {
-	Assimp::Importer importer;
-	const aiScene* scene{importer.ReadFile(path.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs)};
+static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "vertex conversion assumes single precision assimp");
 
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-		return;
-	}
+Model::Model(std::string path, JobSystem* jobs, TextureStreamer* streamer, VertexFormat format, bool keepResident)
+	: geometryMemory{}, loadedCooked(false), loadMs(0.0), textureMs(0.0), convertMs(0.0), streamer(streamer),
+	vertexFormat(format), keepResident(keepResident)
+{
+	loadModel(path, jobs);
+}
 
+void Model::loadModel(std::string path, JobSystem* jobs) {
+	auto start = std::chrono::high_resolution_clock::now();
 	directory = path.substr(0, path.find_last_of('\\')+1);
 
-	processNode(scene->mRootNode, scene);
-}
+	// the cooked file is only trusted when it matches the source, anything else re-imports
+	if (!loadCooked(path)) {
+		if (!loadAssimp(path, jobs)) {
+			return;
+		}
+		writeCookedModel(path + COOKED_MODEL_EXTENSION, path, meshes, optimizeReports, nodes);
+	}
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
-	for (int i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		const Mesh& mesh = meshes[i];
+		unsigned int stride = getVertexStride(mesh.getVertexFormat());
+		geometryMemory.vertexBytes += mesh.getVertexCount() * stride;
+		geometryMemory.vertexBytesSaved += (optimizeReports[i].verticesBefore - optimizeReports[i].verticesAfter) * stride;
+		geometryMemory.vertexBytesPacked += mesh.getVertexCount() * (sizeof(Vertex) - stride);
+		geometryMemory.indexBytes += mesh.getTotalIndexCount() * mesh.getIndexSize();
+		geometryMemory.indexBytesSaved += mesh.getTotalIndexCount() * (sizeof(unsigned int) - mesh.getIndexSize());
 	}
 
-	for (int i = 0; i < node->mNumChildren; i++) {
-		processNode(node->mChildren[i], scene);
+	// everything is on the GPU and cooked, the CPU copies are only kept when asked for
+	auto cpuBytes = [&]() {
+		size_t bytes = cooked ? cooked->getFileSize() : 0;
+		for (const Mesh& mesh : meshes) {
+			bytes += mesh.getCPUBytes();
+		}
+		return bytes;
+	};
+	geometryMemory.cpuBytesLoaded = cpuBytes();
+	if (!keepResident) {
+		for (Mesh& mesh : meshes) {
+			mesh.releaseCPUData();
+		}
+		cooked.reset();
 	}
+	geometryMemory.cpuBytesResident = cpuBytes();
+
+	loadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "Loaded " << path << (loadedCooked ? " (cooked)" : " (assimp)") << " in " << loadMs << " ms, "
+		<< textureMs << " ms of it textures" << std::endl;
+	std::cout << "Geometry: " << geometryMemory.vertexBytes / 1024 << " KB of " << getVertexFormatName(vertexFormat) << " vertices, "
+		<< geometryMemory.vertexBytesSaved / 1024 << " KB welded away, " << geometryMemory.vertexBytesPacked / 1024
+		<< " KB saved by packing, " << geometryMemory.indexBytes / 1024 << " KB of indices, " << geometryMemory.indexBytesSaved / 1024
+		<< " KB saved by 16 bit indices, " << geometryMemory.cpuBytesLoaded / 1024 << " KB on the CPU after loading, "
+		<< geometryMemory.cpuBytesResident / 1024 << " KB after upload" << std::endl;
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+bool Model::loadCooked(const std::string& path) {
+	std::unique_ptr<CookedModel> file = std::make_unique<CookedModel>();
+	if (!file->open(path + COOKED_MODEL_EXTENSION, path)) {
+		return false;
+	}
+
+	meshes.reserve(file->getMeshCount());
+	for (unsigned int i = 0; i < file->getMeshCount(); i++) {
+		const CookedMesh& mesh = file->getMesh(i);
+		optimizeReports.push_back(MeshOptimizeReport{ VertexCacheStats{ mesh.acmrBefore, mesh.atvrBefore },
+			VertexCacheStats{ mesh.acmrAfter, mesh.atvrAfter }, mesh.sourceVertexCount, mesh.vertexCount });
 
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-		Vertex vertex{};
-		aiVector3D pos{ mesh->mVertices[i] };
-		vertex.Position.x = pos.x;
-		vertex.Position.y = pos.y;
-		vertex.Position.z = pos.z;
-
-		if (mesh->HasNormals()) {
-			aiVector3D norm{ mesh->mNormals[i] };
-			vertex.Normal.x = norm.x;
-			vertex.Normal.y = norm.y;
-			vertex.Normal.z = norm.z;
+		std::vector<Texture> textures;
+		const CookedMaterial& material = file->getMaterial(mesh.material);
+		for (unsigned int j = 0; j < material.textureRefCount; j++) {
+			const CookedTextureRef& ref = file->getTextureRef(material.firstTextureRef + j);
+			textures.push_back(loadTexture(file->getString(ref.path), file->getString(ref.type)));
 		}
 
-		if (mesh->mTextureCoords[0]) {
-			vertex.TexCoords.x = mesh->mTextureCoords[0][i].x;
-			vertex.TexCoords.y = mesh->mTextureCoords[0][i].y;
+		AABB bounds{ glm::vec3{ mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2] },
+			glm::vec3{ mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2] } };
+		BoundingSphere sphere{ glm::vec3{ mesh.sphereCenter[0], mesh.sphereCenter[1], mesh.sphereCenter[2] }, mesh.sphereRadius };
+		std::vector<MeshLod> lods;
+		unsigned int firstIndex = 0;
+		for (unsigned int l = 0; l < mesh.lodCount; l++) {
+			lods.push_back(MeshLod{ firstIndex, mesh.lodIndexCount[l], mesh.lodError[l] });
+			firstIndex += mesh.lodIndexCount[l];
 		}
-		else {
-			vertex.TexCoords = glm::vec2{ 0.0f };
+		std::vector<Meshlet> meshlets;
+		for (unsigned int m = 0; m < mesh.meshletCount; m++) {
+			const CookedMeshlet& c = file->getMeshlet(mesh.firstMeshlet + m);
+			meshlets.push_back(Meshlet{ c.firstIndex, c.indexCount,
+				BoundingSphere{ glm::vec3{ c.sphereCenter[0], c.sphereCenter[1], c.sphereCenter[2] }, c.sphereRadius },
+				glm::vec3{ c.coneAxis[0], c.coneAxis[1], c.coneAxis[2] }, c.coneCutoff });
 		}
-
-		vertices.push_back(vertex);
+		meshes.push_back(Mesh{ file->getVertices(mesh), mesh.vertexCount, file->getIndices(mesh), mesh.indexCount,
+			textures, bounds, sphere, vertexFormat, std::move(lods), std::move(meshlets) });
 	}
 
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-		aiFace face = mesh->mFaces[i];
-		for (int j = 0; j < face.mNumIndices; j++) {
-			indices.push_back(face.mIndices[j]);
+	nodes.reserve(file->getNodeCount());
+	for (unsigned int i = 0; i < file->getNodeCount(); i++) {
+		const CookedNode& node = file->getNode(i);
+		ModelNode modelNode;
+		modelNode.name = file->getString(node.name);
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				modelNode.transform[c][r] = node.transform[c * 4 + r];
+			}
 		}
+		modelNode.parent = node.parent;
+		for (unsigned int j = 0; j < node.meshCount; j++) {
+			modelNode.meshes.push_back(file->getNodeMesh(node.firstMesh + j));
+		}
+		nodes.push_back(modelNode);
 	}
 
-	if (mesh->mMaterialIndex >= 0) {
-		aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture> diffuseMaps = loadMaterialTextures(mat, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+	cooked = std::move(file);
+	loadedCooked = true;
+	return true;
+}
+
+// interleaves one aiMesh into exactly sized vertex and index arrays, touches no GL state
+static void convertMesh(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	unsigned int count = mesh->mNumVertices;
+	const aiVector3D* positions = mesh->mVertices;
+	const aiVector3D* normals = mesh->HasNormals() ? mesh->mNormals : NULL;
+	const aiVector3D* texCoords = mesh->mTextureCoords[0];
+	vertices.resize(count);
 
-		std::vector<Texture> specularMaps = loadMaterialTextures(mat, aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+	unsigned int i = 0;
+#ifdef MODEL_SSE2
+	// each source vector is loaded as four floats, the fourth is overwritten by the next
+	// store, so the last vertex is left to the scalar loop to avoid reading past the arrays
+	__m128 zero = _mm_setzero_ps();
+	for (; i + 1 < count; i++) {
+		float* out = &vertices[i].Position.x;
+		_mm_storeu_ps(out, _mm_loadu_ps(&positions[i].x));
+		_mm_storeu_ps(out + 3, normals ? _mm_loadu_ps(&normals[i].x) : zero);
+		_mm_storel_pi((__m64*) (out + 6), texCoords ? _mm_loadu_ps(&texCoords[i].x) : zero);
+	}
+#endif
+	for (; i < count; i++) {
+		Vertex& vertex = vertices[i];
+		vertex.Position = glm::vec3{ positions[i].x, positions[i].y, positions[i].z };
+		vertex.Normal = normals ? glm::vec3{ normals[i].x, normals[i].y, normals[i].z } : glm::vec3{ 0.0f };
+		vertex.TexCoords = texCoords ? glm::vec2{ texCoords[i].x, texCoords[i].y } : glm::vec2{ 0.0f };
 	}
 
-	return Mesh{ vertices, indices, textures };
+	unsigned int indexCount = 0;
+	for (unsigned int f = 0; f < mesh->mNumFaces; f++) {
+		indexCount += mesh->mFaces[f].mNumIndices;
+	}
+	indices.resize(indexCount);
+
+	unsigned int* out = indices.data();
+	for (unsigned int f = 0; f < mesh->mNumFaces; f++) {
+		const aiFace& face = mesh->mFaces[f];
+		for (unsigned int j = 0; j < face.mNumIndices; j++) {
+			*out++ = face.mIndices[j];
+		}
+	}
 }
 
-unsigned int TextureFromFile(std::string filePath) {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
+bool Model::loadAssimp(const std::string& path, JobSystem* jobs) {
+	Assimp::Importer importer;
+	const aiScene* scene{importer.ReadFile(path.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs)};
+
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+		return false;
+	}
 
-	int width, height, numChannels;
-	unsigned char* data{ stbi_load(filePath.c_str(), &width, &height, &numChannels, 0) };
-	if (data) {
-		GLint format{ (numChannels == 1) ? GL_RED :
-											((numChannels == 3) ? GL_RGB : GL_RGBA) };
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	std::vector<aiMesh*> order;
+	processNode(scene->mRootNode, scene, -1, order);
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// convert and optimize every mesh as its own job, each into its own slot so the result does not depend on scheduling
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<std::vector<Vertex>> vertices(order.size());
+	std::vector<std::vector<unsigned int>> indices(order.size());
+	std::vector<std::vector<MeshLod>> lods(order.size());
+	std::vector<std::vector<Meshlet>> meshlets(order.size());
+	optimizeReports.resize(order.size());
+	auto convert = [&](unsigned int i) {
+		convertMesh(order[i], vertices[i], indices[i]);
+		optimizeReports[i] = optimizeMesh(vertices[i], indices[i]);
+		// clustering trades some of the cache order for cullable meshlets, the report shows what is left
+		meshlets[i] = buildMeshlets(vertices[i].data(), vertices[i].size(), indices[i].data(), indices[i].size());
+		optimizeReports[i].after = analyzeVertexCache(indices[i].data(), indices[i].size(), vertices[i].size());
+		// the coarser levels are simplified from the clustered full level and get their own cache order
+		lods[i] = generateLods(vertices[i], indices[i]);
+	};
+	if (jobs) {
+		jobs->parallelFor((unsigned int) order.size(), convert);
 	}
 	else {
-		std::cout << "Could not load texture from \"" << filePath << "\"" << std::endl;
+		for (unsigned int i = 0; i < order.size(); i++) {
+			convert(i);
+		}
 	}
-	std::cout << "Loading " << filePath << std::endl;
-	stbi_image_free(data);
+	convertMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
 
-	return textureID;
+	for (unsigned int i = 0; i < order.size(); i++) {
+		const MeshOptimizeReport& report = optimizeReports[i];
+		std::cout << "Mesh " << i << " (" << order[i]->mName.C_Str() << "): " << report.verticesBefore << " -> " << report.verticesAfter
+			<< " vertices, ACMR " << report.before.acmr << " -> " << report.after.acmr
+			<< ", ATVR " << report.before.atvr << " -> " << report.after.atvr << ", " << meshlets[i].size()
+			<< " meshlets, LOD triangles";
+		for (const MeshLod& lod : lods[i]) {
+			std::cout << " " << lod.indexCount / 3;
+		}
+		std::cout << std::endl;
+	}
+
+	// textures and buffer uploads need the context, so they happen here in mesh order
+	meshes.reserve(order.size());
+	for (unsigned int i = 0; i < order.size(); i++) {
+		std::vector<Texture> textures;
+		if (order[i]->mMaterialIndex < scene->mNumMaterials) {
+			aiMaterial* mat = scene->mMaterials[order[i]->mMaterialIndex];
+			std::vector<Texture> diffuseMaps = loadMaterialTextures(mat, aiTextureType_DIFFUSE, "texture_diffuse");
+			textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+
+			std::vector<Texture> specularMaps = loadMaterialTextures(mat, aiTextureType_SPECULAR, "texture_specular");
+			textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+		}
+		meshes.push_back(Mesh{ std::move(vertices[i]), std::move(indices[i]), textures, vertexFormat, std::move(lods[i]),
+			std::move(meshlets[i]) });
+	}
+	return true;
+}
+
+void Model::processNode(aiNode* node, const aiScene* scene, int parent, std::vector<aiMesh*>& order) {
+	ModelNode modelNode;
+	modelNode.name = node->mName.C_Str();
+	// assimp matrices are row major
+	const aiMatrix4x4& m = node->mTransformation;
+	modelNode.transform = glm::mat4{ 1.0f };
+	modelNode.transform[0][0] = m.a1; modelNode.transform[1][0] = m.a2; modelNode.transform[2][0] = m.a3; modelNode.transform[3][0] = m.a4;
+	modelNode.transform[0][1] = m.b1; modelNode.transform[1][1] = m.b2; modelNode.transform[2][1] = m.b3; modelNode.transform[3][1] = m.b4;
+	modelNode.transform[0][2] = m.c1; modelNode.transform[1][2] = m.c2; modelNode.transform[2][2] = m.c3; modelNode.transform[3][2] = m.c4;
+	modelNode.transform[0][3] = m.d1; modelNode.transform[1][3] = m.d2; modelNode.transform[2][3] = m.d3; modelNode.transform[3][3] = m.d4;
+	modelNode.parent = parent;
+
+	for (int i = 0; i < node->mNumMeshes; i++) {
+		modelNode.meshes.push_back((unsigned int) order.size());
+		order.push_back(scene->mMeshes[node->mMeshes[i]]);
+	}
+
+	int index = (int) nodes.size();
+	nodes.push_back(modelNode);
+
+	for (int i = 0; i < node->mNumChildren; i++) {
+		processNode(node->mChildren[i], scene, index, order);
+	}
 }
 
 std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
@@ -123,29 +284,58 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
 		aiString str;
 		mat->GetTexture(type, i, &str);
-		bool skip = false;
-		for (unsigned int j = 0; j < texturesLoaded.size(); j++) {
-			if (std::strcmp(texturesLoaded[j].path.data(), str.C_Str()) == 0) {
-				textures.push_back(texturesLoaded[j]);
-				skip = true;
-				break;
-			}
-		}
-
-		if (!skip) {
-			Texture tex;
-			tex.id = TextureFromFile(directory + str.C_Str());
-			tex.type = typeName;
-			tex.path = std::string(str.C_Str());
-			textures.push_back(tex);
-			texturesLoaded.push_back(tex);
-		}
+		textures.push_back(loadTexture(str.C_Str(), typeName));
 	}
 	return textures;
 }
 
+Texture Model::loadTexture(const std::string& path, const std::string& typeName) {
+	auto it = texturesLoaded.find(path);
+	if (it != texturesLoaded.end()) {
+		return it->second;
+	}
+
+	// the cache shares the texture with every other model using the same image
+	auto start = std::chrono::high_resolution_clock::now();
+	// mid grey diffuse and no specular until streamed maps arrive
+	glm::vec4 placeholder{ (typeName == "texture_specular") ? glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f } : glm::vec4{ 0.5f, 0.5f, 0.5f, 1.0f } };
+	TextureCache::Handle handle = TextureCache::acquire(directory + path, placeholder, streamer);
+	textureHandles.push_back(handle);
+
+	Texture tex;
+	tex.id = handle->id;
+	tex.type = typeName;
+	tex.path = path;
+	texturesLoaded.emplace(path, tex);
+	textureMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return tex;
+}
+
 void Model::Draw(Shader& shader) {
 	for (int i = 0; i < meshes.size(); i++) {
 		meshes[i].Draw(shader);
 	}
-}
\ No newline at end of file
+}
+
+void Model::Submit(RenderQueue& queue, Shader& shader, const glm::mat4& model) {
+	// meshes are placed by their node, parents come first so one pass accumulates the transforms
+	std::vector<glm::mat4> world(nodes.size());
+	for (unsigned int i = 0; i < nodes.size(); i++) {
+		world[i] = ((nodes[i].parent >= 0) ? world[nodes[i].parent] : model) * nodes[i].transform;
+		if (nodes[i].meshes.empty()) continue;
+
+		unsigned int transform = queue.addTransform(world[i]);
+		for (unsigned int mesh : nodes[i].meshes) {
+			queue.submit(shader, meshes[mesh], transform);
+		}
+	}
+}
+
+std::vector<Mesh>& Model::getMeshes() { return meshes; }
+const std::vector<ModelNode>& Model::getNodes() const { return nodes; }
+const std::vector<MeshOptimizeReport>& Model::getOptimizeReports() const { return optimizeReports; }
+const GeometryMemory& Model::getGeometryMemory() const { return geometryMemory; }
+bool Model::isCooked() const { return loadedCooked; }
+double Model::getLoadMs() const { return loadMs; }
+double Model::getTextureMs() const { return textureMs; }
+double Model::getConvertMs() const { return convertMs; }
\ No newline at end of file
@@ -1,25 +1,98 @@
 #pragma once
+#include <glm/glm.hpp>
+
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <assimp/scene.h>
 
 #include "Shader.h"
 #include "Mesh.h"
+#include "RenderQueue.h"
+#include "CookedModel.h"
+#include "TextureCache.h"
+#include "MeshOptimizer.h"
+
+class JobSystem;
+class TextureStreamer;
+
+// the imported node hierarchy, parents always come before their children
+struct ModelNode {
+	std::string name;
+	glm::mat4 transform;
+	int parent;
+	std::vector<unsigned int> meshes;
+};
 
+// what the uploaded geometry costs and what welding, packing and 16 bit indices saved on it
+struct GeometryMemory {
+	size_t vertexBytes;
+	size_t vertexBytesSaved;
+	size_t vertexBytesPacked;
+	size_t indexBytes;
+	size_t indexBytesSaved;
+	// CPU geometry, imported arrays or the cooked mapping, right after loading and once uploads are done
+	size_t cpuBytesLoaded;
+	size_t cpuBytesResident;
+};
+
+// Owns its meshes and their GL objects, so it can be moved but not copied.
 class Model {
 private:
 	std::vector<Mesh> meshes;
-	std::vector<Texture> texturesLoaded;
+	std::vector<ModelNode> nodes;
+	// one per mesh, from the import that produced the geometry
+	std::vector<MeshOptimizeReport> optimizeReports;
+	GeometryMemory geometryMemory;
+	// keyed by material path, the handles keep the shared GL textures alive
+	std::unordered_map<std::string, Texture> texturesLoaded;
+	std::vector<TextureCache::Handle> textureHandles;
 	std::string directory;
 
-	void loadModel(std::string path);
-	void processNode(aiNode* node, const aiScene* scene);
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+	// cooked meshes point into this mapping while their CPU data is kept
+	std::unique_ptr<CookedModel> cooked;
+	bool loadedCooked;
+	double loadMs, textureMs, convertMs;
+
+	// textures go through here when set, otherwise they load synchronously
+	TextureStreamer* streamer;
+	VertexFormat vertexFormat;
+	bool keepResident;
+
+	void loadModel(std::string path, JobSystem* jobs);
+	bool loadCooked(const std::string& path);
+	bool loadAssimp(const std::string& path, JobSystem* jobs);
+	// records the node hierarchy and the order meshes will be created in
+	void processNode(aiNode* node, const aiScene* scene, int parent, std::vector<aiMesh*>& order);
 	std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+	Texture loadTexture(const std::string& path, const std::string& typeName);
 
 public:
-	Model(std::string path);
+	// with a job system, imported meshes are converted in parallel, GL work always stays on this thread.
+	// With a streamer, textures start as placeholders and arrive over the next frames.
+	// The format only changes the GPU copy, the CPU side and the cooked file stay float.
+	// CPU vertices and indices are released after upload unless keepResident is set
+	Model(std::string path, JobSystem* jobs = NULL, TextureStreamer* streamer = NULL, VertexFormat format = VERTEX_FLOAT,
+		bool keepResident = false);
+
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+	Model(Model&&) = default;
+	Model& operator=(Model&&) = default;
 
 	void Draw(Shader& shader);
+	void Submit(RenderQueue& queue, Shader& shader, const glm::mat4& model);
+
+	std::vector<Mesh>& getMeshes();
+	const std::vector<ModelNode>& getNodes() const;
+	const std::vector<MeshOptimizeReport>& getOptimizeReports() const;
+	const GeometryMemory& getGeometryMemory() const;
+
+	// load timings, geometry and texture decode split so they can be compared separately
+	bool isCooked() const;
+	double getLoadMs() const;
+	double getTextureMs() const;
+	double getConvertMs() const;
 };
\ No newline at end of file
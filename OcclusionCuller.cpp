@@ -0,0 +1,378 @@
+#include "OcclusionCuller.h"
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "Bounds.h"
+#include "JobSystem.h"
+
+// lane width follows the instruction set the build targets, /arch:AVX2 on MSVC
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OCCLUSION_LANES 8
+typedef __m256 lanes;
+static inline lanes lanesSet(float v) { return _mm256_set1_ps(v); }
+static inline lanes lanesRamp() { return _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f); }
+static inline lanes lanesAdd(lanes a, lanes b) { return _mm256_add_ps(a, b); }
+static inline lanes lanesMul(lanes a, lanes b) { return _mm256_mul_ps(a, b); }
+static inline lanes lanesMin(lanes a, lanes b) { return _mm256_min_ps(a, b); }
+static inline lanes lanesInside(lanes e0, lanes e1, lanes e2) {
+	lanes zero = _mm256_setzero_ps();
+	return _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+}
+static inline bool lanesAny(lanes mask) { return _mm256_movemask_ps(mask) != 0; }
+static inline lanes lanesSelect(lanes mask, lanes a, lanes b) { return _mm256_blendv_ps(b, a, mask); }
+static inline lanes lanesLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void lanesStore(float* p, lanes v) { _mm256_storeu_ps(p, v); }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_LANES 4
+typedef __m128 lanes;
+static inline lanes lanesSet(float v) { return _mm_set1_ps(v); }
+static inline lanes lanesRamp() { return _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f); }
+static inline lanes lanesAdd(lanes a, lanes b) { return _mm_add_ps(a, b); }
+static inline lanes lanesMul(lanes a, lanes b) { return _mm_mul_ps(a, b); }
+static inline lanes lanesMin(lanes a, lanes b) { return _mm_min_ps(a, b); }
+static inline lanes lanesInside(lanes e0, lanes e1, lanes e2) {
+	lanes zero = _mm_setzero_ps();
+	return _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+}
+static inline bool lanesAny(lanes mask) { return _mm_movemask_ps(mask) != 0; }
+static inline lanes lanesSelect(lanes mask, lanes a, lanes b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+static inline lanes lanesLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void lanesStore(float* p, lanes v) { _mm_storeu_ps(p, v); }
+#else
+#define OCCLUSION_LANES 1
+typedef float lanes;
+static inline lanes lanesSet(float v) { return v; }
+static inline lanes lanesRamp() { return 0.5f; }
+static inline lanes lanesAdd(lanes a, lanes b) { return a + b; }
+static inline lanes lanesMul(lanes a, lanes b) { return a * b; }
+static inline lanes lanesMin(lanes a, lanes b) { return std::min(a, b); }
+static inline lanes lanesInside(lanes e0, lanes e1, lanes e2) { return (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) ? 1.0f : 0.0f; }
+static inline bool lanesAny(lanes mask) { return mask != 0.0f; }
+static inline lanes lanesSelect(lanes mask, lanes a, lanes b) { return (mask != 0.0f) ? a : b; }
+static inline lanes lanesLoad(const float* p) { return *p; }
+static inline void lanesStore(float* p, lanes v) { *p = v; }
+#endif
+
+// triangles reaching past this many viewports are clipped so edge functions keep their precision
+#define OCCLUSION_GUARD_BAND 2.0f
+// occludees only count as hidden when they are at least this much farther than the occluders,
+// so an occluder never hides its own bounds through rounding
+#define OCCLUSION_DEPTH_BIAS 1e-5f
+
+static const int rowsPerBand = OCCLUSION_HEIGHT / OCCLUSION_BANDS;
+
+using cullClock = std::chrono::steady_clock;
+
+static double msSince(cullClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(cullClock::now() - start).count();
+}
+
+// signed distance to each clip plane, inside when >= 0: near, then the guard band sides
+static float clipDistance(const glm::vec4& v, int plane) {
+	switch (plane) {
+	case 0: return v.z + v.w;
+	case 1: return OCCLUSION_GUARD_BAND * v.w + v.x;
+	case 2: return OCCLUSION_GUARD_BAND * v.w - v.x;
+	case 3: return OCCLUSION_GUARD_BAND * v.w + v.y;
+	default: return OCCLUSION_GUARD_BAND * v.w - v.y;
+	}
+}
+
+OcclusionCuller::OcclusionCuller(JobSystem& jobs)
+	: jobs(jobs), viewProjection(1.0f)
+{
+	unsigned int offset = 0;
+	for (unsigned int w = OCCLUSION_WIDTH, h = OCCLUSION_HEIGHT; w > 0 && h > 0; w /= 2, h /= 2) {
+		levelOffsets.push_back(offset);
+		offset += w * h;
+	}
+	hiZ.assign(offset, 1.0f);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+	wait();
+}
+
+void OcclusionCuller::begin(const glm::mat4& viewProjection) {
+	wait();
+	this->viewProjection = viewProjection;
+	occluders.clear();
+	occludees.clear();
+}
+
+void OcclusionCuller::addOccluder(const float* positions, unsigned int stride, unsigned int vertexCount,
+	const unsigned int* indices, unsigned int indexCount, const glm::mat4& model)
+{
+	if (indices == NULL) indexCount = vertexCount;
+	occluders.push_back(Occluder{ positions, stride, vertexCount, indices, indexCount, model });
+}
+
+unsigned int OcclusionCuller::addOccludee(const AABB& worldBox) {
+	occludees.push_back(worldBox);
+	return (unsigned int) occludees.size() - 1;
+}
+
+void OcclusionCuller::cullAsync() {
+	wait();
+	jobs.spawn([this] { run(); }, &pending);
+}
+
+void OcclusionCuller::wait() {
+	jobs.wait(pending);
+}
+
+void OcclusionCuller::run() {
+	stats = Stats{};
+
+	cullClock::time_point start = cullClock::now();
+	triangles.resize(occluders.size());
+	jobs.parallelFor((unsigned int) occluders.size(), [this](unsigned int i) { setupOccluder(i); });
+	for (const Occluder& o : occluders) {
+		stats.occluderTriangles += o.indexCount / 3;
+	}
+	for (const std::vector<ScreenTriangle>& list : triangles) {
+		stats.rasterizedTriangles += (unsigned int) list.size();
+	}
+	stats.setupMs = msSince(start);
+
+	start = cullClock::now();
+	jobs.parallelFor(OCCLUSION_BANDS, [this](unsigned int band) { rasterizeBand(band); });
+	buildHiZ();
+	stats.rasterMs = msSince(start);
+
+	// boxes are tested in chunks, one job per chunk
+	start = cullClock::now();
+	const unsigned int chunk = 256;
+	unsigned int count = (unsigned int) occludees.size();
+	visible.assign(count, 1);
+	jobs.parallelFor((count + chunk - 1) / chunk, [this, chunk, count](unsigned int c) {
+		unsigned int end = std::min(count, (c + 1) * chunk);
+		for (unsigned int i = c * chunk; i < end; i++) {
+			visible[i] = testBox(occludees[i]) ? 1 : 0;
+		}
+	});
+	stats.tested = count;
+	for (unsigned char v : visible) {
+		if (!v) stats.occluded++;
+	}
+	stats.testMs = msSince(start);
+}
+
+void OcclusionCuller::setupOccluder(unsigned int occluder) {
+	const Occluder& o = occluders[occluder];
+	std::vector<ScreenTriangle>& out = triangles[occluder];
+	out.clear();
+
+	glm::mat4 mvp{ viewProjection * o.model };
+	std::vector<glm::vec4> clip(o.vertexCount);
+	const unsigned char* bytes = (const unsigned char*) o.positions;
+	for (unsigned int i = 0; i < o.vertexCount; i++) {
+		const float* p = (const float*) (bytes + (size_t) i * o.stride);
+		clip[i] = mvp * glm::vec4{ p[0], p[1], p[2], 1.0f };
+	}
+
+	const float halfWidth = OCCLUSION_WIDTH * 0.5f;
+	const float halfHeight = OCCLUSION_HEIGHT * 0.5f;
+
+	for (unsigned int t = 0; t + 2 < o.indexCount; t += 3) {
+		glm::vec4 poly[9];
+		int count = 3;
+		for (int k = 0; k < 3; k++) {
+			poly[k] = clip[o.indices ? o.indices[t + k] : t + k];
+		}
+
+		// drop triangles entirely outside one plane, clip the ones crossing it
+		bool rejected = false;
+		for (int plane = 0; plane < 5 && !rejected; plane++) {
+			int outside = 0;
+			for (int k = 0; k < count; k++) {
+				if (clipDistance(poly[k], plane) < 0.0f) outside++;
+			}
+			if (outside == count) rejected = true;
+			if (outside == 0 || rejected) continue;
+
+			glm::vec4 clipped[9];
+			int clippedCount = 0;
+			for (int k = 0; k < count; k++) {
+				const glm::vec4& a = poly[k];
+				const glm::vec4& b = poly[(k + 1) % count];
+				float da = clipDistance(a, plane);
+				float db = clipDistance(b, plane);
+				if (da >= 0.0f) clipped[clippedCount++] = a;
+				if ((da >= 0.0f) != (db >= 0.0f)) clipped[clippedCount++] = a + (b - a) * (da / (da - db));
+			}
+			std::copy(clipped, clipped + clippedCount, poly);
+			count = clippedCount;
+		}
+		if (rejected || count < 3) continue;
+
+		// to pixels, y up like window coordinates
+		glm::vec3 screen[9];
+		for (int k = 0; k < count; k++) {
+			float invW = 1.0f / poly[k].w;
+			screen[k] = glm::vec3{ (poly[k].x * invW + 1.0f) * halfWidth, (poly[k].y * invW + 1.0f) * halfHeight,
+				poly[k].z * invW * 0.5f + 0.5f };
+		}
+
+		// fan out whatever the clipper left
+		for (int k = 1; k + 1 < count; k++) {
+			glm::vec3 v[3] = { screen[0], screen[k], screen[k + 1] };
+			float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+			if (std::abs(area) < 1e-6f) continue;
+			// both windings are rasterized, occluders need not be closed or consistently wound
+			if (area < 0.0f) {
+				std::swap(v[1], v[2]);
+				area = -area;
+			}
+
+			ScreenTriangle tri;
+			tri.minX = std::max(0, (int) std::floor(std::min({ v[0].x, v[1].x, v[2].x })));
+			tri.maxX = std::min(OCCLUSION_WIDTH - 1, (int) std::ceil(std::max({ v[0].x, v[1].x, v[2].x })));
+			tri.minY = std::max(0, (int) std::floor(std::min({ v[0].y, v[1].y, v[2].y })));
+			tri.maxY = std::min(OCCLUSION_HEIGHT - 1, (int) std::ceil(std::max({ v[0].y, v[1].y, v[2].y })));
+			if (tri.minX > tri.maxX || tri.minY > tri.maxY) continue;
+
+			// edge i is opposite vertex i, positive inside
+			for (int e = 0; e < 3; e++) {
+				const glm::vec3& a = v[(e + 1) % 3];
+				const glm::vec3& b = v[(e + 2) % 3];
+				tri.edgeA[e] = a.y - b.y;
+				tri.edgeB[e] = b.x - a.x;
+				tri.edgeC[e] = a.x * b.y - b.x * a.y;
+			}
+
+			// the edge functions over the area are the barycentrics, z is linear in them
+			float invArea = 1.0f / area;
+			tri.zA = (tri.edgeA[0] * v[0].z + tri.edgeA[1] * v[1].z + tri.edgeA[2] * v[2].z) * invArea;
+			tri.zB = (tri.edgeB[0] * v[0].z + tri.edgeB[1] * v[1].z + tri.edgeB[2] * v[2].z) * invArea;
+			tri.zC = (tri.edgeC[0] * v[0].z + tri.edgeC[1] * v[1].z + tri.edgeC[2] * v[2].z) * invArea;
+			out.push_back(tri);
+		}
+	}
+}
+
+void OcclusionCuller::rasterizeBand(unsigned int band) {
+	int bandMinY = band * rowsPerBand;
+	int bandMaxY = bandMinY + rowsPerBand - 1;
+	float* depth = hiZ.data();
+
+	for (float* row = depth + bandMinY * OCCLUSION_WIDTH; row < depth + (bandMaxY + 1) * OCCLUSION_WIDTH; row++) {
+		*row = 1.0f;
+	}
+
+	const lanes ramp = lanesRamp();
+	const lanes step = lanesSet((float) OCCLUSION_LANES);
+	for (const std::vector<ScreenTriangle>& list : triangles) {
+		for (const ScreenTriangle& tri : list) {
+			int minY = std::max(tri.minY, bandMinY);
+			int maxY = std::min(tri.maxY, bandMaxY);
+			if (minY > maxY) continue;
+
+			int startX = tri.minX & ~(OCCLUSION_LANES - 1);
+			lanes x0 = lanesAdd(lanesSet((float) startX), ramp);
+			lanes edgeStepX[3], zStepX = lanesMul(lanesSet(tri.zA), step);
+			for (int e = 0; e < 3; e++) {
+				edgeStepX[e] = lanesMul(lanesSet(tri.edgeA[e]), step);
+			}
+
+			for (int y = minY; y <= maxY; y++) {
+				float py = y + 0.5f;
+				lanes edge[3];
+				for (int e = 0; e < 3; e++) {
+					edge[e] = lanesAdd(lanesMul(lanesSet(tri.edgeA[e]), x0), lanesSet(tri.edgeB[e] * py + tri.edgeC[e]));
+				}
+				lanes z = lanesAdd(lanesMul(lanesSet(tri.zA), x0), lanesSet(tri.zB * py + tri.zC));
+
+				float* row = depth + y * OCCLUSION_WIDTH;
+				for (int x = startX; x <= tri.maxX; x += OCCLUSION_LANES) {
+					lanes inside = lanesInside(edge[0], edge[1], edge[2]);
+					if (lanesAny(inside)) {
+						lanes old = lanesLoad(row + x);
+						lanesStore(row + x, lanesSelect(inside, lanesMin(old, z), old));
+					}
+					for (int e = 0; e < 3; e++) {
+						edge[e] = lanesAdd(edge[e], edgeStepX[e]);
+					}
+					z = lanesAdd(z, zStepX);
+				}
+			}
+		}
+	}
+}
+
+void OcclusionCuller::buildHiZ() {
+	// each texel keeps the farthest depth of the four below it
+	unsigned int w = OCCLUSION_WIDTH, h = OCCLUSION_HEIGHT;
+	for (size_t level = 1; level < levelOffsets.size(); level++) {
+		const float* src = hiZ.data() + levelOffsets[level - 1];
+		float* dst = hiZ.data() + levelOffsets[level];
+		unsigned int srcWidth = w;
+		w /= 2;
+		h /= 2;
+		for (unsigned int y = 0; y < h; y++) {
+			const float* row0 = src + (2 * y) * srcWidth;
+			const float* row1 = row0 + srcWidth;
+			for (unsigned int x = 0; x < w; x++) {
+				dst[y * w + x] = std::max(std::max(row0[2 * x], row0[2 * x + 1]), std::max(row1[2 * x], row1[2 * x + 1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::testBox(const AABB& box) const {
+	glm::vec2 minScreen{ FLT_MAX }, maxScreen{ -FLT_MAX };
+	float minZ = FLT_MAX;
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 corner{ (i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z };
+		glm::vec4 clip{ viewProjection * glm::vec4{ corner, 1.0f } };
+		// reaches past the near plane, the camera may well be inside it
+		if (clip.z < -clip.w) return true;
+
+		float invW = 1.0f / clip.w;
+		glm::vec2 screen{ (clip.x * invW + 1.0f) * OCCLUSION_WIDTH * 0.5f, (clip.y * invW + 1.0f) * OCCLUSION_HEIGHT * 0.5f };
+		minScreen = glm::min(minScreen, screen);
+		maxScreen = glm::max(maxScreen, screen);
+		minZ = std::min(minZ, clip.z * invW * 0.5f + 0.5f);
+	}
+
+	int minX = std::max(0, (int) std::floor(minScreen.x));
+	int minY = std::max(0, (int) std::floor(minScreen.y));
+	int maxX = std::min(OCCLUSION_WIDTH - 1, (int) std::floor(maxScreen.x));
+	int maxY = std::min(OCCLUSION_HEIGHT - 1, (int) std::floor(maxScreen.y));
+	// off screen, nothing of it can be seen
+	if (minX > maxX || minY > maxY) return false;
+
+	// coarsest level where the rectangle still spans at most 4x4 texels
+	unsigned int level = 0;
+	while (level + 1 < levelOffsets.size() && std::max((maxX >> level) - (minX >> level), (maxY >> level) - (minY >> level)) >= 4) {
+		level++;
+	}
+
+	const float* texels = hiZ.data() + levelOffsets[level];
+	int levelWidth = OCCLUSION_WIDTH >> level;
+	for (int y = minY >> level; y <= (maxY >> level); y++) {
+		for (int x = minX >> level; x <= (maxX >> level); x++) {
+			if (texels[y * levelWidth + x] + OCCLUSION_DEPTH_BIAS >= minZ) return true;
+		}
+	}
+	return false;
+}
+
+bool OcclusionCuller::isVisible(unsigned int occludee) const {
+	return visible[occludee] != 0;
+}
+
+const float* OcclusionCuller::getDepthBuffer() const {
+	return hiZ.data();
+}
+
+const OcclusionCuller::Stats& OcclusionCuller::getStats() const {
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Bounds.h"
+#include "JobSystem.h"
+
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+// the depth buffer is rasterized in horizontal bands, one job each
+#define OCCLUSION_BANDS 8
+
+// Software occlusion culling. Occluder triangles are rasterized on the CPU into
+// a small depth buffer, a max-depth pyramid is built over it and occludee boxes
+// are tested against the pyramid. Nothing here touches GL, so it can run as a
+// job while the GPU is still busy with the previous frame.
+//
+// Depth is z/w mapped to [0, 1], larger is farther. Occluders only write pixels
+// whose centers they cover, so they should sit inside the geometry they stand
+// for, never outside it.
+class OcclusionCuller {
+public:
+	struct Stats {
+		unsigned int occluderTriangles = 0;
+		unsigned int rasterizedTriangles = 0;
+		unsigned int tested = 0;
+		unsigned int occluded = 0;
+		double setupMs = 0.0;
+		double rasterMs = 0.0;
+		double testMs = 0.0;
+	};
+
+private:
+	struct Occluder {
+		const float* positions;
+		unsigned int stride;
+		unsigned int vertexCount;
+		const unsigned int* indices;
+		unsigned int indexCount;
+		glm::mat4 model;
+	};
+
+	// edge functions and depth plane of a screen space triangle, all evaluated at pixel centers
+	struct ScreenTriangle {
+		float edgeA[3], edgeB[3], edgeC[3];
+		float zA, zB, zC;
+		int minX, maxX, minY, maxY;
+	};
+
+	JobSystem& jobs;
+	JobCounter pending;
+
+	glm::mat4 viewProjection;
+	std::vector<Occluder> occluders;
+	std::vector<std::vector<ScreenTriangle>> triangles;
+	std::vector<AABB> occludees;
+	std::vector<unsigned char> visible;
+
+	// level 0 is the depth buffer itself, each level after it halves both sides
+	std::vector<float> hiZ;
+	std::vector<unsigned int> levelOffsets;
+
+	Stats stats;
+
+	void setupOccluder(unsigned int occluder);
+	void rasterizeBand(unsigned int band);
+	void buildHiZ();
+	bool testBox(const AABB& box) const;
+	void run();
+
+public:
+	OcclusionCuller(JobSystem& jobs);
+	~OcclusionCuller();
+
+	// waits for any culling still running and clears occluders and occludees
+	void begin(const glm::mat4& viewProjection);
+
+	// positions are read when culling runs, they must stay alive until wait()
+	// returns. indices may be NULL for unindexed triangle lists
+	void addOccluder(const float* positions, unsigned int stride, unsigned int vertexCount,
+		const unsigned int* indices, unsigned int indexCount, const glm::mat4& model);
+	// returns the index to pass to isVisible()
+	unsigned int addOccludee(const AABB& worldBox);
+
+	// starts culling as a job and returns immediately
+	void cullAsync();
+	void wait();
+
+	bool isVisible(unsigned int occludee) const;
+
+	const float* getDepthBuffer() const;
+	const Stats& getStats() const;
+};
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "RenderQueue.h"
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Shader.h"
+#include "Mesh.h"
+#include "GLState.h"
+#include "Bounds.h"
+
+KeyLayout KeyLayout::stateThenDepth() {
+	KeyLayout layout;
+	layout.fields = { { KeyField::Program, 8 }, { KeyField::Material, 16 }, { KeyField::VAO, 16 }, { KeyField::Depth, 24 } };
+	return layout;
+}
+
+KeyLayout KeyLayout::depthThenState() {
+	KeyLayout layout;
+	layout.fields = { { KeyField::Depth, 24 }, { KeyField::Program, 8 }, { KeyField::Material, 16 }, { KeyField::VAO, 16 } };
+	return layout;
+}
+
+RenderQueue::RenderQueue(KeyLayout layout)
+	: layout(layout), view(1.0f), cameraPos(0.0f), farPlane(100.0f), culling(false), meshletCulling(false), lodPixelsPerUnit(0.0f), lodMaxPixelError(1.0f),
+	lodHysteresis(LOD_HYSTERESIS)
+{}
+
+void RenderQueue::setLayout(const KeyLayout& layout) {
+	this->layout = layout;
+}
+
+void RenderQueue::begin(const glm::mat4& view, float farPlane) {
+	this->view = view;
+	this->farPlane = farPlane;
+	cameraPos = glm::vec3{ glm::inverse(view)[3] };
+	culling = false;
+	packets.clear();
+	transforms.clear();
+	transformScales.clear();
+	ranges.clear();
+
+	stats.culledMeshes = 0;
+	stats.culledTriangles = 0;
+	stats.drawnTriangles = 0;
+	stats.testedMeshlets = 0;
+	stats.culledMeshletTriangles = 0;
+	stats.meshletRanges = 0;
+}
+
+void RenderQueue::begin(const glm::mat4& view, float farPlane, const Frustum& frustum) {
+	begin(view, farPlane);
+	this->frustum = frustum;
+	culling = true;
+}
+
+void RenderQueue::setLodSelection(float projection11, float viewportHeight, float maxPixelError, float hysteresis) {
+	lodPixelsPerUnit = projection11 * viewportHeight * 0.5f;
+	lodMaxPixelError = maxPixelError;
+	lodHysteresis = hysteresis;
+}
+
+void RenderQueue::disableLodSelection() {
+	lodPixelsPerUnit = 0.0f;
+}
+
+void RenderQueue::setMeshletCulling(bool enabled) {
+	meshletCulling = enabled;
+}
+
+unsigned int RenderQueue::addTransform(const glm::mat4& model) {
+	transforms.push_back(model);
+
+	// largest axis scale, bounding sphere radii grow by this much
+	float scaleSq = std::max({ glm::dot(glm::vec3{ model[0] }, glm::vec3{ model[0] }),
+							   glm::dot(glm::vec3{ model[1] }, glm::vec3{ model[1] }),
+							   glm::dot(glm::vec3{ model[2] }, glm::vec3{ model[2] }) });
+	transformScales.push_back(std::sqrt(scaleSq));
+	return (unsigned int) transforms.size() - 1;
+}
+
+void RenderQueue::submit(Shader& shader, Mesh& mesh, unsigned int transform, unsigned int* lodState) {
+	const glm::mat4& model = transforms[transform];
+	glm::vec3 worldCenter{ model * glm::vec4{ mesh.getSphere().center, 1.0f } };
+	float radius = mesh.getSphere().radius * transformScales[transform];
+
+	if (culling) {
+		// the sphere test is cheap and rejects most meshes, the box only confirms what it lets through
+		BoundingSphere sphere{ worldCenter, radius };
+		if (!frustum.intersects(sphere) || !frustum.intersects(mesh.getBounds().transform(model))) {
+			stats.culledMeshes++;
+			stats.culledTriangles += mesh.getTriangleCount();
+			return;
+		}
+	}
+
+	// view space distance to the mesh center
+	glm::vec4 viewPos{ view * glm::vec4{ worldCenter, 1.0f } };
+	float depth = std::clamp(-viewPos.z / farPlane, 0.0f, 1.0f);
+
+	unsigned int lod = 0;
+	if (lodPixelsPerUnit > 0.0f && mesh.getLodCount() > 1) {
+		// the nearest point of the sphere, errors there cover the most pixels
+		float distance = std::max(glm::length(glm::vec3{ viewPos }) - radius, radius * 0.01f);
+		float errorScale = lodPixelsPerUnit * transformScales[transform] / distance;
+		lod = mesh.selectLod(errorScale, lodMaxPixelError, lodHysteresis, lodState ? *lodState : 0);
+	}
+	if (lodState) *lodState = lod;
+
+	// coarser levels have no meshlets, they are far enough away that the whole mesh is cheap
+	unsigned int firstRange = (unsigned int) ranges.size(), rangeCount = 0;
+	unsigned int triangles = mesh.getLod(lod).indexCount / 3;
+	if (culling && meshletCulling && lod == 0 && mesh.getMeshletBounds().size() > 1) {
+		unsigned int culledTriangles = mesh.getMeshletBounds().cull(model, frustum, cameraPos, ranges);
+		stats.testedMeshlets += mesh.getMeshletBounds().size();
+		stats.culledMeshletTriangles += culledTriangles;
+		triangles -= culledTriangles;
+		rangeCount = (unsigned int) ranges.size() - firstRange;
+		stats.meshletRanges += rangeCount;
+		if (rangeCount == 0) {
+			return;
+		}
+	}
+	stats.drawnTriangles += triangles;
+
+	packets.push_back(DrawPacket{ makeKey(shader, mesh, depth), &shader, &mesh, transform, lod, firstRange, rangeCount });
+}
+
+void RenderQueue::addCulled(unsigned int meshes, unsigned int triangles) {
+	stats.culledMeshes += meshes;
+	stats.culledTriangles += triangles;
+}
+
+uint64_t RenderQueue::makeKey(const Shader& shader, const Mesh& mesh, float depth) const {
+	uint64_t key = 0;
+	for (const KeyLayout::Field& f : layout.fields) {
+		uint64_t mask = (f.bits >= 64) ? ~0ull : ((1ull << f.bits) - 1);
+		uint64_t value = 0;
+		switch (f.field) {
+		case KeyField::Program:
+			value = shader.getID();
+			break;
+		case KeyField::Material:
+			value = mesh.getMaterialID();
+			break;
+		case KeyField::VAO:
+			value = mesh.getVAO();
+			break;
+		case KeyField::Depth:
+			value = (uint64_t) (depth * mask);
+			if (layout.backToFront) value = mask - value;
+			break;
+		}
+		key = (key << f.bits) | (value & mask);
+	}
+	return key;
+}
+
+void RenderQueue::radixSort() {
+	// LSD radix sort on 8-bit digits, all histograms built in one pass
+	size_t count = packets.size();
+	unsigned int histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++) {
+		uint64_t key = packets[i].key;
+		for (int pass = 0; pass < 8; pass++) {
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+		}
+	}
+
+	scratch.resize(count);
+	for (int pass = 0; pass < 8; pass++) {
+		unsigned int* histogram = histograms[pass];
+
+		// every key has the same digit, this pass would not move anything
+		if (histogram[(packets[0].key >> (pass * 8)) & 0xFF] == count) continue;
+
+		unsigned int offset = 0;
+		for (int digit = 0; digit < 256; digit++) {
+			unsigned int n = histogram[digit];
+			histogram[digit] = offset;
+			offset += n;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			unsigned int digit = (packets[i].key >> (pass * 8)) & 0xFF;
+			scratch[histogram[digit]++] = packets[i];
+		}
+		packets.swap(scratch);
+	}
+}
+
+unsigned int RenderQueue::countStateChanges(const std::vector<DrawPacket>& packets) {
+	unsigned int changes = 0;
+	const Shader* currShader = nullptr;
+	unsigned int currMaterial = ~0u;
+	unsigned int currVAO = 0;
+	for (const DrawPacket& p : packets) {
+		if (p.shader != currShader) {
+			currShader = p.shader;
+			currMaterial = ~0u;
+			changes++;
+		}
+		if (p.mesh->getMaterialID() != currMaterial) {
+			currMaterial = p.mesh->getMaterialID();
+			changes++;
+		}
+		if (p.mesh->getVAO() != currVAO) {
+			currVAO = p.mesh->getVAO();
+			changes++;
+		}
+	}
+	return changes;
+}
+
+void RenderQueue::execute() {
+	stats.draws = (unsigned int) packets.size();
+	stats.drawCalls = 0;
+	stats.unsortedStateChanges = countStateChanges(packets);
+	if (packets.empty()) {
+		stats.sortedStateChanges = 0;
+		return;
+	}
+
+	radixSort();
+	stats.sortedStateChanges = countStateChanges(packets);
+
+	Shader* currShader = nullptr;
+	UniformHandle modelUniform;
+	unsigned int currMaterial = ~0u;
+	unsigned int currVAO = 0;
+	const Mesh* currMesh = nullptr;
+	unsigned int currTransform = ~0u;
+	bool batching = false;
+	batcher.resetStats();
+	for (const DrawPacket& p : packets) {
+		// sorted by program first, so these runs are usually next to each other
+		if (batcher.accepts(*p.shader)) {
+			batcher.add(*p.shader, *p.mesh, transforms[p.transform], p.lod, p.rangeCount ? &ranges[p.firstRange] : nullptr, p.rangeCount);
+			batching = true;
+			continue;
+		}
+		// the batcher binds its own program and VAO whenever it flushes, and programs only share
+		// 8 bits of the sort key, so nothing bound before a batched run can be trusted after it
+		if (batching) {
+			batcher.flush();
+			batching = false;
+			currShader = nullptr;
+		}
+		if (p.shader != currShader) {
+			currShader = p.shader;
+			currShader->use();
+
+			auto it = modelUniforms.find(currShader->getID());
+			if (it == modelUniforms.end()) {
+				it = modelUniforms.emplace(currShader->getID(), currShader->getUniform("model")).first;
+			}
+			modelUniform = it->second;
+
+			// samplers, dequantization and the model matrix are per-program state
+			currMaterial = ~0u;
+			currVAO = 0;
+			currMesh = nullptr;
+			currTransform = ~0u;
+		}
+		if (p.mesh->getMaterialID() != currMaterial) {
+			currMaterial = p.mesh->getMaterialID();
+			p.mesh->bindTextures(*currShader);
+		}
+		if (p.mesh->getVAO() != currVAO) {
+			currVAO = p.mesh->getVAO();
+			GLState::bindVertexArray(currVAO);
+		}
+		// meshes share a VAO per heap page, but quantized ones each have their own dequantization
+		if (p.mesh != currMesh) {
+			currMesh = p.mesh;
+			p.mesh->bindVertexFormat(*currShader);
+		}
+		if (p.transform != currTransform) {
+			currTransform = p.transform;
+			currShader->setMat4fv(modelUniform, 1, false, transforms[currTransform]);
+		}
+		if (p.rangeCount > 0) {
+			p.mesh->drawElements(&ranges[p.firstRange], p.rangeCount);
+		}
+		else {
+			p.mesh->drawElements(p.lod);
+		}
+		stats.drawCalls++;
+	}
+	batcher.flush();
+	stats.drawCalls += batcher.getStats().drawCalls;
+}
+
+const RenderQueue::Stats& RenderQueue::getStats() const {
+	return stats;
+}
\ No newline at end of file
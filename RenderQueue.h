@@ -0,0 +1,124 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.h"
+#include "Mesh.h"
+#include "Bounds.h"
+#include "DrawBatcher.h"
+
+// fraction past the pixel error a level has to be before the queue switches away from it
+#define LOD_HYSTERESIS 0.25f
+
+enum class KeyField {
+	Program,
+	Material,
+	VAO,
+	Depth
+};
+
+// Bit layout of a 64-bit sort key, fields listed from most to least
+// significant. Values wider than their field are masked.
+struct KeyLayout {
+	struct Field {
+		KeyField field;
+		unsigned int bits;
+	};
+
+	std::vector<Field> fields;
+	bool backToFront = false;
+
+	// opaque geometry: group by state, then front-to-back inside each group
+	static KeyLayout stateThenDepth();
+	// pure front-to-back, for scenes limited by overdraw rather than state changes
+	static KeyLayout depthThenState();
+};
+
+struct DrawPacket {
+	uint64_t key;
+	Shader* shader;
+	Mesh* mesh;
+	unsigned int transform;
+	unsigned int lod;
+	// what meshlet culling left of the full level in the queue's ranges, none draws the whole level
+	unsigned int firstRange;
+	unsigned int rangeCount;
+};
+
+class RenderQueue {
+public:
+	struct Stats {
+		unsigned int draws = 0;
+		// GL draw calls after batching, equal to draws when nothing was batched
+		unsigned int drawCalls = 0;
+		// program, material and VAO switches in submission order and after sorting
+		unsigned int unsortedStateChanges = 0;
+		unsigned int sortedStateChanges = 0;
+		// meshes rejected by the frustum test and what was left
+		unsigned int culledMeshes = 0;
+		unsigned int culledTriangles = 0;
+		unsigned int drawnTriangles = 0;
+		// meshlets tested and the triangles of those outside the frustum or facing away
+		unsigned int testedMeshlets = 0;
+		unsigned int culledMeshletTriangles = 0;
+		// index ranges drawn for the meshes that went through meshlet culling
+		unsigned int meshletRanges = 0;
+	};
+
+private:
+	KeyLayout layout;
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> scratch;
+	std::vector<glm::mat4> transforms;
+	std::vector<float> transformScales;
+	std::vector<MeshletRange> ranges;
+	std::unordered_map<unsigned int, UniformHandle> modelUniforms;
+	DrawBatcher batcher;
+	glm::mat4 view;
+	glm::vec3 cameraPos;
+	float farPlane;
+	Frustum frustum;
+	bool culling;
+	bool meshletCulling;
+	// screen pixels per world unit at distance 1, 0 draws every mesh at full detail
+	float lodPixelsPerUnit;
+	float lodMaxPixelError;
+	float lodHysteresis;
+	Stats stats;
+
+	uint64_t makeKey(const Shader& shader, const Mesh& mesh, float depth) const;
+	void radixSort();
+	static unsigned int countStateChanges(const std::vector<DrawPacket>& packets);
+
+public:
+	RenderQueue(KeyLayout layout = KeyLayout::stateThenDepth());
+
+	void setLayout(const KeyLayout& layout);
+
+	// clears the queue, depth keys are measured from the camera in view
+	void begin(const glm::mat4& view, float farPlane);
+	// as above, but submit() drops meshes outside frustum
+	void begin(const glm::mat4& view, float farPlane, const Frustum& frustum);
+	// picks mesh levels by how many pixels their error covers at the mesh's distance, for a
+	// projection whose [1][1] is projection11 drawn viewportHeight pixels tall. Kept across begin()
+	void setLodSelection(float projection11, float viewportHeight, float maxPixelError, float hysteresis = LOD_HYSTERESIS);
+	void disableLodSelection();
+	// tests the meshlets of meshes drawn at full detail against the frustum and their normal
+	// cones, and only draws what is left. Needs the begin() that takes a frustum, kept across begin()
+	void setMeshletCulling(bool enabled);
+	unsigned int addTransform(const glm::mat4& model);
+	// lodState, when given, holds the level this mesh drew at last time and is updated, so
+	// hysteresis has something to compare against. Without it every frame starts from level 0
+	void submit(Shader& shader, Mesh& mesh, unsigned int transform, unsigned int* lodState = nullptr);
+	// for meshes culled before reaching the queue, so the stats still see them
+	void addCulled(unsigned int meshes, unsigned int triangles);
+
+	// sorts the packets and issues them, only changing state between packets that differ.
+	// Packets whose program reads per-draw data go through the DrawBatcher instead
+	void execute();
+
+	const Stats& getStats() const;
+};
\ No newline at end of file
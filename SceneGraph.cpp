@@ -0,0 +1,80 @@
+#include "SceneGraph.h"
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Model.h"
+
+SceneGraph::SceneGraph()
+	: pendingStamp(1), firstDirty(0)
+{}
+
+unsigned int SceneGraph::addNode(const glm::mat4& local, int parent) {
+	unsigned int node = (unsigned int) parents.size();
+	this->local.push_back(local);
+	world.push_back(local);
+	parents.push_back((parent >= 0 && (unsigned int) parent < node) ? parent : SCENE_NO_PARENT);
+	stamps.push_back(pendingStamp);
+	firstDirty = std::min(firstDirty, node);
+	return node;
+}
+
+unsigned int SceneGraph::addModel(const Model& model, int parent) {
+	// the model's nodes are already parent first, so their order carries over
+	unsigned int first = size();
+	for (const ModelNode& node : model.getNodes()) {
+		addNode(node.transform, (node.parent >= 0) ? (int) first + node.parent : parent);
+	}
+	return first;
+}
+
+void SceneGraph::clear() {
+	local.clear();
+	world.clear();
+	parents.clear();
+	stamps.clear();
+	firstDirty = 0;
+}
+
+void SceneGraph::setLocal(unsigned int node, const glm::mat4& local) {
+	this->local[node] = local;
+	stamps[node] = pendingStamp;
+	firstDirty = std::min(firstDirty, node);
+}
+
+void SceneGraph::invalidate() {
+	std::fill(stamps.begin(), stamps.end(), pendingStamp);
+	firstDirty = 0;
+}
+
+unsigned int SceneGraph::update() {
+	unsigned int count = size();
+	if (firstDirty >= count) {
+		return 0;
+	}
+
+	// a parent is always done before its children, so dirtiness flows down in the same pass
+	uint32_t stamp = pendingStamp;
+	unsigned int updated = 0;
+	for (unsigned int i = firstDirty; i < count; i++) {
+		int parent = parents[i];
+		if (parent != SCENE_NO_PARENT && stamps[parent] == stamp) {
+			stamps[i] = stamp;
+		}
+		if (stamps[i] != stamp) continue;
+
+		world[i] = (parent != SCENE_NO_PARENT) ? world[parent] * local[i] : local[i];
+		updated++;
+	}
+
+	pendingStamp++;
+	firstDirty = count;
+	return updated;
+}
+
+unsigned int SceneGraph::size() const { return (unsigned int) parents.size(); }
+int SceneGraph::getParent(unsigned int node) const { return parents[node]; }
+const glm::mat4& SceneGraph::getLocal(unsigned int node) const { return local[node]; }
+const glm::mat4& SceneGraph::getWorld(unsigned int node) const { return world[node]; }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#define SCENE_NO_PARENT -1
+
+class Model;
+
+// Transform hierarchy in SoA arrays. A node can only be added under one that already
+// exists, so parents always come before their children and world matrices are brought
+// up to date in one forward pass. Only nodes moved since the last update and everything
+// below them are recomputed, the pass starts at the first of them.
+class SceneGraph {
+private:
+	std::vector<glm::mat4> local;
+	std::vector<glm::mat4> world;
+	std::vector<int> parents;
+	// the update that has to recompute a node, equal to pendingStamp while it is dirty.
+	// Stamps instead of flags, so nothing has to be cleared afterwards
+	std::vector<uint32_t> stamps;
+	uint32_t pendingStamp;
+	unsigned int firstDirty;
+
+public:
+	SceneGraph();
+
+	// local is relative to parent, returns the new node's index
+	unsigned int addNode(const glm::mat4& local, int parent = SCENE_NO_PARENT);
+	// adds the model's node hierarchy under parent, node i of the model becomes the returned index + i
+	unsigned int addModel(const Model& model, int parent = SCENE_NO_PARENT);
+	void clear();
+
+	// marks the node dirty, its world matrix and its subtree's follow on the next update()
+	void setLocal(unsigned int node, const glm::mat4& local);
+	// marks every node dirty, for a full recompute
+	void invalidate();
+	// returns how many world matrices were recomputed
+	unsigned int update();
+
+	unsigned int size() const;
+	int getParent(unsigned int node) const;
+	const glm::mat4& getLocal(unsigned int node) const;
+	// as of the last update()
+	const glm::mat4& getWorld(unsigned int node) const;
+};
\ No newline at end of file
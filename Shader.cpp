@@ -1,12 +1,45 @@
 #include "Shader.h"
+#include "UniformBuffers.h"
+#include "GLState.h"
 #include <glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+
+unsigned int Shader::nameLookups = 0;
+
+void Shader::resetFrameStats() {
+	nameLookups = 0;
+}
+
+// bytes of shadow storage needed for one element of a uniform type
+static unsigned int uniformTypeBytes(GLenum type) {
+	switch (type) {
+	case GL_FLOAT_VEC2:
+	case GL_INT_VEC2:
+		return 8;
+	case GL_FLOAT_VEC3:
+	case GL_INT_VEC3:
+		return 12;
+	case GL_FLOAT_VEC4:
+	case GL_INT_VEC4:
+	case GL_FLOAT_MAT2:
+		return 16;
+	case GL_FLOAT_MAT3:
+		return 36;
+	case GL_FLOAT_MAT4:
+		return 64;
+	default:
+		// scalars, bools and samplers
+		return 4;
+	}
+}
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath) 
 	: ID(glCreateProgram())
@@ -73,35 +106,171 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
+
+	reflectUniforms();
+	bindUniformBlocks();
+}
+
+void Shader::reflectUniforms() {
+	int numUniforms, maxNameLength;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &numUniforms);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer(maxNameLength + 1);
+	for (int i = 0; i < numUniforms; i++) {
+		int length, size;
+		GLenum type;
+		glGetActiveUniform(ID, i, (GLsizei) nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+		std::string name(nameBuffer.data(), length);
+
+		UniformHandle uniform;
+		uniform.location = glGetUniformLocation(ID, name.c_str());
+		uniform.type = type;
+		uniform.size = size;
+		// uniforms inside blocks have no location
+		if (uniform.location < 0) continue;
+
+		// arrays are reported as "name[0]", register "name" and every element
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+			std::string base = name.substr(0, name.size() - 3);
+			for (int j = 0; j < size; j++) {
+				std::string elementName = base + "[" + std::to_string(j) + "]";
+				UniformHandle element{ glGetUniformLocation(ID, elementName.c_str()), type, size - j, addShadowSlot(type) };
+				uniforms[elementName] = element;
+			}
+			uniform.slot = uniforms[base + "[0]"].slot;
+			uniforms[base] = uniform;
+		}
+		else {
+			uniform.slot = addShadowSlot(type);
+			uniforms[name] = uniform;
+		}
+	}
+}
+
+int Shader::addShadowSlot(unsigned int type) {
+	shadowSlots.push_back(ShadowSlot{ (unsigned int) shadowValues.size(), uniformTypeBytes(type), false });
+	shadowValues.resize(shadowValues.size() + uniformTypeBytes(type));
+	return (int) shadowSlots.size() - 1;
+}
+
+bool Shader::uniformChanged(const UniformHandle& uniform, const void* value, unsigned int bytes) {
+	if (uniform.location < 0) return false;
+	if (uniform.slot < 0 || bytes > shadowSlots[uniform.slot].bytes) {
+		GLState::stats.uniformsIssued++;
+		return true;
+	}
+
+	ShadowSlot& slot = shadowSlots[uniform.slot];
+	unsigned char* shadow = &shadowValues[slot.offset];
+	if (slot.written && std::memcmp(shadow, value, bytes) == 0) {
+		GLState::stats.uniformsFiltered++;
+		return false;
+	}
+	std::memcpy(shadow, value, bytes);
+	slot.written = true;
+	GLState::stats.uniformsIssued++;
+	return true;
+}
+
+void Shader::bindUniformBlocks() {
+	int numBlocks, maxNameLength;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &numBlocks);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer(maxNameLength + 1);
+	for (int i = 0; i < numBlocks; i++) {
+		int length;
+		glGetActiveUniformBlockName(ID, i, (GLsizei) nameBuffer.size(), &length, nameBuffer.data());
+
+		int binding = uniformBlockBinding(std::string(nameBuffer.data(), length));
+		if (binding < 0) {
+			std::cout << "ERROR::SHADER::UNKNOWN_UNIFORM_BLOCK: " << nameBuffer.data() << std::endl;
+			continue;
+		}
+		glUniformBlockBinding(ID, i, binding);
+	}
 }
 
 void Shader::use() {
-	glUseProgram(ID);
+	GLState::useProgram(ID);
+}
+
+unsigned int Shader::getID() const {
+	return ID;
+}
+
+UniformHandle Shader::getUniform(const std::string& name) {
+	nameLookups++;
+	auto it = uniforms.find(name);
+	return (it == uniforms.end()) ? UniformHandle{} : it->second;
 }
 
 void Shader::setBool(const std::string& name, bool value) {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int) value);
+	setBool(getUniform(name), value);
 }
 
 void Shader::setFloat(const std::string& name, float value) {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	setFloat(getUniform(name), value);
 }
 
 void Shader::setInt(const std::string& name, int value) {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	setInt(getUniform(name), value);
 }
 
 void Shader::set3fv(const std::string& name, int count, glm::vec3 value) {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), count, glm::value_ptr(value));
+	set3fv(getUniform(name), count, value);
 }
 
 void Shader::set4fv(const std::string& name, int count, glm::vec4 value) {
-	glUniform4fv(glGetUniformLocation(ID, name.c_str()), count, glm::value_ptr(value));
+	set4fv(getUniform(name), count, value);
 }
 void Shader::set4f(const std::string& name, float f1, float f2, float f3, float f4) {
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), f1, f2, f3, f4);
+	set4f(getUniform(name), f1, f2, f3, f4);
 }
 
 void Shader::setMat4fv(const std::string& name, int count, bool transpose, glm::mat4 value) {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), count, transpose, glm::value_ptr(value));
+	setMat4fv(getUniform(name), count, transpose, value);
+}
+
+// handle setters skip the call when the program already holds the value
+void Shader::setBool(UniformHandle uniform, bool value) {
+	setInt(uniform, (int) value);
+}
+
+void Shader::setFloat(UniformHandle uniform, float value) {
+	if (!uniformChanged(uniform, &value, sizeof(float))) return;
+	glUniform1f(uniform.location, value);
+}
+
+void Shader::setInt(UniformHandle uniform, int value) {
+	if (!uniformChanged(uniform, &value, sizeof(int))) return;
+	glUniform1i(uniform.location, value);
+}
+
+void Shader::set3fv(UniformHandle uniform, int count, const glm::vec3& value) {
+	if (!uniformChanged(uniform, glm::value_ptr(value), count * sizeof(glm::vec3))) return;
+	glUniform3fv(uniform.location, count, glm::value_ptr(value));
+}
+
+void Shader::set4fv(UniformHandle uniform, int count, const glm::vec4& value) {
+	if (!uniformChanged(uniform, glm::value_ptr(value), count * sizeof(glm::vec4))) return;
+	glUniform4fv(uniform.location, count, glm::value_ptr(value));
+}
+
+void Shader::set4f(UniformHandle uniform, float f1, float f2, float f3, float f4) {
+	float value[4]{ f1, f2, f3, f4 };
+	if (!uniformChanged(uniform, value, sizeof(value))) return;
+	glUniform4f(uniform.location, f1, f2, f3, f4);
+}
+
+void Shader::setMat4fv(UniformHandle uniform, int count, bool transpose, const glm::mat4& value) {
+	// transposed uploads are rare, do not let them alias the cached value
+	if (transpose) {
+		if (uniform.slot >= 0) shadowSlots[uniform.slot].written = false;
+	}
+	else if (!uniformChanged(uniform, glm::value_ptr(value), count * sizeof(glm::mat4))) {
+		return;
+	}
+	glUniformMatrix4fv(uniform.location, count, transpose, glm::value_ptr(value));
 }
\ No newline at end of file
@@ -2,14 +2,49 @@
 
 #include <glm/glm.hpp>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+// location of an active uniform, resolved once when the program is linked
+struct UniformHandle {
+	int location = -1;
+	unsigned int type = 0;
+	int size = 0;
+	// index of the shadow copy of the last value written, -1 if not tracked
+	int slot = -1;
+
+	bool isValid() const { return location >= 0; }
+};
 
 class Shader {
 private:
+	struct ShadowSlot {
+		unsigned int offset;
+		unsigned int bytes;
+		bool written;
+	};
+
 	const unsigned int ID;
+	std::unordered_map<std::string, UniformHandle> uniforms;
+	std::vector<ShadowSlot> shadowSlots;
+	std::vector<unsigned char> shadowValues;
+
+	void reflectUniforms();
+	void bindUniformBlocks();
+	int addShadowSlot(unsigned int type);
+	bool uniformChanged(const UniformHandle& uniform, const void* value, unsigned int bytes);
+
 public:
+	// number of name-based uniform lookups since the last resetFrameStats()
+	static unsigned int nameLookups;
+	static void resetFrameStats();
+
 	Shader(const char* vertexPath, const char* fragmentPath);
 
 	void use();
+	unsigned int getID() const;
+
+	UniformHandle getUniform(const std::string& name);
 
 	void setBool(const std::string& name, bool value);
 	void setFloat(const std::string& name, float value);
@@ -19,4 +54,14 @@ public:
 	void set4fv(const std::string& name, int count, glm::vec4 value);
 	void set4f(const std::string& name, float f1, float f2, float f3, float f4);
 	void setMat4fv(const std::string& name, int count, bool transpose, glm::mat4 value);
+
+	// handle based setters, no string building or hashing
+	void setBool(UniformHandle uniform, bool value);
+	void setFloat(UniformHandle uniform, float value);
+	void setInt(UniformHandle uniform, int value);
+
+	void set3fv(UniformHandle uniform, int count, const glm::vec3& value);
+	void set4fv(UniformHandle uniform, int count, const glm::vec4& value);
+	void set4f(UniformHandle uniform, float f1, float f2, float f3, float f4);
+	void setMat4fv(UniformHandle uniform, int count, bool transpose, const glm::mat4& value);
 };
\ No newline at end of file
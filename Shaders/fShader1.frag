@@ -1,5 +1,5 @@
 #version 330 core
-#define NUM_POINT_LIGHTS 1
+#define MAX_POINT_LIGHTS 4
 
 out vec4 FragColor;
 
@@ -10,9 +10,9 @@ struct Material {
 	float shininess;
 };
 
+// std140 layouts mirrored in UniformBuffers.h, scalars fill the vec3 padding
 struct DirLight {
 	vec3 direction;
-
 	vec3 ambient;
 	vec3 diffuse;
 	vec3 specular;
@@ -20,41 +20,46 @@ struct DirLight {
 
 struct PointLight {
 	vec3 position;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-
 	float constant;
+	vec3 ambient;
 	float linear;
+	vec3 diffuse;
 	float quadratic;
+	vec3 specular;
 };
 
 struct SpotLight {
 	vec3 position;
-	vec3 direction;
 	float cutoff;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-
+	vec3 direction;
 	float constant;
+	vec3 ambient;
 	float linear;
+	vec3 diffuse;
 	float quadratic;
+	vec3 specular;
 };
 
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+in vec4 Tint;
 
-uniform DirLight dirLight;
-uniform PointLight pntLights[NUM_POINT_LIGHTS];
-uniform SpotLight spotLight;
+layout (std140) uniform FrameUniforms {
+	mat4 view;
+	mat4 projection;
+	vec3 viewPos;
+	float time;
+};
+
+layout (std140) uniform LightUniforms {
+	DirLight dirLight;
+	SpotLight spotLight;
+	PointLight pntLights[MAX_POINT_LIGHTS];
+	int numPointLights;
+};
 
 uniform Material material;
-uniform vec3 viewPos;
-uniform float time;
 
 vec3 CalcDirLight(DirLight light, vec3 norm, vec3 diffuseColor, vec3 specColor, vec3 viewDir) {
 	// ambient
@@ -136,7 +141,7 @@ void main() {
 	vec3 result = vec3(0.0f);
 	result += CalcDirLight(dirLight, norm, diffuseColor, specColor, viewDir);
 	result += CalcSpotLight(spotLight, norm, diffuseColor, specColor, viewDir, FragPos);
-	for (int i = 0; i < NUM_POINT_LIGHTS; i++) {
+	for (int i = 0; i < numPointLights; i++) {
 		result += CalcPointLight(pntLights[i], norm, diffuseColor, specColor, viewDir, FragPos);
 	}
 
@@ -144,5 +149,5 @@ void main() {
 	// vec3 emission = abs(sin(time)) * (texture(material.texture_specular1, TexCoords).rgb == vec3(0.0f) ? texture(material.emission, TexCoords).rgb : vec3(0.0f));
 
 	// FragColor = vec4(result + emission, 1.0);
-	FragColor = vec4(result, 1.0);
+	FragColor = vec4(result, 1.0) * Tint;
 }
\ No newline at end of file
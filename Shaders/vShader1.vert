@@ -6,14 +6,38 @@ layout (location = 2) in vec2 aTexCoords;
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+out vec4 Tint;
+
+layout (std140) uniform FrameUniforms {
+	mat4 view;
+	mat4 projection;
+	vec3 viewPos;
+	float time;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// quantized meshes set these, the defaults pass float vertices through untouched
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionOffset = vec3(0.0);
+uniform bool octahedralNormals = false;
+
+// octahedral normals arrive as xy in [-1, 1], z is left at 0 by the attribute fetch
+vec3 decodeNormal(vec3 n) {
+	if (!octahedralNormals) {
+		return n;
+	}
+	vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+	float t = max(-v.z, 0.0);
+	v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+	return normalize(v);
+}
 
 void main() {
-	gl_Position = projection * view * model * vec4(aPos.xyz, 1.0);
-	FragPos = vec3(model * vec4(aPos.xyz, 1.0));
-	Normal = mat3(transpose(inverse(model))) * aNormal;
+	vec3 position = aPos * positionScale + positionOffset;
+	gl_Position = projection * view * model * vec4(position, 1.0);
+	FragPos = vec3(model * vec4(position, 1.0));
+	Normal = mat3(transpose(inverse(model))) * decodeNormal(aNormal);
 	TexCoords = aTexCoords;
+	Tint = vec4(1.0);
 }
\ No newline at end of file
@@ -7,9 +7,14 @@ out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
+layout (std140) uniform FrameUniforms {
+	mat4 view;
+	mat4 projection;
+	vec3 viewPos;
+	float time;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main() {
 	gl_Position = projection * view * model * vec4(aPos.xyz, 1.0);
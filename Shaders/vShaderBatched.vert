@@ -0,0 +1,56 @@
+#version 330 core
+#extension GL_ARB_shader_draw_parameters : enable
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+out vec4 Tint;
+
+layout (std140) uniform FrameUniforms {
+	mat4 view;
+	mat4 projection;
+	vec3 viewPos;
+	float time;
+};
+
+// six texels per draw, written by DrawBatcher: the model matrix columns,
+// then positionScale with the octahedral flag in w, then positionOffset
+uniform samplerBuffer drawData;
+// first draw of the current batch
+uniform int drawBase;
+
+#ifdef GL_ARB_shader_draw_parameters
+#define DRAW_INDEX (drawBase + gl_DrawIDARB)
+#else
+// without draw parameters every draw is its own call and sets drawIndex
+uniform int drawIndex;
+#define DRAW_INDEX (drawBase + drawIndex)
+#endif
+
+vec3 decodeNormal(vec3 n, bool octahedral) {
+	if (!octahedral) {
+		return n;
+	}
+	vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+	float t = max(-v.z, 0.0);
+	v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+	return normalize(v);
+}
+
+void main() {
+	int texel = DRAW_INDEX * 6;
+	mat4 model = mat4(texelFetch(drawData, texel), texelFetch(drawData, texel + 1),
+		texelFetch(drawData, texel + 2), texelFetch(drawData, texel + 3));
+	vec4 positionScale = texelFetch(drawData, texel + 4);
+	vec3 positionOffset = texelFetch(drawData, texel + 5).xyz;
+
+	vec3 position = aPos * positionScale.xyz + positionOffset;
+	gl_Position = projection * view * model * vec4(position, 1.0);
+	FragPos = vec3(model * vec4(position, 1.0));
+	Normal = mat3(transpose(inverse(model))) * decodeNormal(aNormal, positionScale.w != 0.0);
+	TexCoords = aTexCoords;
+	Tint = vec4(1.0);
+}
\ No newline at end of file
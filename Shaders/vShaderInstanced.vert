@@ -0,0 +1,28 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in vec4 aTint;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+out vec4 Tint;
+
+layout (std140) uniform FrameUniforms {
+	mat4 view;
+	mat4 projection;
+	vec3 viewPos;
+	float time;
+};
+
+void main() {
+	gl_Position = projection * view * aModel * vec4(aPos.xyz, 1.0);
+	FragPos = vec3(aModel * vec4(aPos.xyz, 1.0));
+	// instances only use rotation, translation and uniform scale, so skip the
+	// per-vertex inverse and let the fragment shader renormalize
+	Normal = mat3(aModel) * aNormal;
+	TexCoords = aTexCoords;
+	Tint = aTint;
+}
\ No newline at end of file
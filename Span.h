@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+// Non-owning view of a contiguous array, so functions can take a range of
+// elements without copying them or caring what container holds them.
+template <typename T>
+class Span {
+private:
+	T* first;
+	size_t count;
+
+public:
+	Span() : first(nullptr), count(0) {}
+	Span(T* data, size_t size) : first(data), count(size) {}
+	// anything with data() and size(), a std::vector usually
+	template <typename Container>
+	Span(Container& container) : first(container.data()), count(container.size()) {}
+
+	T* data() const { return first; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	T* begin() const { return first; }
+	T* end() const { return first + count; }
+	T& operator[](size_t i) const { return first[i]; }
+};
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "TLSFAllocator.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static unsigned int highestBit(unsigned int x) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, x);
+	return index;
+#else
+	return 31 - __builtin_clz(x);
+#endif
+}
+
+static unsigned int lowestBit(unsigned int x) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, x);
+	return index;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+// sizes below TLSF_SL_COUNT get a bin each, above that every power of two is split TLSF_SL_COUNT ways
+static void mapping(unsigned int size, unsigned int& fl, unsigned int& sl) {
+	if (size < TLSF_SL_COUNT) {
+		fl = 0;
+		sl = size;
+	}
+	else {
+		unsigned int top = highestBit(size);
+		fl = top - TLSF_SL_BITS + 1;
+		sl = (size >> (top - TLSF_SL_BITS)) ^ TLSF_SL_COUNT;
+	}
+}
+
+TLSFAllocator::TLSFAllocator(unsigned int capacity) {
+	reset(capacity);
+}
+
+void TLSFAllocator::reset(unsigned int capacity) {
+	blocks.clear();
+	unusedBlocks.clear();
+	flBitmap = 0;
+	std::fill(slBitmaps, slBitmaps + TLSF_FL_COUNT, 0u);
+	std::fill(&bins[0][0], &bins[0][0] + TLSF_FL_COUNT * TLSF_SL_COUNT, NO_SPACE);
+	this->capacity = capacity;
+	used = 0;
+	freeBlocks = 0;
+
+	if (capacity > 0) {
+		unsigned int block = newBlock();
+		blocks[block] = Block{ 0, capacity, NO_SPACE, NO_SPACE, NO_SPACE, NO_SPACE, true };
+		insertFree(block);
+	}
+}
+
+unsigned int TLSFAllocator::newBlock() {
+	if (!unusedBlocks.empty()) {
+		unsigned int block = unusedBlocks.back();
+		unusedBlocks.pop_back();
+		return block;
+	}
+	blocks.push_back(Block{});
+	return (unsigned int) blocks.size() - 1;
+}
+
+void TLSFAllocator::insertFree(unsigned int block) {
+	unsigned int fl, sl;
+	mapping(blocks[block].size, fl, sl);
+
+	Block& b = blocks[block];
+	b.free = true;
+	b.prevFree = NO_SPACE;
+	b.nextFree = bins[fl][sl];
+	if (b.nextFree != NO_SPACE) blocks[b.nextFree].prevFree = block;
+	bins[fl][sl] = block;
+
+	flBitmap |= 1u << fl;
+	slBitmaps[fl] |= 1u << sl;
+	freeBlocks++;
+}
+
+void TLSFAllocator::removeFree(unsigned int block) {
+	unsigned int fl, sl;
+	mapping(blocks[block].size, fl, sl);
+
+	Block& b = blocks[block];
+	if (b.prevFree != NO_SPACE) blocks[b.prevFree].nextFree = b.nextFree;
+	else bins[fl][sl] = b.nextFree;
+	if (b.nextFree != NO_SPACE) blocks[b.nextFree].prevFree = b.prevFree;
+	b.free = false;
+
+	if (bins[fl][sl] == NO_SPACE) {
+		slBitmaps[fl] &= ~(1u << sl);
+		if (slBitmaps[fl] == 0) flBitmap &= ~(1u << fl);
+	}
+	freeBlocks--;
+}
+
+unsigned int TLSFAllocator::findFree(unsigned int size) {
+	// round up to the next bin so any block found there fits without walking the list
+	unsigned long long rounded = size;
+	if (size >= TLSF_SL_COUNT) rounded += (1ull << (highestBit(size) - TLSF_SL_BITS)) - 1;
+
+	if (rounded <= ~0u) {
+		unsigned int fl, sl;
+		mapping((unsigned int) rounded, fl, sl);
+		unsigned int slMap = slBitmaps[fl] & (~0u << sl);
+		if (slMap == 0) {
+			unsigned int flMap = (fl + 1 < TLSF_FL_COUNT) ? flBitmap & (~0u << (fl + 1)) : 0;
+			if (flMap != 0) {
+				fl = lowestBit(flMap);
+				slMap = slBitmaps[fl];
+			}
+		}
+		if (slMap != 0) {
+			unsigned int block = bins[fl][lowestBit(slMap)];
+			removeFree(block);
+			return block;
+		}
+	}
+
+	// nothing in the larger bins, but the size's own bin may still hold a block that fits
+	unsigned int fl, sl;
+	mapping(size, fl, sl);
+	for (unsigned int block = bins[fl][sl]; block != NO_SPACE; block = blocks[block].nextFree) {
+		if (blocks[block].size >= size) {
+			removeFree(block);
+			return block;
+		}
+	}
+	return NO_SPACE;
+}
+
+unsigned int TLSFAllocator::allocate(unsigned int size) {
+	size = std::max(size, 1u);
+	unsigned int block = findFree(size);
+	if (block == NO_SPACE) return NO_SPACE;
+
+	// the tail goes back on the free lists
+	if (blocks[block].size > size) {
+		unsigned int rest = newBlock();
+		Block& b = blocks[block];
+		blocks[rest] = Block{ b.offset + size, b.size - size, block, b.nextPhysical, NO_SPACE, NO_SPACE, true };
+		if (b.nextPhysical != NO_SPACE) blocks[b.nextPhysical].prevPhysical = rest;
+		b.nextPhysical = rest;
+		b.size = size;
+		insertFree(rest);
+	}
+
+	used += size;
+	return block;
+}
+
+void TLSFAllocator::free(unsigned int block) {
+	used -= blocks[block].size;
+
+	unsigned int prev = blocks[block].prevPhysical;
+	if (prev != NO_SPACE && blocks[prev].free) {
+		removeFree(prev);
+		blocks[prev].size += blocks[block].size;
+		blocks[prev].nextPhysical = blocks[block].nextPhysical;
+		if (blocks[block].nextPhysical != NO_SPACE) blocks[blocks[block].nextPhysical].prevPhysical = prev;
+		unusedBlocks.push_back(block);
+		block = prev;
+	}
+
+	unsigned int next = blocks[block].nextPhysical;
+	if (next != NO_SPACE && blocks[next].free) {
+		removeFree(next);
+		blocks[block].size += blocks[next].size;
+		blocks[block].nextPhysical = blocks[next].nextPhysical;
+		if (blocks[next].nextPhysical != NO_SPACE) blocks[blocks[next].nextPhysical].prevPhysical = block;
+		unusedBlocks.push_back(next);
+	}
+
+	insertFree(block);
+}
+
+unsigned int TLSFAllocator::getOffset(unsigned int block) const { return blocks[block].offset; }
+unsigned int TLSFAllocator::getSize(unsigned int block) const { return blocks[block].size; }
+unsigned int TLSFAllocator::getCapacity() const { return capacity; }
+unsigned int TLSFAllocator::getUsed() const { return used; }
+
+FreeSpaceStats TLSFAllocator::getStats() const {
+	FreeSpaceStats stats{ capacity, used, freeBlocks, 0 };
+	if (flBitmap == 0) return stats;
+
+	// the largest block is somewhere in the highest non-empty bin
+	unsigned int fl = highestBit(flBitmap);
+	unsigned int sl = highestBit(slBitmaps[fl]);
+	for (unsigned int block = bins[fl][sl]; block != NO_SPACE; block = blocks[block].nextFree) {
+		stats.largestFree = std::max(stats.largestFree, blocks[block].size);
+	}
+	return stats;
+}
\ No newline at end of file
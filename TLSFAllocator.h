@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+// second level bins per power of two, 16 keeps the worst case waste of a good fit under 1/16th
+#define TLSF_SL_BITS 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_BITS)
+#define TLSF_FL_COUNT 32
+
+struct FreeSpaceStats {
+	unsigned int capacity;
+	unsigned int used;
+	unsigned int freeBlocks;
+	unsigned int largestFree;
+};
+
+// Two level segregated fit (Masmano et al. 2004) over a range of abstract units, it never
+// touches the memory it manages. Free blocks sit in bins indexed by their size's top bits, two
+// bitmaps find a big enough bin in constant time and neighbours merge back on free.
+// Allocations are identified by a block id, offsets only change through reset().
+class TLSFAllocator {
+public:
+	static constexpr unsigned int NO_SPACE = ~0u;
+
+private:
+	struct Block {
+		unsigned int offset;
+		unsigned int size;
+		// neighbours in address order
+		unsigned int prevPhysical, nextPhysical;
+		// links within the bin, only while free
+		unsigned int prevFree, nextFree;
+		bool free;
+	};
+
+	std::vector<Block> blocks;
+	// block records that no longer describe any range, reused before the vector grows
+	std::vector<unsigned int> unusedBlocks;
+	unsigned int flBitmap;
+	unsigned int slBitmaps[TLSF_FL_COUNT];
+	unsigned int bins[TLSF_FL_COUNT][TLSF_SL_COUNT];
+	unsigned int capacity;
+	unsigned int used;
+	unsigned int freeBlocks;
+
+	unsigned int newBlock();
+	void insertFree(unsigned int block);
+	void removeFree(unsigned int block);
+	// the first block at least size units long, removed from its bin
+	unsigned int findFree(unsigned int size);
+
+public:
+	TLSFAllocator(unsigned int capacity = 0);
+
+	// forgets every allocation and starts over with one free block
+	void reset(unsigned int capacity);
+
+	// returns a block id, or NO_SPACE when no free block is large enough
+	unsigned int allocate(unsigned int size);
+	void free(unsigned int block);
+
+	unsigned int getOffset(unsigned int block) const;
+	unsigned int getSize(unsigned int block) const;
+	unsigned int getCapacity() const;
+	unsigned int getUsed() const;
+	FreeSpaceStats getStats() const;
+};
\ No newline at end of file
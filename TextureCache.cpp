@@ -0,0 +1,128 @@
+#include "TextureCache.h"
+#include <glad.h>
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "GLState.h"
+#include "MappedFile.h"
+#include "TextureStreamer.h"
+#include "TextureData.h"
+
+std::unordered_map<std::string, std::weak_ptr<const CachedTexture>> TextureCache::byPath;
+std::unordered_map<uint64_t, std::weak_ptr<const CachedTexture>> TextureCache::byContent;
+TextureCache::Stats TextureCache::stats{};
+
+// FNV-1a over 8 byte words, a hit is confirmed byte for byte so speed matters more than mixing
+static uint64_t contentHash(const unsigned char* data, size_t size) {
+	uint64_t hash = 14695981039346656037ull ^ size;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, data + i, 8);
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	for (; i < size; i++) {
+		hash = (hash ^ data[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+static unsigned int textureFromFile(const std::string& filePath) {
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+
+	TextureData data;
+	if (loadTextureData(filePath, data, isBlockCompressionSupported(), NULL)) {
+		GLState::bindTexture(0, textureID);
+		uploadTextureData(data, data.bytes.data());
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	else {
+		std::cout << "Could not load texture from \"" << filePath << "\"" << std::endl;
+	}
+	std::cout << "Loading " << filePath << std::endl;
+
+	return textureID;
+}
+
+TextureCache::Handle TextureCache::acquire(const std::string& path, const glm::vec4& placeholder, TextureStreamer* streamer) {
+	std::error_code error;
+	std::string canonical = std::filesystem::weakly_canonical(path, error).string();
+	if (error) canonical = path;
+
+	auto pathIt = byPath.find(canonical);
+	if (pathIt != byPath.end()) {
+		if (Handle texture = pathIt->second.lock()) {
+			stats.pathHits++;
+			stats.bytesShared += texture->fileBytes;
+			return texture;
+		}
+	}
+
+	// a different name can still be the same image, compare contents before loading
+	MappedFile file;
+	uint64_t hash = 0;
+	size_t fileBytes = 0;
+	if (file.open(canonical)) {
+		hash = contentHash(file.data(), file.size());
+		fileBytes = file.size();
+
+		auto contentIt = byContent.find(hash);
+		Handle texture = (contentIt != byContent.end()) ? contentIt->second.lock() : nullptr;
+		MappedFile other;
+		if (texture && texture->fileBytes == fileBytes && other.open(texture->path)
+			&& other.size() == fileBytes && std::memcmp(other.data(), file.data(), fileBytes) == 0) {
+			byPath[canonical] = texture;
+			stats.contentHits++;
+			stats.bytesShared += fileBytes;
+			return texture;
+		}
+	}
+	file.close();
+
+	CachedTexture* loaded = new CachedTexture{ 0, canonical, hash, fileBytes, streamer };
+	loaded->id = streamer ? streamer->request(canonical, placeholder) : textureFromFile(canonical);
+	Handle texture{ loaded, &TextureCache::destroy };
+
+	byPath[canonical] = texture;
+	if (fileBytes > 0) {
+		byContent[hash] = texture;
+	}
+	stats.misses++;
+	stats.live++;
+	stats.bytesLoaded += fileBytes;
+	return texture;
+}
+
+void TextureCache::clear() {
+	if (stats.live > 0) {
+		std::cout << "ERROR::TEXTURE_CACHE::TEXTURES_STILL_HELD " << stats.live << std::endl;
+	}
+	byPath.clear();
+	byContent.clear();
+}
+
+void TextureCache::destroy(CachedTexture* texture) {
+	// aliases under other paths stay behind expired and are replaced when those paths load again
+	auto pathIt = byPath.find(texture->path);
+	if (pathIt != byPath.end() && pathIt->second.expired()) {
+		byPath.erase(pathIt);
+	}
+	auto contentIt = byContent.find(texture->hash);
+	if (contentIt != byContent.end() && contentIt->second.expired()) {
+		byContent.erase(contentIt);
+	}
+
+	if (texture->streamer) texture->streamer->cancel(texture->id);
+	GLState::textureDeleted(texture->id);
+	glDeleteTextures(1, &texture->id);
+	stats.live--;
+	delete texture;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class TextureStreamer;
+
+struct CachedTexture {
+	unsigned int id;
+	std::string path;
+	uint64_t hash;
+	size_t fileBytes;
+	// set when the image may still be streaming in, it has to outlive the handle
+	TextureStreamer* streamer;
+};
+
+// Process wide cache of GL textures, keyed by canonical path and by a hash of
+// the file contents so the same image under two names is only loaded once.
+// Entries live as long as someone holds their handle. GL thread only.
+class TextureCache {
+public:
+	typedef std::shared_ptr<const CachedTexture> Handle;
+
+	struct Stats {
+		unsigned int pathHits = 0;
+		unsigned int contentHits = 0;
+		unsigned int misses = 0;
+		unsigned int live = 0;
+		// encoded file bytes read for misses, and what the hits did not have to read
+		size_t bytesLoaded = 0;
+		size_t bytesShared = 0;
+	};
+
+private:
+	static std::unordered_map<std::string, std::weak_ptr<const CachedTexture>> byPath;
+	static std::unordered_map<uint64_t, std::weak_ptr<const CachedTexture>> byContent;
+
+	static void destroy(CachedTexture* texture);
+
+public:
+	static Stats stats;
+
+	// with a streamer the texture arrives asynchronously behind a placeholder,
+	// otherwise it is decoded and uploaded before this returns
+	static Handle acquire(const std::string& path, const glm::vec4& placeholder, TextureStreamer* streamer);
+	// forgets every entry, call it before the context goes. Textures still held
+	// past that would be deleted without a context, so they are reported
+	static void clear();
+};
\ No newline at end of file
@@ -0,0 +1,289 @@
+#include "TextureData.h"
+#include <glad.h>
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "MappedFile.h"
+#include "MipChain.h"
+#include "JobSystem.h"
+
+// S3TC is an extension, the loader may not have been generated with it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const char KTX_SOURCE_KEY[] = "SDLGL.source";
+// bumped whenever the texels written for the same source would change
+#define KTX_PIPELINE_VERSION 2
+
+struct KTXHeader {
+	unsigned char identifier[12];
+	uint32_t endianness;
+	uint32_t glType;
+	uint32_t glTypeSize;
+	uint32_t glFormat;
+	uint32_t glInternalFormat;
+	uint32_t glBaseInternalFormat;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t numberOfArrayElements;
+	uint32_t numberOfFaces;
+	uint32_t numberOfMipmapLevels;
+	uint32_t bytesOfKeyValueData;
+};
+
+static std::string sourceStampString(const std::string& sourcePath) {
+	uint64_t size;
+	int64_t time;
+	if (!getFileStamp(sourcePath, size, time)) return "";
+	return "v" + std::to_string(KTX_PIPELINE_VERSION) + " " + std::to_string(size) + " " + std::to_string(time);
+}
+
+// uncompressed KTX rows are padded to four bytes
+static size_t ktxRowBytes(const TextureLevel& level, size_t texelBytes) {
+	return ((size_t) level.width * texelBytes + 3) & ~(size_t) 3;
+}
+
+static size_t formatChannels(unsigned int format) {
+	return (format == GL_RED) ? 1 : (format == GL_RG) ? 2 : (format == GL_RGB) ? 3 : 4;
+}
+
+bool readKTX(const std::string& path, const std::string& sourcePath, TextureData& texture) {
+	MappedFile file;
+	if (!file.open(path) || file.size() < sizeof(KTXHeader)) return false;
+
+	KTXHeader header;
+	std::memcpy(&header, file.data(), sizeof(KTXHeader));
+	if (std::memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 || header.endianness != 0x04030201
+		|| (header.glType != 0 && header.glType != GL_UNSIGNED_BYTE) || header.pixelDepth != 0 || header.numberOfArrayElements != 0 || header.numberOfFaces != 1
+		|| header.numberOfMipmapLevels == 0 || header.bytesOfKeyValueData > file.size() - sizeof(KTXHeader)) {
+		return false;
+	}
+
+	// only trusted while the source it was made from is unchanged, a missing source is fine
+	std::string expected = sourceStampString(sourcePath);
+	bool fresh = expected.empty();
+	size_t offset = sizeof(KTXHeader);
+	size_t keyValueEnd = offset + header.bytesOfKeyValueData;
+	while (offset + 4 <= keyValueEnd) {
+		uint32_t pairBytes;
+		std::memcpy(&pairBytes, file.data() + offset, 4);
+		if (pairBytes > keyValueEnd - offset - 4) return false;
+		const char* pair = (const char*) file.data() + offset + 4;
+		if (pairBytes > sizeof(KTX_SOURCE_KEY) && std::memcmp(pair, KTX_SOURCE_KEY, sizeof(KTX_SOURCE_KEY)) == 0) {
+			std::string value(pair + sizeof(KTX_SOURCE_KEY), strnlen(pair + sizeof(KTX_SOURCE_KEY), pairBytes - sizeof(KTX_SOURCE_KEY)));
+			fresh = fresh || value == expected;
+		}
+		offset += 4 + ((pairBytes + 3) & ~3u);
+	}
+	if (!fresh) return false;
+
+	offset = keyValueEnd;
+	texture.internalFormat = header.glInternalFormat;
+	texture.compressed = header.glType == 0;
+	texture.format = texture.compressed ? 0 : header.glFormat;
+	size_t texelBytes = formatChannels(texture.format);
+	texture.levels.clear();
+	texture.bytes.clear();
+	int width = (int) header.pixelWidth, height = (int) header.pixelHeight;
+	for (uint32_t i = 0; i < header.numberOfMipmapLevels; i++) {
+		uint32_t imageSize;
+		if (file.size() - offset < 4) return false;
+		std::memcpy(&imageSize, file.data() + offset, 4);
+		offset += 4;
+		if (imageSize > file.size() - offset) return false;
+
+		TextureLevel level{ width, height, texture.bytes.size(), imageSize };
+		if (texture.compressed) {
+			texture.bytes.insert(texture.bytes.end(), file.data() + offset, file.data() + offset + imageSize);
+		}
+		else {
+			// drop the row padding, uploads are tightly packed
+			size_t rowBytes = ktxRowBytes(level, texelBytes);
+			if ((size_t) imageSize != rowBytes * height) return false;
+			level.size = (size_t) width * height * texelBytes;
+			for (int y = 0; y < height; y++) {
+				const unsigned char* row = file.data() + offset + y * rowBytes;
+				texture.bytes.insert(texture.bytes.end(), row, row + width * texelBytes);
+			}
+		}
+		texture.levels.push_back(level);
+		offset += (imageSize + 3) & ~3u;
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	return true;
+}
+
+bool writeKTX(const std::string& path, const std::string& sourcePath, const TextureData& texture) {
+	if (texture.levels.empty()) return false;
+
+	std::string value = sourceStampString(sourcePath);
+	uint32_t pairBytes = (uint32_t) (sizeof(KTX_SOURCE_KEY) + value.size() + 1);
+	std::vector<unsigned char> keyValues(4 + ((pairBytes + 3) & ~3u), 0);
+	std::memcpy(keyValues.data(), &pairBytes, 4);
+	std::memcpy(keyValues.data() + 4, KTX_SOURCE_KEY, sizeof(KTX_SOURCE_KEY));
+	std::memcpy(keyValues.data() + 4 + sizeof(KTX_SOURCE_KEY), value.c_str(), value.size() + 1);
+
+	KTXHeader header{};
+	std::memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+	header.endianness = 0x04030201;
+	header.glType = texture.compressed ? 0 : GL_UNSIGNED_BYTE;
+	header.glTypeSize = 1;
+	header.glFormat = texture.format;
+	header.glInternalFormat = texture.internalFormat;
+	header.glBaseInternalFormat = !texture.compressed ? texture.format
+		: (texture.internalFormat == GL_COMPRESSED_RG_RGTC2) ? GL_RG
+		: (texture.internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) ? GL_RGBA : GL_RGB;
+	header.pixelWidth = (uint32_t) texture.levels[0].width;
+	header.pixelHeight = (uint32_t) texture.levels[0].height;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = (uint32_t) texture.levels.size();
+	header.bytesOfKeyValueData = (uint32_t) keyValues.size();
+
+	// written aside and renamed so a reader never sees half a file
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out{ tempPath, std::ios::binary | std::ios::trunc };
+		out.write((const char*) &header, sizeof(header));
+		out.write((const char*) keyValues.data(), keyValues.size());
+		static const char padding[3] = {};
+		for (const TextureLevel& level : texture.levels) {
+			if (texture.compressed) {
+				uint32_t imageSize = (uint32_t) level.size;
+				out.write((const char*) &imageSize, 4);
+				out.write((const char*) texture.bytes.data() + level.offset, level.size);
+				out.write(padding, ((level.size + 3) & ~3u) - level.size);
+			}
+			else {
+				size_t texelBytes = formatChannels(texture.format);
+				size_t rowBytes = ktxRowBytes(level, texelBytes);
+				uint32_t imageSize = (uint32_t) (rowBytes * level.height);
+				out.write((const char*) &imageSize, 4);
+				for (int y = 0; y < level.height; y++) {
+					out.write((const char*) texture.bytes.data() + level.offset + y * level.width * texelBytes, level.width * texelBytes);
+					out.write(padding, rowBytes - level.width * texelBytes);
+				}
+			}
+		}
+		if (!out) return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+bool loadTextureData(const std::string& path, TextureData& texture, bool compress, JobSystem* jobs) {
+	// a cached file of the other kind is rebuilt, the driver decides which one is wanted
+	std::string cachePath = path + TEXTURE_CACHE_EXTENSION;
+	if (readKTX(cachePath, path, texture) && texture.compressed == compress) {
+		return true;
+	}
+
+	int width, height, channels;
+	unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+	if (!pixels) return false;
+
+	// the whole chain uncompressed, level 0 straight from the decoder
+	std::vector<TextureLevel> levels{ TextureLevel{ width, height, 0, (size_t) width * height * channels } };
+	while (levels.back().width > 1 || levels.back().height > 1) {
+		const TextureLevel& last = levels.back();
+		int w = std::max(1, last.width / 2), h = std::max(1, last.height / 2);
+		levels.push_back(TextureLevel{ w, h, last.offset + last.size, (size_t) w * h * channels });
+	}
+	std::vector<unsigned char> chain(levels.back().offset + levels.back().size);
+	std::memcpy(chain.data(), pixels, levels[0].size);
+	stbi_image_free(pixels);
+	// color is filtered as linear light, one and two channel images hold data rather than color
+	for (size_t i = 1; i < levels.size(); i++) {
+		downsampleLevel(chain.data() + levels[i - 1].offset, levels[i - 1].width, levels[i - 1].height, channels, channels >= 3,
+			chain.data() + levels[i].offset, jobs);
+	}
+
+	texture.levels.clear();
+	if (!compress) {
+		static const unsigned int formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+		texture.internalFormat = texture.format = formats[channels - 1];
+		texture.compressed = false;
+		texture.levels = levels;
+		texture.bytes.swap(chain);
+		writeKTX(cachePath, path, texture);
+		return true;
+	}
+
+	// two channels are kept as red and green, alpha only pays for the larger format when it is used
+	bool translucent = false;
+	for (size_t i = 3; channels == 4 && !translucent && i < levels[0].size; i += 4) {
+		translucent = chain[i] != 255;
+	}
+	BlockFormat format = (channels == 2) ? BLOCK_BC5 : translucent ? BLOCK_BC3 : BLOCK_BC1;
+	texture.internalFormat = (format == BLOCK_BC5) ? GL_COMPRESSED_RG_RGTC2
+		: (format == BLOCK_BC3) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	texture.format = 0;
+	texture.compressed = true;
+
+	size_t compressedBytes = 0;
+	for (const TextureLevel& level : levels) {
+		texture.levels.push_back(TextureLevel{ level.width, level.height, compressedBytes, getCompressedSize(format, level.width, level.height) });
+		compressedBytes += texture.levels.back().size;
+	}
+	texture.bytes.resize(compressedBytes);
+	for (size_t i = 0; i < levels.size(); i++) {
+		compressImage(format, chain.data() + levels[i].offset, levels[i].width, levels[i].height, channels,
+			texture.bytes.data() + texture.levels[i].offset, jobs);
+	}
+
+	writeKTX(cachePath, path, texture);
+	return true;
+}
+
+void uploadTextureData(const TextureData& texture, const unsigned char* base) {
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) texture.levels.size() - 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t i = 0; i < texture.levels.size(); i++) {
+		const TextureLevel& level = texture.levels[i];
+		const void* texels = (const void*) ((size_t) base + level.offset);
+		if (texture.compressed) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint) i, texture.internalFormat, level.width, level.height, 0, (GLsizei) level.size, texels);
+		}
+		else {
+			glTexImage2D(GL_TEXTURE_2D, (GLint) i, texture.internalFormat, level.width, level.height, 0, texture.format, GL_UNSIGNED_BYTE, texels);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+bool isBlockCompressionSupported() {
+	static int supported = -1;
+	if (supported < 0) {
+		supported = 0;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++) {
+			const char* extension = (const char*) glGetStringi(GL_EXTENSIONS, i);
+			if (extension && std::strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0) {
+				supported = 1;
+			}
+		}
+	}
+	return supported == 1;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+#define TEXTURE_CACHE_EXTENSION ".ktx"
+
+struct TextureLevel {
+	int width, height;
+	size_t offset, size;
+};
+
+// A texture ready to upload, every mip level either block compressed or as
+// tightly packed 8 bit texels, back to back in bytes.
+struct TextureData {
+	unsigned int internalFormat;
+	// pixel format of uncompressed levels, 0 when compressed
+	unsigned int format;
+	bool compressed;
+	std::vector<TextureLevel> levels;
+	std::vector<unsigned char> bytes;
+};
+
+// Reads path + TEXTURE_CACHE_EXTENSION when it is up to date with the source. Otherwise
+// decodes the source, builds its gamma correct mips, block compresses them when compress
+// is set and caches the result in a new KTX file. Safe to call from worker threads.
+bool loadTextureData(const std::string& path, TextureData& texture, bool compress, JobSystem* jobs);
+
+bool readKTX(const std::string& path, const std::string& sourcePath, TextureData& texture);
+bool writeKTX(const std::string& path, const std::string& sourcePath, const TextureData& texture);
+
+// GL thread. Uploads every level into the texture bound to GL_TEXTURE_2D. base points
+// at the bytes, or is 0 when they are staged in the bound pixel unpack buffer
+void uploadTextureData(const TextureData& texture, const unsigned char* base);
+// BC5 is core, BC1 and BC3 need S3TC
+bool isBlockCompressionSupported();
\ No newline at end of file
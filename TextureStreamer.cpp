@@ -0,0 +1,161 @@
+#include "TextureStreamer.h"
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "GLState.h"
+#include "JobSystem.h"
+#include "TextureData.h"
+
+TextureStreamer::TextureStreamer(JobSystem& jobs, size_t uploadBudget)
+	: jobs(jobs), uploadBudget(std::max<size_t>(uploadBudget, 1)), compress(isBlockCompressionSupported()),
+	nextTicket(0), uploading(false), current{}, currentOffset(0)
+{
+	PBO.create();
+}
+
+TextureStreamer::~TextureStreamer() {
+	// decode jobs point back at this object
+	jobs.wait(pending);
+}
+
+unsigned int TextureStreamer::request(const std::string& path, const glm::vec4& placeholder) {
+	unsigned int texture;
+	glGenTextures(1, &texture);
+
+	unsigned char texel[4];
+	for (int i = 0; i < 4; i++) {
+		texel[i] = (unsigned char) (glm::clamp(placeholder[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+	GLState::bindTexture(0, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	stats.requested++;
+
+	// on the heap so the jobs only carry a pointer to it
+	Image* image = new Image{ texture, nextTicket++, path, false, TextureData{}, 0.0 };
+	inFlight[texture] = image->ticket;
+	jobs.spawn([this, image] {
+		auto start = std::chrono::high_resolution_clock::now();
+		image->loaded = loadTextureData(image->path, image->data, compress, &jobs);
+		image->decodeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// counted before this job finishes, so pending never drops to zero in between
+		jobs.spawnOnMain([this, image] {
+			decoded.push_back(std::move(*image));
+			delete image;
+		}, &pending);
+	}, &pending);
+	return texture;
+}
+
+void TextureStreamer::cancel(unsigned int texture) {
+	auto it = inFlight.find(texture);
+	if (it == inFlight.end()) return;
+
+	// the decode still runs, update() throws the image away once it arrives
+	if (uploading && current.texture == texture && current.ticket == it->second) {
+		current.data = TextureData{};
+		uploading = false;
+	}
+	inFlight.erase(it);
+	stats.cancelled++;
+}
+
+void TextureStreamer::update() {
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t budget = uploadBudget;
+
+	while (budget > 0) {
+		if (!uploading) {
+			if (decoded.empty()) break;
+			current = std::move(decoded.front());
+			decoded.pop_front();
+			stats.decodeMs += current.decodeMs;
+
+			// its texture was deleted, the name may belong to another one by now
+			auto it = inFlight.find(current.texture);
+			if (it == inFlight.end() || it->second != current.ticket) {
+				current.data = TextureData{};
+				continue;
+			}
+			if (!current.loaded) {
+				std::cout << "Could not load texture from \"" << current.path << "\"" << std::endl;
+				inFlight.erase(it);
+				stats.failed++;
+				continue;
+			}
+
+			// fresh storage each image, the last one may still be feeding its texture
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO.get());
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, current.data.bytes.size(), NULL, GL_STREAM_DRAW);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			uploading = true;
+			currentOffset = 0;
+		}
+
+		// nothing reads the buffer until the image is complete, so the slices can skip synchronization
+		size_t size = current.data.bytes.size();
+		size_t slice = std::min(size - currentOffset, budget);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO.get());
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, currentOffset, slice,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (mapped) {
+			std::memcpy(mapped, current.data.bytes.data() + currentOffset, slice);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		currentOffset += slice;
+		budget -= slice;
+		stats.uploadedBytes += slice;
+		if (currentOffset == size) {
+			finishUpload();
+		}
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	stats.worstUpdateMs = std::max(stats.worstUpdateMs, ms);
+}
+
+void TextureStreamer::finishUpload() {
+	// every level comes from the PBO, the driver copies it without stalling this thread
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO.get());
+	GLState::bindTexture(0, current.texture);
+	uploadTextureData(current.data, NULL);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	current.data = TextureData{};
+	uploading = false;
+	inFlight.erase(current.texture);
+	stats.resident++;
+}
+
+void TextureStreamer::finish() {
+	while (!isIdle()) {
+		jobs.runMainJobs();
+		update();
+		if (!uploading) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool TextureStreamer::isIdle() const {
+	return stats.resident + stats.failed + stats.cancelled == stats.requested;
+}
+
+const TextureStreamer::Stats& TextureStreamer::getStats() const { return stats; }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureData.h"
+#include "GLHandle.h"
+#include "JobSystem.h"
+
+// bytes copied into the pixel buffer per update(), about 1 ms of memcpy
+#define TEXTURE_UPLOAD_BUDGET (4 * 1024 * 1024)
+
+// Decodes textures as jobs and streams them into GL through a pixel buffer
+// object a slice at a time, so no single frame pays for a whole texture. Images
+// arrive block compressed with their mips when the driver takes S3TC. A
+// requested texture can be bound right away, it shows a 1x1 placeholder until
+// its image is resident.
+class TextureStreamer {
+public:
+	struct Stats {
+		unsigned int requested = 0;
+		unsigned int resident = 0;
+		unsigned int failed = 0;
+		unsigned int cancelled = 0;
+		size_t uploadedBytes = 0;
+		double decodeMs = 0.0;
+		double worstUpdateMs = 0.0;
+	};
+
+private:
+	struct Image {
+		unsigned int texture;
+		// tells a request apart from a later one that was given the same texture name
+		uint64_t ticket;
+		std::string path;
+		bool loaded;
+		TextureData data;
+		double decodeMs;
+	};
+
+	JobSystem& jobs;
+	size_t uploadBudget;
+	bool compress;
+
+	// handed over by jobs on the main lane, so only the GL thread touches it
+	std::deque<Image> decoded;
+	// decodes and handovers still to come
+	JobCounter pending;
+	// the ticket of every request not yet resident, failed or cancelled, by texture name
+	std::unordered_map<unsigned int, uint64_t> inFlight;
+	uint64_t nextTicket;
+
+	// the image being copied into the PBO, it reaches the texture once all of it is there
+	GLBuffer PBO;
+	bool uploading;
+	Image current;
+	size_t currentOffset;
+
+	Stats stats;
+
+	void finishUpload();
+
+public:
+	TextureStreamer(JobSystem& jobs, size_t uploadBudget = TEXTURE_UPLOAD_BUDGET);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// returns the texture name right away, placeholder is the color it shows until it loads
+	unsigned int request(const std::string& path, const glm::vec4& placeholder);
+	// call before deleting a requested texture, its image is dropped instead of uploaded
+	void cancel(unsigned int texture);
+
+	// GL thread, once a frame after JobSystem::runMainJobs()
+	void update();
+	// keeps updating until everything requested is resident
+	void finish();
+
+	bool isIdle() const;
+	const Stats& getStats() const;
+};
\ No newline at end of file
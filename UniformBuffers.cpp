@@ -0,0 +1,38 @@
+#include "UniformBuffers.h"
+#include <glad.h>
+
+#include <cstring>
+#include <string>
+
+int uniformBlockBinding(const std::string& blockName) {
+	if (blockName == "FrameUniforms") return FRAME_UNIFORMS_BINDING;
+	if (blockName == "LightUniforms") return LIGHT_UNIFORMS_BINDING;
+	return -1;
+}
+
+SceneUniformBuffer::SceneUniformBuffer()
+	: frame{}, lights{}
+{
+	// the light block must start on the driver's range alignment
+	int alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	lightOffset = (sizeof(FrameUniforms) + alignment - 1) / alignment * alignment;
+	staging.resize(lightOffset + sizeof(LightUniforms));
+
+	UBO.create();
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO.get());
+	glBufferData(GL_UNIFORM_BUFFER, staging.size(), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, UBO.get(), 0, sizeof(FrameUniforms));
+	glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_UNIFORMS_BINDING, UBO.get(), lightOffset, sizeof(LightUniforms));
+}
+
+void SceneUniformBuffer::upload() {
+	std::memcpy(staging.data(), &frame, sizeof(FrameUniforms));
+	std::memcpy(staging.data() + lightOffset, &lights, sizeof(LightUniforms));
+
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO.get());
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, staging.size(), staging.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
\ No newline at end of file
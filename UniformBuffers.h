@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "GLHandle.h"
+
+#define MAX_POINT_LIGHTS 4
+
+// fixed binding points shared by every program
+enum UniformBinding : unsigned int {
+	FRAME_UNIFORMS_BINDING = 0,
+	LIGHT_UNIFORMS_BINDING = 1
+};
+
+// C++ mirrors of the std140 blocks in the shaders. Scalars are packed into
+// the padding after each vec3 so the layouts match without explicit filler.
+struct FrameUniforms {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 viewPos;
+	float time;
+};
+
+struct DirLightUniform {
+	glm::vec3 direction;
+	float pad0;
+	glm::vec3 ambient;
+	float pad1;
+	glm::vec3 diffuse;
+	float pad2;
+	glm::vec3 specular;
+	float pad3;
+};
+
+struct PointLightUniform {
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float pad0;
+};
+
+struct SpotLightUniform {
+	glm::vec3 position;
+	float cutoff;
+	glm::vec3 direction;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float pad0;
+};
+
+struct LightUniforms {
+	DirLightUniform dirLight;
+	SpotLightUniform spotLight;
+	PointLightUniform pntLights[MAX_POINT_LIGHTS];
+	int numPointLights;
+	int pad[3];
+};
+
+static_assert(sizeof(FrameUniforms) == 144, "FrameUniforms must match the std140 block");
+static_assert(sizeof(DirLightUniform) == 64, "DirLightUniform must match the std140 struct");
+static_assert(sizeof(PointLightUniform) == 64, "PointLightUniform must match the std140 struct");
+static_assert(sizeof(SpotLightUniform) == 80, "SpotLightUniform must match the std140 struct");
+static_assert(sizeof(LightUniforms) == 64 + 80 + 64 * MAX_POINT_LIGHTS + 16, "LightUniforms must match the std140 block");
+
+// returns the binding point of a known uniform block, -1 if the name is unknown
+int uniformBlockBinding(const std::string& blockName);
+
+// One buffer holding both blocks, bound as two ranges. Fill in frame and
+// lights, then upload() writes the whole buffer with a single call.
+class SceneUniformBuffer {
+private:
+	GLBuffer UBO;
+	size_t lightOffset;
+	std::vector<unsigned char> staging;
+
+public:
+	FrameUniforms frame;
+	LightUniforms lights;
+
+	SceneUniformBuffer();
+
+	void upload();
+};
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "VertexFormat.h"
+#include "Mesh.h"
+
+namespace {
+	struct PackedUnorm16 {
+		uint16_t position[4];
+		int16_t normal[2];
+		uint16_t texCoords[2];
+	};
+
+	struct PackedHalf {
+		uint16_t position[4];
+		uint32_t normal;
+		uint16_t texCoords[2];
+	};
+
+	struct PackedCompact {
+		uint16_t position[3];
+		int8_t normal[2];
+		uint16_t texCoords[2];
+	};
+
+	static_assert(sizeof(PackedUnorm16) == 16, "VERTEX_UNORM16 layout changed");
+	static_assert(sizeof(PackedHalf) == 16, "VERTEX_HALF layout changed");
+	static_assert(sizeof(PackedCompact) == 12, "VERTEX_COMPACT layout changed");
+
+	uint16_t toUnorm16(float value) {
+		return (uint16_t) std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f);
+	}
+
+	// snorm decoding as GL 4.2 and later define it, -max and -max - 1 both map to -1
+	float fromSnorm(int value, int max) {
+		return std::max((float) value / (float) max, -1.0f);
+	}
+
+	int toSnorm(float value, int max) {
+		return (int) std::lround(std::min(std::max(value, -1.0f), 1.0f) * (float) max);
+	}
+
+	float normalAngle(const glm::vec3& a, const glm::vec3& b) {
+		float length = glm::length(a) * glm::length(b);
+		if (length <= 0.0f) {
+			return 0.0f;
+		}
+		return glm::degrees(std::acos(std::min(std::max(glm::dot(a, b) / length, -1.0f), 1.0f)));
+	}
+
+	// 8 bit octahedral rounding to nearest can be a few degrees off, so every floor and ceil
+	// combination is tried and the one decoding closest to the normal wins
+	void octahedralSnorm8(const glm::vec3& normal, int8_t* out) {
+		glm::vec2 encoded{ octahedralEncode(normal) * 127.0f };
+		float best = -2.0f;
+		for (int i = 0; i < 4; i++) {
+			int x = (int) ((i & 1) ? std::ceil(encoded.x) : std::floor(encoded.x));
+			int y = (int) ((i & 2) ? std::ceil(encoded.y) : std::floor(encoded.y));
+			x = std::min(std::max(x, -127), 127);
+			y = std::min(std::max(y, -127), 127);
+			float score = glm::dot(octahedralDecode(glm::vec2{ x / 127.0f, y / 127.0f }), normal);
+			if (score > best) {
+				best = score;
+				out[0] = (int8_t) x;
+				out[1] = (int8_t) y;
+			}
+		}
+	}
+}
+
+unsigned int getVertexStride(VertexFormat format) {
+	switch (format) {
+	case VERTEX_UNORM16: return sizeof(PackedUnorm16);
+	case VERTEX_HALF: return sizeof(PackedHalf);
+	case VERTEX_COMPACT: return sizeof(PackedCompact);
+	default: return sizeof(Vertex);
+	}
+}
+
+const char* getVertexFormatName(VertexFormat format) {
+	switch (format) {
+	case VERTEX_UNORM16: return "unorm16";
+	case VERTEX_HALF: return "half";
+	case VERTEX_COMPACT: return "compact";
+	default: return "float";
+	}
+}
+
+uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	if (magnitude >= 0x7F800000) {
+		// infinity stays infinity, NaN stays NaN
+		return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+	}
+	if (magnitude >= 0x477FF000) {
+		// rounds past 65504
+		return sign | 0x7C00;
+	}
+	if (magnitude < 0x38800000) {
+		// below the smallest normal half, count in steps of 2^-24
+		float absolute;
+		std::memcpy(&absolute, &magnitude, sizeof(absolute));
+		return sign | (uint16_t) std::lrint(absolute * 16777216.0f);
+	}
+	// rebias the exponent and round the mantissa to nearest even
+	uint32_t half = magnitude - 0x38000000;
+	half = (half + 0xFFF + ((half >> 13) & 1)) >> 13;
+	return sign | (uint16_t) half;
+}
+
+float halfToFloat(uint16_t value) {
+	uint32_t sign = (uint32_t) (value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+	uint32_t bits;
+	if (exponent == 0) {
+		float result = (float) mantissa / 16777216.0f;
+		return sign ? -result : result;
+	}
+	if (exponent == 31) {
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+glm::vec2 octahedralEncode(const glm::vec3& normal) {
+	float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (sum <= 0.0f) {
+		return glm::vec2{ 0.0f };
+	}
+	glm::vec2 p{ normal.x / sum, normal.y / sum };
+	if (normal.z < 0.0f) {
+		// fold the lower hemisphere over the diagonals
+		glm::vec2 folded{ 1.0f - std::abs(p.y), 1.0f - std::abs(p.x) };
+		p = glm::vec2{ p.x >= 0.0f ? folded.x : -folded.x, p.y >= 0.0f ? folded.y : -folded.y };
+	}
+	return p;
+}
+
+glm::vec3 octahedralDecode(const glm::vec2& encoded) {
+	glm::vec3 v{ encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y) };
+	float t = std::max(-v.z, 0.0f);
+	v.x += (v.x >= 0.0f) ? -t : t;
+	v.y += (v.y >= 0.0f) ? -t : t;
+	return glm::normalize(v);
+}
+
+VertexDequantize packVertices(VertexFormat format, const Vertex* vertices, unsigned int count, const AABB& bounds,
+	std::vector<unsigned char>& packed)
+{
+	VertexDequantize dequantize;
+	packed.resize((size_t) count * getVertexStride(format));
+	if (format == VERTEX_FLOAT) {
+		std::memcpy(packed.data(), vertices, packed.size());
+		return dequantize;
+	}
+
+	glm::vec3 extents{ bounds.max - bounds.min };
+	glm::vec3 inverseExtents{ extents.x > 0.0f ? 1.0f / extents.x : 0.0f, extents.y > 0.0f ? 1.0f / extents.y : 0.0f,
+		extents.z > 0.0f ? 1.0f / extents.z : 0.0f };
+	if (format == VERTEX_HALF) {
+		dequantize.positionOffset = bounds.getCenter();
+	}
+	else {
+		dequantize.positionScale = extents;
+		dequantize.positionOffset = bounds.min;
+	}
+	dequantize.octahedralNormals = (format != VERTEX_HALF);
+
+	for (unsigned int i = 0; i < count; i++) {
+		const Vertex& vertex = vertices[i];
+		glm::vec3 unit{ (vertex.Position - bounds.min) * inverseExtents };
+		uint16_t texCoords[2] = { floatToHalf(vertex.TexCoords.x), floatToHalf(vertex.TexCoords.y) };
+
+		if (format == VERTEX_UNORM16) {
+			PackedUnorm16 out{};
+			for (int c = 0; c < 3; c++) {
+				out.position[c] = toUnorm16(unit[c]);
+			}
+			glm::vec2 encoded{ octahedralEncode(vertex.Normal) };
+			out.normal[0] = (int16_t) toSnorm(encoded.x, 32767);
+			out.normal[1] = (int16_t) toSnorm(encoded.y, 32767);
+			std::memcpy(out.texCoords, texCoords, sizeof(texCoords));
+			std::memcpy(&packed[(size_t) i * sizeof(out)], &out, sizeof(out));
+		}
+		else if (format == VERTEX_HALF) {
+			PackedHalf out{};
+			glm::vec3 centered{ vertex.Position - dequantize.positionOffset };
+			for (int c = 0; c < 3; c++) {
+				out.position[c] = floatToHalf(centered[c]);
+			}
+			glm::vec3 normal{ glm::length(vertex.Normal) > 0.0f ? glm::normalize(vertex.Normal) : vertex.Normal };
+			out.normal = ((uint32_t) toSnorm(normal.x, 511) & 0x3FF) | (((uint32_t) toSnorm(normal.y, 511) & 0x3FF) << 10)
+				| (((uint32_t) toSnorm(normal.z, 511) & 0x3FF) << 20);
+			std::memcpy(out.texCoords, texCoords, sizeof(texCoords));
+			std::memcpy(&packed[(size_t) i * sizeof(out)], &out, sizeof(out));
+		}
+		else {
+			PackedCompact out{};
+			for (int c = 0; c < 3; c++) {
+				out.position[c] = toUnorm16(unit[c]);
+			}
+			octahedralSnorm8(vertex.Normal, out.normal);
+			std::memcpy(out.texCoords, texCoords, sizeof(texCoords));
+			std::memcpy(&packed[(size_t) i * sizeof(out)], &out, sizeof(out));
+		}
+	}
+	return dequantize;
+}
+
+void setVertexAttributes(VertexFormat format) {
+	GLsizei stride = (GLsizei) getVertexStride(format);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	switch (format) {
+	case VERTEX_UNORM16:
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*) offsetof(PackedUnorm16, position));
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*) offsetof(PackedUnorm16, normal));
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*) offsetof(PackedUnorm16, texCoords));
+		break;
+	case VERTEX_HALF:
+		glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*) offsetof(PackedHalf, position));
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*) offsetof(PackedHalf, normal));
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*) offsetof(PackedHalf, texCoords));
+		break;
+	case VERTEX_COMPACT:
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*) offsetof(PackedCompact, position));
+		glVertexAttribPointer(1, 2, GL_BYTE, GL_TRUE, stride, (void*) offsetof(PackedCompact, normal));
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*) offsetof(PackedCompact, texCoords));
+		break;
+	default:
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*) offsetof(Vertex, Position));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*) offsetof(Vertex, Normal));
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*) offsetof(Vertex, TexCoords));
+		break;
+	}
+}
+
+Vertex unpackVertex(VertexFormat format, const unsigned char* packed, const VertexDequantize& dequantize) {
+	Vertex vertex;
+	if (format == VERTEX_FLOAT) {
+		std::memcpy(&vertex, packed, sizeof(vertex));
+		return vertex;
+	}
+
+	glm::vec3 position;
+	glm::vec3 normal;
+	uint16_t texCoords[2];
+	if (format == VERTEX_UNORM16) {
+		PackedUnorm16 in;
+		std::memcpy(&in, packed, sizeof(in));
+		position = glm::vec3{ in.position[0], in.position[1], in.position[2] } / 65535.0f;
+		normal = octahedralDecode(glm::vec2{ fromSnorm(in.normal[0], 32767), fromSnorm(in.normal[1], 32767) });
+		std::memcpy(texCoords, in.texCoords, sizeof(texCoords));
+	}
+	else if (format == VERTEX_HALF) {
+		PackedHalf in;
+		std::memcpy(&in, packed, sizeof(in));
+		position = glm::vec3{ halfToFloat(in.position[0]), halfToFloat(in.position[1]), halfToFloat(in.position[2]) };
+		// sign extend each 10 bit field
+		int x = (int) (in.normal << 22) >> 22, y = (int) (in.normal << 12) >> 22, z = (int) (in.normal << 2) >> 22;
+		normal = glm::vec3{ fromSnorm(x, 511), fromSnorm(y, 511), fromSnorm(z, 511) };
+		std::memcpy(texCoords, in.texCoords, sizeof(texCoords));
+	}
+	else {
+		PackedCompact in;
+		std::memcpy(&in, packed, sizeof(in));
+		position = glm::vec3{ in.position[0], in.position[1], in.position[2] } / 65535.0f;
+		normal = octahedralDecode(glm::vec2{ fromSnorm(in.normal[0], 127), fromSnorm(in.normal[1], 127) });
+		std::memcpy(texCoords, in.texCoords, sizeof(texCoords));
+	}
+	vertex.Position = position * dequantize.positionScale + dequantize.positionOffset;
+	vertex.Normal = normal;
+	vertex.TexCoords = glm::vec2{ halfToFloat(texCoords[0]), halfToFloat(texCoords[1]) };
+	return vertex;
+}
+
+VertexFormatError measureVertexFormatError(VertexFormat format, const Vertex* vertices, unsigned int count, const AABB& bounds) {
+	VertexFormatError error{};
+	if (count == 0) {
+		return error;
+	}
+
+	std::vector<unsigned char> packed;
+	VertexDequantize dequantize = packVertices(format, vertices, count, bounds, packed);
+	unsigned int stride = getVertexStride(format);
+	double positionSum = 0.0, normalSum = 0.0;
+	for (unsigned int i = 0; i < count; i++) {
+		Vertex unpacked = unpackVertex(format, &packed[(size_t) i * stride], dequantize);
+		float position = glm::length(unpacked.Position - vertices[i].Position);
+		float angle = normalAngle(unpacked.Normal, vertices[i].Normal);
+		glm::vec2 uv{ glm::abs(unpacked.TexCoords - vertices[i].TexCoords) };
+		error.maxPosition = std::max(error.maxPosition, position);
+		error.maxNormalDegrees = std::max(error.maxNormalDegrees, angle);
+		error.maxUV = std::max(error.maxUV, std::max(uv.x, uv.y));
+		positionSum += position;
+		normalSum += angle;
+	}
+	error.meanPosition = (float) (positionSum / count);
+	error.meanNormalDegrees = (float) (normalSum / count);
+	return error;
+}
\ No newline at end of file
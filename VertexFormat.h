@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+
+struct Vertex;
+
+// GPU side vertex layouts, the CPU copy of a mesh always stays a plain Vertex.
+// VERTEX_FLOAT    32 bytes, the Vertex struct as is
+// VERTEX_UNORM16  16 bytes, unorm16 position across the mesh bounds, octahedral snorm16 normal, half UV
+// VERTEX_HALF     16 bytes, half position around the bounds centre, 10-10-10-2 snorm normal, half UV
+// VERTEX_COMPACT  12 bytes, unorm16 position, octahedral snorm8 normal, half UV
+enum VertexFormat {
+	VERTEX_FLOAT,
+	VERTEX_UNORM16,
+	VERTEX_HALF,
+	VERTEX_COMPACT,
+	VERTEX_FORMAT_COUNT
+};
+
+// what vShader1.vert needs to undo the packing, position = aPos * positionScale + positionOffset
+struct VertexDequantize {
+	glm::vec3 positionScale{ 1.0f };
+	glm::vec3 positionOffset{ 0.0f };
+	bool octahedralNormals = false;
+};
+
+// worst and mean differences between the unpacked and the original vertices
+struct VertexFormatError {
+	float maxPosition, meanPosition;
+	float maxNormalDegrees, meanNormalDegrees;
+	float maxUV;
+};
+
+unsigned int getVertexStride(VertexFormat format);
+const char* getVertexFormatName(VertexFormat format);
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+// unit vector to the [-1, 1] square and back
+glm::vec2 octahedralEncode(const glm::vec3& normal);
+glm::vec3 octahedralDecode(const glm::vec2& encoded);
+
+// bounds are the vertices' own, positions are packed relative to them
+VertexDequantize packVertices(VertexFormat format, const Vertex* vertices, unsigned int count, const AABB& bounds,
+	std::vector<unsigned char>& packed);
+// the attribute pointers for packed data in the bound GL_ARRAY_BUFFER, locations 0 to 2 as in vShader1.vert
+void setVertexAttributes(VertexFormat format);
+// decodes one packed vertex the way the attribute fetch and vShader1.vert do
+Vertex unpackVertex(VertexFormat format, const unsigned char* packed, const VertexDequantize& dequantize);
+
+VertexFormatError measureVertexFormatError(VertexFormat format, const Vertex* vertices, unsigned int count, const AABB& bounds);
\ No newline at end of file